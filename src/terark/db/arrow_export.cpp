@@ -0,0 +1,776 @@
+#include "arrow_export.hpp"
+#include "db_context.hpp"
+#include "fixed_len_store.hpp"
+#include "zip_int_store.hpp"
+#include "block_int_store.hpp"
+#include "float_xor_store.hpp"
+#include <terark/io/FileStream.hpp>
+#include <terark/io/var_int.hpp>
+#include <terark/bitmanip.hpp>
+#include <tbb/tbb_thread.h>
+#include <boost/filesystem.hpp>
+#include <boost/scope_exit.hpp>
+#include <atomic>
+#include <mutex>
+
+namespace terark { namespace db {
+
+namespace fs = boost::filesystem;
+
+namespace {
+	// union Type of arrow Schema.fbs
+	enum ArrowTypeId : uint8_t {
+		ArrowInt = 2,
+		ArrowFloatingPoint = 3,
+		ArrowBinary = 4,
+		ArrowUtf8 = 5,
+		ArrowFixedSizeBinary = 15,
+	};
+	enum ArrowMessageHeader : uint8_t {
+		ArrowSchemaHeader = 1,
+		ArrowRecordBatchHeader = 3,
+	};
+	const int16_t ArrowMetadataV5 = 4;
+
+	// Minimal flatbuffers encoder, the buffer is written front to back:
+	// a table is written before its children, offset fields of the table
+	// are patched when the children are written, thus all offsets point
+	// forward as flatbuffers required. A vtable is written just before its
+	// table, vtables are not shared.
+	class FlatBufWriter {
+	public:
+		struct Field {
+			uint16_t id;
+			uint8_t  size;  // 1, 2, 4, 8; 4 for offset to child
+			uint64_t value;
+			size_t   pos;   // set by table()
+		};
+		valvec<byte> m_buf;
+
+		void clear() { m_buf.erase_all(); }
+		void align(size_t a) {
+			while (m_buf.size() % a)
+				m_buf.push_back(0);
+		}
+		template<class T>
+		size_t put(T x) {
+			align(sizeof(T));
+			size_t pos = m_buf.size();
+			unaligned_save<T>(m_buf.grow_no_init(sizeof(T)), x);
+			return pos;
+		}
+		// uoffset at fieldPos is relative to fieldPos
+		void patch(size_t fieldPos, size_t target) {
+			assert(target > fieldPos);
+			unaligned_save<uint32_t>(m_buf.data() + fieldPos, uint32_t(target - fieldPos));
+		}
+		size_t root() { return put<uint32_t>(0); }
+
+		// fields are laid out in descending size order, the table is
+		// positioned to make its 8 bytes fields aligned
+		size_t table(Field* fields, size_t num) {
+			size_t maxId = 0;
+			bool has8 = false;
+			for (size_t i = 0; i < num; ++i) {
+				maxId = std::max<size_t>(maxId, fields[i].id + 1);
+				has8 |= 8 == fields[i].size;
+			}
+			align(2);
+			size_t vtPos = m_buf.size();
+			size_t vtSize = 4 + 2 * maxId;
+			m_buf.resize(vtPos + vtSize, 0);
+			align(4);
+			if (has8 && (m_buf.size() + 4) % 8)
+				m_buf.resize(m_buf.size() + 4, 0);
+			size_t tabPos = m_buf.size();
+			unaligned_save<int32_t>(m_buf.grow_no_init(4), int32_t(tabPos - vtPos));
+			for (size_t size = 8; size > 0; size /= 2) {
+				for (size_t i = 0; i < num; ++i) {
+					Field& f = fields[i];
+					if (f.size != size)
+						continue;
+					assert(m_buf.size() % size == 0);
+					f.pos = m_buf.size();
+					switch (size) {
+					case 1: m_buf.push_back(byte(f.value)); break;
+					case 2: unaligned_save<uint16_t>(m_buf.grow_no_init(2), uint16_t(f.value)); break;
+					case 4: unaligned_save<uint32_t>(m_buf.grow_no_init(4), uint32_t(f.value)); break;
+					case 8: unaligned_save<uint64_t>(m_buf.grow_no_init(8), f.value); break;
+					}
+					unaligned_save<uint16_t>(m_buf.data() + vtPos + 4 + 2 * f.id,
+											 uint16_t(f.pos - tabPos));
+				}
+			}
+			unaligned_save<uint16_t>(m_buf.data() + vtPos + 0, uint16_t(vtSize));
+			unaligned_save<uint16_t>(m_buf.data() + vtPos + 2, uint16_t(m_buf.size() - tabPos));
+			return tabPos;
+		}
+		size_t string(fstring s) {
+			size_t pos = put<uint32_t>(uint32_t(s.size()));
+			m_buf.append(s.udata(), s.size());
+			m_buf.push_back(0);
+			return pos;
+		}
+		// elements are appended by caller
+		size_t vector(size_t num, size_t elemAlign) {
+			align(4);
+			while ((m_buf.size() + 4) % elemAlign)
+				m_buf.push_back(0);
+			return put<uint32_t>(uint32_t(num));
+		}
+	};
+
+	// arrow offsets are int32, a batch is cut before a value would exceed
+	// MaxBatchVarBytes, and is flushed when it reached FlushBatchVarBytes
+	const size_t MaxBatchVarBytes = INT32_MAX;
+	const size_t FlushBatchVarBytes = size_t(1) << 30;
+
+	struct ArrowColumn {
+		fstring    name;
+		uint8_t    typeId;
+		bool       isSigned;
+		bool       isVarInt;
+		uint32_t   bitWidth;   // Int and FloatingPoint
+		uint32_t   fixedBytes; // 0 for Utf8 and Binary
+		valvec<byte>     data;
+		valvec<uint32_t> offsets; // for Utf8 and Binary, offsets[0] is 0
+
+		void init(const Schema& schema, size_t columnId) {
+			const ColumnMeta& colmeta = schema.getColumnMeta(columnId);
+			name = schema.getColumnName(columnId);
+			typeId = ArrowInt;
+			isSigned = false;
+			isVarInt = false;
+			bitWidth = 0;
+			fixedBytes = 0;
+			switch (colmeta.type) {
+			default:
+				THROW_STD(invalid_argument, "column %.*s: type %s can not be exported to arrow"
+					, name.ilen(), name.data(), Schema::columnTypeStr(colmeta.type));
+			case ColumnType::Sint08: isSigned = true; // fall through
+			case ColumnType::Uint08: bitWidth =  8; break;
+			case ColumnType::Sint16: isSigned = true; // fall through
+			case ColumnType::Uint16: bitWidth = 16; break;
+			case ColumnType::Sint32: isSigned = true; // fall through
+			case ColumnType::Uint32: bitWidth = 32; break;
+			case ColumnType::Sint64: isSigned = true; // fall through
+			case ColumnType::Uint64: bitWidth = 64; break;
+			case ColumnType::VarSint: isSigned = true; // fall through
+			case ColumnType::VarUint: bitWidth = 64; isVarInt = true; break;
+			case ColumnType::Float32:
+				typeId = ArrowFloatingPoint;
+				bitWidth = 32;
+				break;
+			case ColumnType::Float64:
+				typeId = ArrowFloatingPoint;
+				bitWidth = 64;
+				break;
+			case ColumnType::Uint128:
+			case ColumnType::Sint128:
+			case ColumnType::Float128:
+			case ColumnType::Uuid:
+			case ColumnType::Fixed:
+				typeId = ArrowFixedSizeBinary;
+				fixedBytes = colmeta.fixedLen;
+				break;
+			case ColumnType::StrZero:
+				typeId = ArrowUtf8;
+				break;
+			case ColumnType::TwoStrZero:
+			case ColumnType::Binary:
+			case ColumnType::CarBin:
+				typeId = ArrowBinary;
+				break;
+			}
+			if (bitWidth)
+				fixedBytes = bitWidth / 8;
+			offsets.erase_all();
+			if (0 == fixedBytes)
+				offsets.push_back(0);
+		}
+		// data is the column data as is
+		bool isPlain() const { return fixedBytes && !isVarInt; }
+		///@returns false if var length data would exceed int32 offsets,
+		///         nothing is appended then
+		bool append(fstring col) {
+			if (isVarInt) {
+				const byte* end = nullptr;
+				uint64_t x = isSigned ? uint64_t(load_var_int64(col.udata(), &end))
+									  : load_var_uint64(col.udata(), &end);
+				unaligned_save<uint64_t>(data.grow_no_init(8), x);
+			}
+			else if (fixedBytes) {
+				assert(col.size() == fixedBytes);
+				data.append(col.udata(), col.size());
+			}
+			else {
+				if (data.size() + col.size() > MaxBatchVarBytes)
+					return false;
+				data.append(col.udata(), col.size());
+				offsets.push_back(uint32_t(data.size()));
+			}
+			return true;
+		}
+		// drop values of partially appended rows
+		void truncate(size_t rows) {
+			if (fixedBytes) {
+				if (data.size() > fixedBytes * rows)
+					data.resize(fixedBytes * rows);
+			}
+			else if (offsets.size() > rows + 1) {
+				offsets.resize(rows + 1);
+				data.resize(offsets.back());
+			}
+		}
+		void reset() {
+			data.erase_all();
+			if (0 == fixedBytes)
+				offsets.resize(1);
+		}
+	};
+
+	inline size_t align8(size_t x) { return (x + 7) & ~size_t(7); }
+}
+
+// Arrow IPC stream: each message is
+//   0xFFFFFFFF, int32 metadata size, flatbuffer Message, padding, body
+// message boundaries and body buffers are 8 bytes aligned, the stream is
+// ended by 0xFFFFFFFF, 0
+class ArrowExporter::StreamWriter {
+public:
+	FileStream    m_fp;
+	FlatBufWriter m_fb;
+	valvec<ArrowColumn> m_cols;
+	size_t m_batchRows;
+	size_t m_rows; // rows of current batch
+	llong  m_totalRows;
+
+	StreamWriter(const ArrowExporter* exporter, PathRef fpath) {
+		const Schema& rowSchema = exporter->m_tab->rowSchema();
+		m_cols.resize(exporter->m_columns.size());
+		for (size_t k = 0; k < m_cols.size(); ++k) {
+			m_cols[k].init(rowSchema, exporter->m_columns[k]);
+		}
+		m_batchRows = exporter->m_batchRows;
+		m_rows = 0;
+		m_totalRows = 0;
+		m_fp.open(fpath.string().c_str(), "wb");
+		m_fp.disbuf();
+		writeSchema();
+	}
+
+	void addRows(size_t rows) {
+		m_rows += rows;
+		if (m_rows >= m_batchRows) {
+			flushBatch();
+			return;
+		}
+		for (auto& col : m_cols) {
+			if (0 == col.fixedBytes && col.data.size() >= FlushBatchVarBytes) {
+				flushBatch();
+				return;
+			}
+		}
+	}
+
+	// drop partially appended rows beyond m_rows + rows
+	void truncateRows(size_t rows) {
+		for (auto& col : m_cols)
+			col.truncate(m_rows + rows);
+	}
+
+	// next row does not fit in current batch
+	void cutBatch() {
+		truncateRows(0);
+		if (0 == m_rows) {
+			THROW_STD(length_error, "a row has more than %zd bytes of var length data"
+				, MaxBatchVarBytes);
+		}
+		flushBatch();
+	}
+
+	void finish() {
+		flushBatch();
+		uint32_t eos[2] = { 0xFFFFFFFF, 0 };
+		m_fp.ensureWrite(eos, sizeof(eos));
+		m_fp.close();
+	}
+
+private:
+	typedef FlatBufWriter::Field Field;
+
+	void writeMessage(uint8_t headerType, size_t bodyLen, size_t* headerField) {
+		m_fb.clear();
+		size_t rootPos = m_fb.root();
+		Field msg[] = {
+			{ 0, 2, uint64_t(ArrowMetadataV5), 0 },
+			{ 1, 1, headerType, 0 },
+			{ 2, 4, 0, 0 },
+			{ 3, 8, bodyLen, 0 },
+		};
+		m_fb.patch(rootPos, m_fb.table(msg, 4));
+		*headerField = msg[2].pos;
+	}
+
+	void flushMessage() {
+		m_fb.align(8);
+		uint32_t prefix[2] = { 0xFFFFFFFF, uint32_t(m_fb.m_buf.size()) };
+		m_fp.ensureWrite(prefix, sizeof(prefix));
+		m_fp.ensureWrite(m_fb.m_buf.data(), m_fb.m_buf.size());
+	}
+
+	void writeSchema() {
+		size_t headerField;
+		writeMessage(ArrowSchemaHeader, 0, &headerField);
+	#if defined(BOOST_BIG_ENDIAN)
+		const uint64_t endianness = 1;
+	#else
+		const uint64_t endianness = 0;
+	#endif
+		Field schema[] = {
+			{ 0, 2, endianness, 0 },
+			{ 1, 4, 0, 0 },
+		};
+		m_fb.patch(headerField, m_fb.table(schema, 2));
+		m_fb.patch(schema[1].pos, m_fb.vector(m_cols.size(), 4));
+		size_t elemPos = m_fb.m_buf.size();
+		m_fb.m_buf.resize(elemPos + 4 * m_cols.size(), 0);
+		for (size_t k = 0; k < m_cols.size(); ++k) {
+			const ArrowColumn& col = m_cols[k];
+			Field field[] = {
+				{ 0, 4, 0, 0 },           // name
+				{ 1, 1, 0, 0 },           // nullable
+				{ 2, 1, col.typeId, 0 },  // type_type
+				{ 3, 4, 0, 0 },           // type
+				{ 5, 4, 0, 0 },           // children
+			};
+			m_fb.patch(elemPos + 4 * k, m_fb.table(field, 5));
+			m_fb.patch(field[0].pos, m_fb.string(col.name));
+			size_t typePos;
+			if (ArrowInt == col.typeId) {
+				Field type[] = {
+					{ 0, 4, col.bitWidth, 0 },
+					{ 1, 1, col.isSigned, 0 },
+				};
+				typePos = m_fb.table(type, 2);
+			}
+			else if (ArrowFloatingPoint == col.typeId) {
+				Field type[] = { { 0, 2, uint64_t(32 == col.bitWidth ? 1 : 2), 0 } };
+				typePos = m_fb.table(type, 1);
+			}
+			else if (ArrowFixedSizeBinary == col.typeId) {
+				Field type[] = { { 0, 4, col.fixedBytes, 0 } };
+				typePos = m_fb.table(type, 1);
+			}
+			else {
+				typePos = m_fb.table(NULL, 0);
+			}
+			m_fb.patch(field[3].pos, typePos);
+			m_fb.patch(field[4].pos, m_fb.vector(0, 4));
+		}
+		flushMessage();
+	}
+
+	void flushBatch() {
+		if (0 == m_rows)
+			return;
+		size_t bodyLen = 0;
+		size_t bufNum = 0;
+		for (auto& col : m_cols) {
+			assert(col.fixedBytes ? col.data.size() == col.fixedBytes * m_rows
+								  : col.offsets.size() == m_rows + 1);
+			if (0 == col.fixedBytes) {
+				bodyLen += align8(col.offsets.used_mem_size());
+				bufNum++;
+			}
+			bodyLen += align8(col.data.size());
+			bufNum += 2;
+		}
+		size_t headerField;
+		writeMessage(ArrowRecordBatchHeader, bodyLen, &headerField);
+		Field batch[] = {
+			{ 0, 8, uint64_t(m_rows), 0 },
+			{ 1, 4, 0, 0 }, // nodes
+			{ 2, 4, 0, 0 }, // buffers
+		};
+		m_fb.patch(headerField, m_fb.table(batch, 3));
+		m_fb.patch(batch[1].pos, m_fb.vector(m_cols.size(), 8));
+		for (size_t k = 0; k < m_cols.size(); ++k) {
+			m_fb.put<int64_t>(m_rows); // length
+			m_fb.put<int64_t>(0);      // null_count
+		}
+		m_fb.patch(batch[2].pos, m_fb.vector(bufNum, 8));
+		size_t offset = 0;
+		auto addBuffer = [&](size_t len) {
+			m_fb.put<int64_t>(offset);
+			m_fb.put<int64_t>(len);
+			offset += align8(len);
+		};
+		for (auto& col : m_cols) {
+			addBuffer(0); // validity bitmap is omitted
+			if (0 == col.fixedBytes)
+				addBuffer(col.offsets.used_mem_size());
+			addBuffer(col.data.size());
+		}
+		assert(offset == bodyLen);
+		flushMessage();
+		static const byte zeros[8] = { 0 };
+		auto writeBuffer = [&](const void* data, size_t len) {
+			m_fp.ensureWrite(data, len);
+			m_fp.ensureWrite(zeros, align8(len) - len);
+		};
+		for (auto& col : m_cols) {
+			if (0 == col.fixedBytes)
+				writeBuffer(col.offsets.data(), col.offsets.used_mem_size());
+			writeBuffer(col.data.data(), col.data.size());
+			col.reset();
+		}
+		m_totalRows += m_rows;
+		m_rows = 0;
+	}
+};
+
+struct ArrowExporter::ColgroupReader {
+	const ReadableStore* store;
+	const Schema*    schema;
+	StoreIteratorPtr iter;
+	llong            nextId;
+	bool             hasView;
+	valvec<std::pair<size_t, size_t> > cols; // (subColumnId, output index)
+	ColumnVec        parsed;
+	valvec<byte>     buf;
+
+	void init(const ReadableStore* cgStore, const Schema* cgSchema,
+			  DbContext* ctx) {
+		store = cgStore;
+		schema = cgSchema;
+		nextId = 0;
+		fstring view;
+		hasView = store->numDataRows() > 0 && store->getValueView(0, &view, ctx);
+		if (!hasView)
+			iter = store->ensureStoreIterForward(ctx);
+	}
+
+	fstring fetch(llong physicId, DbContext* ctx) {
+		fstring view;
+		if (hasView && store->getValueView(physicId, &view, ctx))
+			return view;
+		if (!iter) {
+			store->getValue(physicId, &buf, ctx);
+			return buf;
+		}
+		llong id = -1;
+		if (physicId != nextId || !iter->increment(&id, &buf) || id != physicId) {
+			if (!iter->seekExact(physicId, &buf)) {
+				THROW_STD(out_of_range, "physicId = %lld", physicId);
+			}
+		}
+		nextId = physicId + 1;
+		return buf;
+	}
+
+	bool hasVarLen(const StreamWriter* out) const {
+		for (auto& sub_out : cols) {
+			if (0 == out->m_cols[sub_out.second].fixedBytes)
+				return true;
+		}
+		return false;
+	}
+
+	///@returns false if the row does not fit in current batch, the row may
+	///         be partially appended then
+	bool appendRow(llong physicId, StreamWriter* out, DbContext* ctx) {
+		fstring val = fetch(physicId, ctx);
+		if (1 == cols.size() && out->m_cols[cols[0].second].isPlain()
+				&& 1 == schema->columnNum()) {
+			return out->m_cols[cols[0].second].append(val);
+		}
+		schema->parseRow(val, &parsed);
+		for (auto& sub_out : cols) {
+			if (!out->m_cols[sub_out.second].append(parsed[sub_out.first]))
+				return false;
+		}
+		return true;
+	}
+
+	// for single fixed length column colgroup, segment has no deleted rows
+	bool appendBlock(size_t physicBeg, size_t num, StreamWriter* out,
+					 DbContext* ctx) {
+		if (1 != cols.size() || 1 != schema->columnNum())
+			return false;
+		ArrowColumn& col = out->m_cols[cols[0].second];
+		if (!col.isPlain())
+			return false;
+		if (auto zis = dynamic_cast<const ZipIntStore*>(store)) {
+			zis->getValueBatchAppend(physicBeg, num, &col.data);
+			return true;
+		}
+		if (auto bis = dynamic_cast<const BlockIntStore*>(store)) {
+			bis->getValueBatchAppend(physicBeg, num, &col.data);
+			return true;
+		}
+		if (auto fxs = dynamic_cast<const FloatXorStore*>(store)) {
+			fxs->getValueBatchAppend(physicBeg, num, &col.data);
+			return true;
+		}
+		if (dynamic_cast<const FixedLenStore*>(store)) {
+			fstring first, last;
+			if (store->getValueView(physicBeg, &first, ctx) &&
+				store->getValueView(physicBeg + num - 1, &last, ctx) &&
+				first.size() == col.fixedBytes &&
+				last.data() == first.data() + col.fixedBytes * (num - 1)) {
+				col.data.append(first.udata(), col.fixedBytes * num);
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+ArrowExporter::ArrowExporter(CompositeTable* tab) : m_tab(tab) {
+	const size_t colnum = tab->rowSchema().columnNum();
+	m_columns.resize_no_init(colnum);
+	for (size_t i = 0; i < colnum; ++i)
+		m_columns[i] = i;
+	m_batchRows = 64 * 1024;
+	if (const char* env = getenv("TerarkDB_ArrowBatchRows")) {
+		m_batchRows = std::max<size_t>(1, (size_t)strtoull(env, NULL, 10));
+	}
+	m_threadNum = tbb::tbb_thread::hardware_concurrency();
+	if (const char* env = getenv("TerarkDB_ArrowExportThreads")) {
+		m_threadNum = (size_t)strtoull(env, NULL, 10);
+	}
+	m_threadNum = std::max<size_t>(m_threadNum, 1);
+}
+
+ArrowExporter::~ArrowExporter() {
+}
+
+void ArrowExporter::setColumns(const valvec<size_t>& columnIds) {
+	const Schema& rowSchema = m_tab->rowSchema();
+	ArrowColumn col;
+	for (size_t columnId : columnIds) {
+		if (columnId >= rowSchema.columnNum()) {
+			THROW_STD(invalid_argument, "columnId = %zd, columnNum = %zd"
+				, columnId, rowSchema.columnNum());
+		}
+		col.init(rowSchema, columnId); // check type
+	}
+	m_columns = columnIds;
+}
+
+void ArrowExporter::setColumns(fstring columnNames, char delim) {
+	const Schema& rowSchema = m_tab->rowSchema();
+	valvec<fstring> names;
+	columnNames.split(delim, &names);
+	valvec<size_t> columnIds;
+	for (fstring name : names) {
+		size_t columnId = rowSchema.getColumnId(name);
+		if (columnId >= rowSchema.columnNum()) {
+			THROW_STD(invalid_argument, "column %.*s does not exist"
+				, name.ilen(), name.data());
+		}
+		columnIds.push_back(columnId);
+	}
+	setColumns(columnIds);
+}
+
+void ArrowExporter::setBatchRows(size_t rows) {
+	m_batchRows = std::max<size_t>(rows, 1);
+}
+
+void ArrowExporter::setThreadNum(size_t threadNum) {
+	m_threadNum = std::max<size_t>(threadNum, 1);
+}
+
+void ArrowExporter::snapshotSegments(valvec<ReadableSegmentPtr>* segs,
+									 valvec<llong>* rows) const {
+	MyRwLock lock(m_tab->m_rwMutex, true);
+	m_tab->m_tableScanningRefCount++;
+	for (auto& seg : m_tab->m_segments) {
+		segs->push_back(seg);
+		rows->push_back(seg->m_isDel.size());
+	}
+}
+
+void ArrowExporter::releaseScanning() const {
+	MyRwLock lock(m_tab->m_rwMutex, true);
+	m_tab->m_tableScanningRefCount--;
+}
+
+void ArrowExporter::exportSegment(const ReadableSegment* seg, llong rows,
+								  StreamWriter* out, DbContext* ctx) const {
+	// deletions are taken once under m_segMutex, so a concurrent removeRow
+	// is either seen by the whole segment or not at all
+	febitvec isDel;
+	{
+		SpinRwLock lock(seg->m_segMutex, false);
+		isDel = febitvec(seg->m_isDel, 0, size_t(rows));
+	}
+	if (auto rdseg = seg->getReadonlySegment()) {
+		exportReadonlySegment(rdseg, rows, isDel, out, ctx);
+		return;
+	}
+	const Schema& rowSchema = m_tab->rowSchema();
+	valvec<byte>& row = ctx->buf1;
+	ColumnVec& cols = ctx->cols1;
+	for (llong id = 0; id < rows; ++id) {
+		if (isDel[id])
+			continue;
+		seg->getValue(id, &row, ctx);
+		rowSchema.parseRow(row, &cols);
+		auto appendRow = [&]() {
+			for (size_t k = 0; k < m_columns.size(); ++k) {
+				if (!out->m_cols[k].append(cols[m_columns[k]]))
+					return false;
+			}
+			return true;
+		};
+		while (!appendRow())
+			out->cutBatch(); // throws if the batch is empty
+		out->addRows(1);
+	}
+}
+
+void ArrowExporter::exportReadonlySegment(const ReadonlySegment* seg, llong rows,
+										  const febitvec& isDel,
+										  StreamWriter* out, DbContext* ctx)
+const {
+	const SchemaConfig& sconf = *m_tab->m_schema;
+	valvec<ColgroupReader> readers;
+	valvec<size_t> cgToReader(sconf.getColgroupNum(), size_t(-1));
+	for (size_t k = 0; k < m_columns.size(); ++k) {
+		auto cp = sconf.m_colproject[m_columns[k]];
+		size_t& r = cgToReader[cp.colgroupId];
+		if (size_t(-1) == r) {
+			r = readers.size();
+			readers.emplace_back();
+			readers.back().init(seg->m_colgroups[cp.colgroupId].get(),
+								&sconf.getColgroupSchema(cp.colgroupId), ctx);
+		}
+		readers[r].cols.push_back(std::make_pair(size_t(cp.subColumnId), k));
+	}
+	if (0 == isDel.popcnt() && seg->m_isPurged.empty()) {
+		// physicId == logicId
+		for (size_t beg = 0; beg < size_t(rows); ) {
+			size_t num = std::min(size_t(rows) - beg, m_batchRows - out->m_rows);
+			// var length colgroups first, the block is cut at the first row
+			// which does not fit in the batch
+			for (auto& r : readers) {
+				if (!r.hasVarLen(out))
+					continue;
+				for (size_t i = 0; i < num; ++i) {
+					if (!r.appendRow(beg + i, out, ctx)) {
+						num = i;
+						break;
+					}
+				}
+			}
+			out->truncateRows(num);
+			if (0 == num) {
+				out->cutBatch(); // throws if the batch is empty
+				continue;
+			}
+			for (auto& r : readers) {
+				if (r.hasVarLen(out))
+					continue;
+				if (!r.appendBlock(beg, num, out, ctx)) {
+					for (size_t i = 0; i < num; ++i)
+						r.appendRow(beg + i, out, ctx);
+				}
+			}
+			out->addRows(num);
+			beg += num;
+		}
+		return;
+	}
+	auto appendRow = [&](size_t physicId) {
+		for (auto& r : readers) {
+			if (!r.appendRow(physicId, out, ctx))
+				return false;
+		}
+		return true;
+	};
+	for (size_t logicId = 0; logicId < size_t(rows); ++logicId) {
+		if (isDel[logicId])
+			continue; // purged rows are also deleted
+		size_t physicId = seg->getPhysicId(logicId);
+		while (!appendRow(physicId))
+			out->cutBatch(); // throws if the batch is empty
+		out->addRows(1);
+	}
+}
+
+llong ArrowExporter::exportTable(PathRef fpath) {
+	valvec<ReadableSegmentPtr> segs;
+	valvec<llong> rows;
+	snapshotSegments(&segs, &rows);
+	const ArrowExporter* self = this;
+	BOOST_SCOPE_EXIT(self) {
+		self->releaseScanning();
+	} BOOST_SCOPE_EXIT_END;
+	DbContextPtr ctx(m_tab->createDbContext());
+	StreamWriter out(this, fpath);
+	for (size_t i = 0; i < segs.size(); ++i) {
+		exportSegment(segs[i].get(), rows[i], &out, ctx.get());
+	}
+	out.finish();
+	fprintf(stderr, "INFO: ArrowExporter: %s: segments = %zd, rows = %lld\n"
+		, fpath.string().c_str(), segs.size(), out.m_totalRows);
+	return out.m_totalRows;
+}
+
+llong ArrowExporter::exportSegments(PathRef dir) {
+	valvec<ReadableSegmentPtr> segs;
+	valvec<llong> rows;
+	snapshotSegments(&segs, &rows);
+	const ArrowExporter* self = this;
+	BOOST_SCOPE_EXIT(self) {
+		self->releaseScanning();
+	} BOOST_SCOPE_EXIT_END;
+	fs::create_directories(dir);
+	std::atomic<size_t> nextSeg(0);
+	std::atomic<llong>  totalRows(0);
+	std::mutex mutex;
+	std::exception_ptr error;
+	auto worker = [&]() {
+		try {
+			DbContextPtr ctx(m_tab->createDbContext());
+			for (;;) {
+				size_t i = nextSeg++;
+				if (i >= segs.size())
+					break;
+				char fname[32];
+				snprintf(fname, sizeof(fname), "seg-%04zd.arrows", i);
+				StreamWriter out(this, dir / fname);
+				exportSegment(segs[i].get(), rows[i], &out, ctx.get());
+				out.finish();
+				totalRows += out.m_totalRows;
+			}
+		}
+		catch (...) {
+			std::unique_lock<std::mutex> lock(mutex);
+			if (!error)
+				error = std::current_exception();
+			nextSeg = segs.size(); // stop other workers
+		}
+	};
+	const size_t threadNum = std::max<size_t>(1, std::min(m_threadNum, segs.size()));
+	valvec<tbb::tbb_thread*> threads;
+	for (size_t i = 1; i < threadNum; ++i) {
+		threads.push_back(new tbb::tbb_thread(worker));
+	}
+	worker(); // current thread is also a worker
+	for (auto t : threads) {
+		t->join();
+		delete t;
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	fprintf(stderr, "INFO: ArrowExporter: %s: segments = %zd, rows = %lld, threads = %zd\n"
+		, dir.string().c_str(), segs.size(), llong(totalRows), threadNum);
+	return totalRows;
+}
+
+}} // namespace terark::db
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "db_table.hpp"
+#include "db_segment.hpp"
+
+namespace terark { namespace db {
+
+// Export rows of a table in Apache Arrow IPC streaming format, which can be
+// read by pyarrow.ipc.open_stream and other arrow based tools, the arrow
+// metadata(flatbuffers) is encoded directly, arrow library is not needed:
+//
+//   ArrowExporter exporter(tab);
+//   exporter.setColumns("id,name,price"); // optional, default all columns
+//   exporter.exportTable(fpath);          // all segments to one stream
+//   exporter.exportSegments(dir);         // one stream per segment
+//
+// ReadonlySegments are scanned colgroup by colgroup, single column fixed
+// length colgroups of segments without deleted rows are copied to arrow
+// buffers in blocks. Deleted rows are skipped, all fields are not nullable.
+//
+// Column types are mapped as:
+//   Uint08 ... Sint64, VarUint, VarSint -> Int
+//   Float32, Float64                    -> FloatingPoint
+//   Uint128, Sint128, Float128, Uuid, Fixed -> FixedSizeBinary
+//   StrZero                             -> Utf8
+//   TwoStrZero, Binary, CarBin          -> Binary
+// Any, Nested and Decimal128 are not supported.
+class TERARK_DB_DLL ArrowExporter : boost::noncopyable {
+public:
+	explicit ArrowExporter(CompositeTable* tab);
+	~ArrowExporter();
+
+	void setColumns(const valvec<size_t>& columnIds);
+	void setColumns(fstring columnNames, char delim = ',');
+	void setBatchRows(size_t rows);
+	void setThreadNum(size_t threadNum);
+
+	///@returns number of exported rows
+	llong exportTable(PathRef fpath);
+
+	///@{ segment i is exported to dir/seg-NNNN.arrows by multiple threads,
+	/// each file is a complete stream with the same schema
+	///@returns number of exported rows
+	llong exportSegments(PathRef dir);
+	///@}
+
+private:
+	class  StreamWriter;
+	struct ColgroupReader;
+	void snapshotSegments(valvec<ReadableSegmentPtr>* segs,
+						  valvec<llong>* rows) const;
+	void releaseScanning() const;
+	void exportSegment(const ReadableSegment*, llong rows,
+					   StreamWriter*, DbContext*) const;
+	void exportReadonlySegment(const ReadonlySegment*, llong rows,
+							   const febitvec& isDel,
+							   StreamWriter*, DbContext*) const;
+
+	CompositeTablePtr m_tab;
+	valvec<size_t> m_columns;
+	size_t m_batchRows;
+	size_t m_threadNum;
+};
+
+}} // namespace terark::db
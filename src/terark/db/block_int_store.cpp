@@ -0,0 +1,342 @@
+#include "block_int_store.hpp"
+#include <terark/io/FileStream.hpp>
+#include <terark/io/DataIO.hpp>
+#include <terark/bitmanip.hpp>
+#include <terark/util/mmap.hpp>
+
+namespace terark { namespace db {
+
+const size_t BlockIntStore::BlockSize; // odr used by std::min
+
+BlockIntStore::BlockIntStore(const Schema& schema) {
+	TERARK_RT_assert(schema.columnNum() == 1, std::invalid_argument);
+	m_intType = schema.getColumnMeta(0).type;
+	m_rows = 0;
+	m_mmapBase = nullptr;
+	m_mmapSize = 0;
+}
+BlockIntStore::~BlockIntStore() {
+	if (m_mmapBase) {
+		m_blocks.risk_release_ownership();
+		m_data.risk_release_ownership();
+		mmap_close(m_mmapBase, m_mmapSize);
+	}
+}
+
+llong BlockIntStore::dataStorageSize() const {
+	return m_blocks.used_mem_size() + m_data.used_mem_size();
+}
+
+llong BlockIntStore::dataInflateSize() const {
+	switch (m_intType) {
+	default:
+		THROW_STD(invalid_argument,
+			"Bad m_intType=%s", Schema::columnTypeStr(m_intType));
+	case ColumnType::Sint08:
+	case ColumnType::Uint08: return 1 * m_rows;
+	case ColumnType::Sint16:
+	case ColumnType::Uint16: return 2 * m_rows;
+	case ColumnType::Sint32:
+	case ColumnType::Uint32: return 4 * m_rows;
+	case ColumnType::Sint64:
+	case ColumnType::Uint64: return 8 * m_rows;
+	}
+}
+
+llong BlockIntStore::numDataRows() const {
+	return m_rows;
+}
+
+size_t BlockIntStore::numBlocks(BlockMode mode) const {
+	size_t num = 0;
+	for (size_t i = 0; i < m_blocks.size(); ++i) {
+		num += BlockMode(m_blocks[i].mode) == mode;
+	}
+	return num;
+}
+
+static inline size_t wireBits(uint64_t maxWire) {
+	return maxWire ? terark_bsr_u64(maxWire) + 1 : 0;
+}
+static inline size_t wireMask(size_t bits) {
+	return 64 == bits ? size_t(-1) : (size_t(1) << bits) - 1;
+}
+
+void BlockIntStore::decodeBlock(size_t blockIdx, size_t beg, size_t end,
+								llong* values) const {
+	assert(beg <= end);
+	assert(end <= BlockSize);
+	const BlockMeta& blk = m_blocks[blockIdx];
+	const byte* data = m_data.data() + blk.offset;
+	const size_t bits = blk.bits;
+	size_t wire[BlockSize];
+	if (BlockMode::linear == BlockMode(blk.mode)) {
+		UintVecMin0::fast_get_block(data, bits, wireMask(bits), beg, end - beg, wire);
+		uint64_t x = blk.base + beg * blk.slope;
+		for (size_t i = 0; i < end - beg; ++i, x += blk.slope) {
+			values[i] = llong(x + wire[i]);
+		}
+	}
+	else {
+		UintVecMin0::fast_get_block(data, bits, wireMask(bits), 0, end, wire);
+		uint64_t x = blk.base;
+		for (size_t i = 0; i < end; ++i) {
+			x += wire[i];
+			if (i >= beg)
+				values[i - beg] = llong(x);
+			x += blk.slope;
+		}
+	}
+}
+
+uint64_t BlockIntStore::getWire(size_t id) const {
+	assert(id < m_rows);
+	const BlockMeta& blk = m_blocks[id / BlockSize];
+	size_t i = id % BlockSize;
+	if (BlockMode::linear == BlockMode(blk.mode)) {
+		const byte* data = m_data.data() + blk.offset;
+		size_t w = UintVecMin0::fast_get(data, blk.bits, wireMask(blk.bits), i);
+		return blk.base + i * blk.slope + w;
+	}
+	llong x;
+	decodeBlock(id / BlockSize, i, i + 1, &x);
+	return uint64_t(x);
+}
+
+void BlockIntStore::getInt64Batch(size_t recBeg, size_t num, llong* values) const {
+	assert(recBeg + num <= m_rows);
+	size_t id = recBeg, end = recBeg + num;
+	while (id < end) {
+		size_t blockIdx = id / BlockSize;
+		size_t beg = id % BlockSize;
+		size_t len = std::min(BlockSize - beg, end - id);
+		decodeBlock(blockIdx, beg, beg + len, values);
+		values += len;
+		id += len;
+	}
+}
+
+template<class Int>
+void BlockIntStore::valueBatchAppend(const llong* values, size_t num,
+									 valvec<byte>* res) const {
+	byte* dst = res->grow_no_init(sizeof(Int) * num);
+	for (size_t i = 0; i < num; ++i) {
+		unaligned_save<Int>(dst + sizeof(Int) * i, Int(values[i]));
+	}
+}
+
+void BlockIntStore::getValueBatchAppend(size_t recBeg, size_t num,
+										valvec<byte>* vals) const {
+	llong values[BlockSize];
+	for (size_t i = 0; i < num; i += BlockSize) {
+		size_t n = std::min(num - i, BlockSize);
+		getInt64Batch(recBeg + i, n, values);
+		switch (m_intType) {
+		default:
+			THROW_STD(invalid_argument, "Bad m_intType=%s", Schema::columnTypeStr(m_intType));
+		case ColumnType::Sint08: valueBatchAppend< int8_t >(values, n, vals); break;
+		case ColumnType::Uint08: valueBatchAppend<uint8_t >(values, n, vals); break;
+		case ColumnType::Sint16: valueBatchAppend< int16_t>(values, n, vals); break;
+		case ColumnType::Uint16: valueBatchAppend<uint16_t>(values, n, vals); break;
+		case ColumnType::Sint32: valueBatchAppend< int32_t>(values, n, vals); break;
+		case ColumnType::Uint32: valueBatchAppend<uint32_t>(values, n, vals); break;
+		case ColumnType::Sint64: valueBatchAppend< int64_t>(values, n, vals); break;
+		case ColumnType::Uint64: valueBatchAppend<uint64_t>(values, n, vals); break;
+		}
+	}
+}
+
+void BlockIntStore::getValueAppend(llong id, valvec<byte>* val, DbContext*) const {
+	assert(id >= 0);
+	assert(id < llong(m_rows));
+	llong x = llong(getWire(size_t(id)));
+	switch (m_intType) {
+	default:
+		THROW_STD(invalid_argument, "Bad m_intType=%s", Schema::columnTypeStr(m_intType));
+	case ColumnType::Sint08: valueBatchAppend< int8_t >(&x, 1, val); break;
+	case ColumnType::Uint08: valueBatchAppend<uint8_t >(&x, 1, val); break;
+	case ColumnType::Sint16: valueBatchAppend< int16_t>(&x, 1, val); break;
+	case ColumnType::Uint16: valueBatchAppend<uint16_t>(&x, 1, val); break;
+	case ColumnType::Sint32: valueBatchAppend< int32_t>(&x, 1, val); break;
+	case ColumnType::Uint32: valueBatchAppend<uint32_t>(&x, 1, val); break;
+	case ColumnType::Sint64: valueBatchAppend< int64_t>(&x, 1, val); break;
+	case ColumnType::Uint64: valueBatchAppend<uint64_t>(&x, 1, val); break;
+	}
+}
+
+StoreIterator* BlockIntStore::createStoreIterForward(DbContext*) const {
+	return new BatchStoreIterForward<BlockIntStore>(this);
+}
+
+StoreIterator* BlockIntStore::createStoreIterBackward(DbContext*) const {
+	return nullptr; // not needed
+}
+
+template<class Int>
+void BlockIntStore::loadValues(const void* data, size_t rows,
+							   valvec<uint64_t>* values) {
+	const Int* src = (const Int*)data;
+	values->resize_no_init(rows);
+	for (size_t i = 0; i < rows; ++i) {
+		(*values)[i] = uint64_t(src[i]); // sign extended for signed Int
+	}
+}
+
+namespace {
+	struct BlockLayout {
+		uint64_t base;
+		uint64_t slope;
+		uint64_t maxWire;
+		BlockIntStore::BlockMode mode;
+		void linear(const uint64_t* x, size_t n, uint64_t slope1) {
+			int64_t rmin = 0;
+			for (size_t i = 0; i < n; ++i) {
+				int64_t r = int64_t(x[i] - x[0] - i * slope1);
+				rmin = std::min(rmin, r);
+			}
+			maxWire = 0;
+			for (size_t i = 0; i < n; ++i) {
+				uint64_t w = x[i] - x[0] - i * slope1 - uint64_t(rmin);
+				maxWire = std::max(maxWire, w);
+			}
+			base = x[0] + uint64_t(rmin);
+			slope = slope1;
+			mode = BlockIntStore::BlockMode::linear;
+		}
+		void delta(const uint64_t* x, size_t n) {
+			int64_t dmin = n > 1 ? int64_t(x[1] - x[0]) : 0;
+			for (size_t i = 2; i < n; ++i) {
+				dmin = std::min(dmin, int64_t(x[i] - x[i-1]));
+			}
+			maxWire = 0;
+			for (size_t i = 1; i < n; ++i) {
+				maxWire = std::max(maxWire, x[i] - x[i-1] - uint64_t(dmin));
+			}
+			base = x[0];
+			slope = uint64_t(dmin);
+			mode = BlockIntStore::BlockMode::delta;
+		}
+		uint64_t wire(const uint64_t* x, size_t i) const {
+			if (BlockIntStore::BlockMode::linear == mode)
+				return x[i] - base - i * slope;
+			else
+				return i ? x[i] - x[i-1] - slope : 0;
+		}
+	};
+}
+
+void BlockIntStore::build(ColumnType intType, SortableStrVec& strVec) {
+	assert(strVec.m_index.size() == 0);
+	m_intType = intType;
+	const void* data = strVec.m_strpool.data();
+	const size_t size = strVec.m_strpool.size();
+	valvec<uint64_t> x;
+	switch (intType) {
+	default:
+		THROW_STD(invalid_argument, "Bad intType=%s", Schema::columnTypeStr(intType));
+	case ColumnType::Sint08: loadValues< int8_t >(data, size / 1, &x); break;
+	case ColumnType::Uint08: loadValues<uint8_t >(data, size / 1, &x); break;
+	case ColumnType::Sint16: loadValues< int16_t>(data, size / 2, &x); break;
+	case ColumnType::Uint16: loadValues<uint16_t>(data, size / 2, &x); break;
+	case ColumnType::Sint32: loadValues< int32_t>(data, size / 4, &x); break;
+	case ColumnType::Uint32: loadValues<uint32_t>(data, size / 4, &x); break;
+	case ColumnType::Sint64: loadValues< int64_t>(data, size / 8, &x); break;
+	case ColumnType::Uint64: loadValues<uint64_t>(data, size / 8, &x); break;
+	}
+	m_rows = x.size();
+	m_blocks.resize_no_init((m_rows + BlockSize - 1) / BlockSize);
+	m_data.erase_all();
+	for (size_t b = 0; b < m_blocks.size(); ++b) {
+		const uint64_t* bx = x.data() + b * BlockSize;
+		const size_t n = std::min(BlockSize, m_rows - b * BlockSize);
+		// frame of reference, linear fit, then delta, smallest wins
+		BlockLayout best, curr;
+		best.linear(bx, n, 0);
+		if (n > 1) {
+			curr.linear(bx, n, uint64_t(int64_t(bx[n-1] - bx[0]) / llong(n-1)));
+			if (curr.maxWire < best.maxWire)
+				best = curr;
+			curr.delta(bx, n);
+			if (wireBits(curr.maxWire) < wireBits(best.maxWire))
+				best = curr;
+		}
+		const size_t bits = wireBits(best.maxWire);
+		if (bits > 58) {
+			THROW_STD(logic_error, "bits=%zd is too large(max=58)", bits);
+		}
+		BlockMeta& blk = m_blocks[b];
+		blk.base = best.base;
+		blk.slope = best.slope;
+		blk.offset = m_data.size();
+		blk.bits = bits;
+		blk.mode = byte(best.mode);
+		size_t bytes = (bits * n + 7) / 8;
+		m_data.resize(blk.offset + bytes + 8, 0); // 8 for unaligned save
+		byte* bdata = m_data.data() + blk.offset;
+		for (size_t i = 0; i < n; ++i) {
+			size_t bitIdx = bits * i;
+			uint64_t w = best.wire(bx, i);
+			uint64_t u = unaligned_load<uint64_t>(bdata + bitIdx / 8);
+			unaligned_save<uint64_t>(bdata + bitIdx / 8, u | w << bitIdx % 8);
+		}
+		m_data.risk_set_size(blk.offset + bytes);
+	}
+	// padding for unaligned load and gather of fast_get_block
+	size_t used = m_data.size();
+	m_data.resize((used + sizeof(uint64_t) + 15) & ~size_t(15), 0);
+#if !defined(NDEBUG)
+	for (size_t i = 0; i < m_rows; ++i) {
+		assert(getWire(i) == x[i]);
+	}
+#endif
+}
+
+namespace {
+	struct BlockIntStoreHeader {
+		uint64_t rows;
+		uint64_t blockNum;
+		uint64_t dataBytes;
+		uint8_t  intType;
+		uint8_t  padding1;
+		uint16_t padding2;
+		uint32_t padding3;
+	};
+	BOOST_STATIC_ASSERT(sizeof(BlockIntStoreHeader) == 32);
+	BOOST_STATIC_ASSERT(sizeof(BlockIntStore::BlockMeta) == 24);
+}
+
+TERARK_DB_REGISTER_STORE("bint", BlockIntStore);
+
+void BlockIntStore::load(PathRef fpath) {
+	assert(fstring(fpath.string()).endsWith(".bint"));
+	m_mmapBase = (byte_t*)mmap_load(fpath.string(), &m_mmapSize);
+	auto header = (const BlockIntStoreHeader*)m_mmapBase;
+	size_t blockBytes = sizeof(BlockMeta) * header->blockNum;
+	if (sizeof(*header) + blockBytes + header->dataBytes > m_mmapSize) {
+		THROW_STD(invalid_argument, "path=%s, broken data: fileSize=%zd"
+			, fpath.string().c_str(), m_mmapSize);
+	}
+	m_rows = header->rows;
+	m_intType = ColumnType(header->intType);
+	m_blocks.risk_set_data((BlockMeta*)(header + 1), header->blockNum);
+	m_data.risk_set_data((byte*)(header + 1) + blockBytes, header->dataBytes);
+}
+
+void BlockIntStore::save(PathRef path) const {
+	auto fpath = path + ".bint";
+	NativeDataOutput<FileStream> dio;
+	dio.open(fpath.string().c_str(), "wb");
+	BlockIntStoreHeader header;
+	header.rows = m_rows;
+	header.blockNum = m_blocks.size();
+	header.dataBytes = m_data.size();
+	header.intType = byte(m_intType);
+	header.padding1 = 0;
+	header.padding2 = 0;
+	header.padding3 = 0;
+	dio.ensureWrite(&header, sizeof(header));
+	dio.ensureWrite(m_blocks.data(), m_blocks.used_mem_size());
+	dio.ensureWrite(m_data.data(), m_data.used_mem_size());
+}
+
+}} // namespace terark::db
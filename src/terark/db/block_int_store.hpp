@@ -0,0 +1,74 @@
+#pragma once
+
+#include <terark/db/db_store.hpp>
+#include <terark/int_vector.hpp>
+#include <terark/util/sortable_strvec.hpp>
+
+namespace terark { namespace db {
+
+// Integer store split into blocks of 128 values, each block has its own
+// base, slope and bit width, so an outlier only widens its own block:
+//
+//   linear: x[i] = base + i*slope + w[i]
+//   delta : x[i] = base + i*slope + (w[0] + ... + w[i]), w[0] = 0
+//
+// linear with slope 0 is frame-of-reference, linear with slope of the
+// block is for evenly increasing columns, delta is for monotonic columns
+// with irregular steps such as timestamps. The smallest layout is picked
+// for each block at build time, arithmetic is modulo 2^64.
+class TERARK_DB_DLL BlockIntStore : public ReadableStore {
+public:
+	static const size_t BlockSize = 128;
+	enum class BlockMode : unsigned char {
+		linear,
+		delta,
+	};
+	struct BlockMeta {
+		uint64_t base;
+		uint64_t slope;
+		uint64_t offset : 48; // byte offset in m_data
+		uint64_t bits   :  8;
+		uint64_t mode   :  8;
+	};
+
+	explicit BlockIntStore(const Schema& schema);
+	~BlockIntStore();
+
+	llong dataStorageSize() const override;
+	llong dataInflateSize() const override;
+	llong numDataRows() const override;
+	void getValueAppend(llong id, valvec<byte>* val, DbContext*) const override;
+	StoreIterator* createStoreIterForward(DbContext*) const override;
+	StoreIterator* createStoreIterBackward(DbContext*) const override;
+
+	///@{ batch read of contiguous ids [recBeg, recBeg+num), decoded block
+	/// by block, values are widened to llong
+	void getInt64Batch(size_t recBeg, size_t num, llong* values) const;
+	void getValueBatchAppend(size_t recBeg, size_t num, valvec<byte>* vals) const;
+	///@}
+
+	// only fixed size integer types
+	void build(ColumnType intType, SortableStrVec& strVec);
+	void load(PathRef path) override;
+	void save(PathRef path) const override;
+
+	size_t numBlocks(BlockMode mode) const;
+
+protected:
+	valvec<BlockMeta> m_blocks;
+	valvec<byte>      m_data;
+	size_t      m_rows;
+	byte_t*     m_mmapBase;
+	size_t      m_mmapSize;
+	ColumnType  m_intType;
+
+	uint64_t getWire(size_t id) const;
+	void decodeBlock(size_t blockIdx, size_t beg, size_t end, llong* values) const;
+
+	template<class Int>
+	void loadValues(const void* data, size_t rows, valvec<uint64_t>* values);
+	template<class Int>
+	void valueBatchAppend(const llong* values, size_t num, valvec<byte>* res) const;
+};
+
+}} // namespace terark::db
@@ -0,0 +1,450 @@
+#include "db_bulk_load.hpp"
+#include "db_trace.hpp"
+#include "db_context.hpp"
+#include <terark/util/mmap.hpp>
+#include <terark/util/profiling.hpp>
+#include <tbb/tbb_thread.h>
+#include <boost/filesystem.hpp>
+#include <condition_variable>
+#include <atomic>
+#if defined(_MSC_VER)
+	#include <process.h>
+	#define getpid _getpid
+#else
+	#include <unistd.h>
+#endif
+
+namespace terark { namespace db {
+
+namespace fs = boost::filesystem;
+
+struct BulkLoader::Worker {
+	tbb::tbb_thread*   thread;
+	ReadonlySegmentPtr seg;
+	std::exception_ptr error;
+	SortableStrVec     rows;
+	Worker() : thread(NULL) {}
+	~Worker() { delete thread; }
+};
+
+BulkLoader::BulkLoader(CompositeTable* tab) : m_tab(tab) {
+	m_sortIndexId = size_t(-1);
+	m_threadNum = tbb::tbb_thread::hardware_concurrency();
+	if (const char* env = getenv("TerarkDB_BulkLoadThreads")) {
+		m_threadNum = (size_t)strtoull(env, NULL, 10);
+	}
+	m_threadNum = std::max<size_t>(m_threadNum, 1);
+	m_chunkSize = size_t(tab->m_schema->m_maxWritingSegmentSize);
+	m_chunkNum = 0;
+	m_rowNum = 0;
+	m_presorted = false;
+	m_finished = false;
+	// chunk dirs of concurrent loaders, even in other processes, must not
+	// collide, stale dirs of crashed loaders are removed on table open
+	static std::atomic<size_t> loaderSeq(0);
+	char szBuf[64];
+	snprintf(szBuf, sizeof(szBuf), "bulk-%d-%zd-", int(getpid()), loaderSeq++);
+	m_tmpPrefix = szBuf;
+}
+
+BulkLoader::~BulkLoader() {
+	if (!m_finished) {
+		while (!m_workers.empty()) {
+			try { joinOldestWorker(); }
+			catch (const std::exception& ex) {
+				fprintf(stderr, "ERROR: BulkLoader: ex.what = %s\n", ex.what());
+			}
+		}
+		m_segs.clear();
+		removeTempSegments();
+	}
+}
+
+void BulkLoader::setSortIndex(size_t indexId, bool presorted) {
+	if (indexId >= m_tab->getIndexNum()) {
+		THROW_STD(invalid_argument, "indexId = %zd, indexNum = %zd"
+			, indexId, m_tab->getIndexNum());
+	}
+	if (m_rowNum) {
+		THROW_STD(invalid_argument, "must be called before addRow");
+	}
+	m_sortIndexId = indexId;
+	m_presorted = presorted;
+}
+
+void BulkLoader::setThreadNum(size_t threadNum) {
+	m_threadNum = std::max<size_t>(threadNum, 1);
+}
+
+void BulkLoader::setChunkSize(size_t bytes) {
+	m_chunkSize = bytes;
+}
+
+void BulkLoader::addRow(fstring row) {
+	assert(!m_finished);
+	if (m_presorted) {
+		const Schema& rowSchema = *m_tab->m_schema->m_rowSchema;
+		const Schema& indexSchema = m_tab->getIndexSchema(m_sortIndexId);
+		rowSchema.parseRow(row, &m_cols);
+		indexSchema.selectParent(m_cols, &m_keyBuf);
+		if (m_rowNum && indexSchema.compareData(m_prevKey, m_keyBuf) > 0) {
+			THROW_STD(invalid_argument
+				, "rows are not sorted by index '%s' at row %lld"
+				, indexSchema.m_name.c_str(), m_rowNum);
+		}
+		m_prevKey.swap(m_keyBuf);
+	}
+	m_rows.push_back(row);
+	m_rowNum++;
+	if (m_rows.str_size() >= m_chunkSize) {
+		flushChunk();
+	}
+}
+
+void BulkLoader::sortChunk(SortableStrVec& rows) const {
+	const Schema& rowSchema = *m_tab->m_schema->m_rowSchema;
+	const Schema& indexSchema = m_tab->getIndexSchema(m_sortIndexId);
+	SortableStrVec keys;
+	ColumnVec cols;
+	valvec<byte> key;
+	for (size_t i = 0; i < rows.size(); ++i) {
+		rowSchema.parseRow(rows[i], &cols);
+		indexSchema.selectParent(cols, &key);
+		keys.push_back(key);
+	}
+	valvec<uint32_t> order;
+	indexSchema.sortKeyIds(keys.size(), [&](size_t i) { return keys[i]; }, &order);
+	SortableStrVec sorted;
+	sorted.m_index.reserve(rows.size());
+	sorted.m_strpool.reserve(rows.str_size());
+	for (size_t i = 0; i < order.size(); ++i) {
+		sorted.push_back(rows[order[i]]);
+	}
+	rows.swap(sorted);
+}
+
+void BulkLoader::flushChunk() {
+	if (m_rows.size() == 0)
+		return;
+	while (m_workers.size() >= m_threadNum) {
+		joinOldestWorker();
+	}
+	std::unique_ptr<Worker> w(new Worker());
+	w->rows.swap(m_rows);
+	size_t chunkIdx = m_chunkNum++;
+	char szBuf[32];
+	snprintf(szBuf, sizeof(szBuf), "%04zd.tmp", chunkIdx);
+	w->seg = m_tab->myCreateReadonlySegment(m_tab->m_dir / (m_tmpPrefix + szBuf));
+	Worker* pw = w.get();
+	auto build = [this, pw, chunkIdx]() {
+		try {
+			if (m_sortIndexId < m_tab->getIndexNum() && !m_presorted) {
+				BgTaskTraceScope trace("bulkload", "sort",
+					m_tab->m_dir.string(), chunkIdx);
+				sortChunk(pw->rows);
+			}
+			pw->seg->buildFromRows(pw->rows, m_tab->m_dir.string(), chunkIdx);
+		}
+		catch (...) {
+			pw->error = std::current_exception();
+		}
+		pw->rows.clear();
+	};
+	w->thread = new tbb::tbb_thread(build);
+	m_workers.push_back(w.release());
+}
+
+void BulkLoader::joinOldestWorker() {
+	assert(!m_workers.empty());
+	std::unique_ptr<Worker> w(m_workers[0]);
+	m_workers.erase_i(0, 1);
+	w->thread->join();
+	if (w->error) {
+		if (!m_error)
+			m_error = w->error;
+		w->seg = nullptr;
+	}
+	else {
+		m_segs.push_back(w->seg);
+	}
+}
+
+static void removeDirsWithPrefix(PathRef dir, fstring prefix) {
+	if (!fs::exists(dir))
+		return;
+	valvec<fs::path> tmpDirs;
+	for (auto& x : fs::directory_iterator(dir)) {
+		std::string fname = x.path().filename().string();
+		if (fstring(fname).startsWith(prefix) && fstring(fname).endsWith(".tmp")) {
+			tmpDirs.push_back(x.path());
+		}
+	}
+	for (auto& tmpDir : tmpDirs) {
+		fprintf(stderr, "INFO: BulkLoader: remove %s\n", tmpDir.string().c_str());
+		fs::remove_all(tmpDir);
+	}
+}
+
+void BulkLoader::removeTempSegments() {
+	removeDirsWithPrefix(m_tab->m_dir, m_tmpPrefix);
+}
+
+void BulkLoader::removeStaleTempSegments(PathRef tableDir) {
+	removeDirsWithPrefix(tableDir, "bulk-");
+}
+
+size_t BulkLoader::finish() {
+	assert(!m_finished);
+	flushChunk();
+	while (!m_workers.empty()) {
+		joinOldestWorker();
+	}
+	if (m_error) {
+		std::rethrow_exception(m_error);
+	}
+	m_tab->attachBulkSegments(m_segs);
+	m_finished = true;
+	size_t segNum = m_segs.size();
+	m_segs.clear();
+	return segNum;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+struct DelimTextLoader::Chunk {
+	SortableStrVec rows; // for BulkLoader
+	llong lines;
+	llong rowNum;
+	llong rejected;
+	bool  ready;
+	std::exception_ptr error;
+	Chunk() : lines(0), rowNum(0), rejected(0), ready(false) {}
+};
+
+DelimTextLoader::DelimTextLoader(CompositeTable* tab, char delim)
+  : m_tab(tab) {
+	memset(&m_stat, 0, sizeof(m_stat));
+	m_threadNum = tbb::tbb_thread::hardware_concurrency();
+	if (const char* env = getenv("TerarkDB_TextLoadThreads")) {
+		m_threadNum = (size_t)strtoull(env, NULL, 10);
+	}
+	m_threadNum = std::max<size_t>(m_threadNum, 1);
+	m_chunkSize = 16 << 20;
+	m_skipLines = 0;
+	m_delim = delim;
+}
+
+DelimTextLoader::~DelimTextLoader() {
+}
+
+void DelimTextLoader::setThreadNum(size_t threadNum) {
+	m_threadNum = std::max<size_t>(threadNum, 1);
+}
+
+void DelimTextLoader::setChunkSize(size_t bytes) {
+	m_chunkSize = std::max<size_t>(bytes, 4096);
+}
+
+void DelimTextLoader::setSkipLines(size_t lines) {
+	m_skipLines = lines;
+}
+
+void DelimTextLoader::setRejectCallback(const RejectCallback& onReject) {
+	m_onReject = onReject;
+}
+
+void DelimTextLoader::parseChunk(Chunk* c, fstring text, llong baseOffset,
+								 DbContext* ctx) {
+	const Schema& rowSchema = m_tab->rowSchema();
+	const size_t  colnum = rowSchema.columnNum();
+	valvec<byte>  row;
+	std::string   lastLine;
+	auto reject = [&](fstring line, llong offset, const char* reason) {
+		c->rejected++;
+		if (m_onReject) {
+			std::lock_guard<std::mutex> lock(m_rejectMutex);
+			m_onReject(line, offset, reason);
+		}
+	};
+	const char* pos = text.begin();
+	const char* end = text.end();
+	while (pos < end) {
+		const char* eol = (const char*)memchr(pos, '\n', end - pos);
+		llong offset = baseOffset + (pos - text.begin());
+		fstring line;
+		if (eol) {
+			line = fstring(pos, eol);
+			pos = eol + 1;
+		}
+		else {
+			// no '\n' at file end, strtol on mmap could read out of range
+			lastLine.assign(pos, end);
+			line = lastLine;
+			pos = end;
+		}
+		if (line.size() && '\r' == line.end()[-1]) {
+			line.n--;
+		}
+		c->lines++;
+		if (line.empty())
+			continue;
+		try {
+			size_t parsed = rowSchema.parseDelimText(m_delim, line, &row);
+			if (parsed != colnum) {
+				reject(line, offset, "bad column number");
+			}
+			else if (ctx) {
+				if (ctx->insertRow(row) < 0)
+					reject(line, offset, "insertRow failed");
+				else
+					c->rowNum++;
+			}
+			else {
+				c->rows.push_back(row);
+				c->rowNum++;
+			}
+		}
+		catch (const std::exception& ex) {
+			reject(line, offset, ex.what());
+		}
+	}
+}
+
+llong DelimTextLoader::loadFile(fstring fname, BulkLoader* bulk) {
+	assert(nullptr != bulk);
+	return doLoadFile(fname, bulk);
+}
+
+llong DelimTextLoader::loadFile(fstring fname) {
+	return doLoadFile(fname, nullptr);
+}
+
+llong DelimTextLoader::doLoadFile(fstring fname, BulkLoader* bulk) {
+	profiling pf;
+	llong t0 = pf.now();
+	if (fs::file_size(fname.str()) == 0)
+		return 0;
+	MmapWholeFile mmap(fname.str());
+	const char* base = (const char*)mmap.base;
+	const char* end = base + mmap.size;
+	const char* beg = base;
+	for (size_t i = 0; i < m_skipLines && beg < end; ++i) {
+		const char* eol = (const char*)memchr(beg, '\n', end - beg);
+		beg = eol ? eol + 1 : end;
+		m_stat.lines++;
+	}
+	// split at line boundaries
+	valvec<const char*> bounds;
+	bounds.push_back(beg);
+	while (bounds.back() < end) {
+		const char* pos = bounds.back() + std::min<size_t>(m_chunkSize, end - bounds.back());
+		if (pos < end) {
+			const char* eol = (const char*)memchr(pos, '\n', end - pos);
+			pos = eol ? eol + 1 : end;
+		}
+		bounds.push_back(pos);
+	}
+	const size_t chunkNum = bounds.size() - 1;
+	const size_t threadNum = std::max<size_t>(1, std::min(m_threadNum, chunkNum));
+	const size_t window = threadNum * 2; // parsed chunks in memory
+	valvec<Chunk> chunks(chunkNum);
+	std::mutex mutex;
+	std::condition_variable cond;
+	size_t nextChunk = 0;
+	size_t consumed = 0;
+	bool   stopped = false;
+	auto worker = [&]() {
+		DbContextPtr ctx;
+		if (nullptr == bulk)
+			ctx = m_tab->createDbContext();
+		for (;;) {
+			size_t k;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				if (bulk) {
+					cond.wait(lock, [&]() {
+						return stopped || nextChunk < consumed + window;
+					});
+				}
+				if (stopped || nextChunk >= chunkNum)
+					break;
+				k = nextChunk++;
+			}
+			Chunk* c = &chunks[k];
+			try {
+				parseChunk(c, fstring(bounds[k], bounds[k+1]), bounds[k] - base, ctx.get());
+			}
+			catch (...) {
+				c->error = std::current_exception();
+			}
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				c->ready = true;
+			}
+			cond.notify_all();
+		}
+	};
+	valvec<tbb::tbb_thread*> threads;
+	std::exception_ptr consumerEx;
+	if (bulk) {
+		for (size_t i = 0; i < threadNum; ++i) {
+			threads.push_back(new tbb::tbb_thread(worker));
+		}
+		try {
+			// feed rows in file order
+			for (size_t k = 0; k < chunkNum; ++k) {
+				Chunk* c = &chunks[k];
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cond.wait(lock, [c]() { return c->ready; });
+				}
+				if (c->error)
+					std::rethrow_exception(c->error);
+				for (size_t i = 0; i < c->rows.size(); ++i) {
+					bulk->addRow(c->rows[i]);
+				}
+				c->rows.clear();
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					consumed++;
+				}
+				cond.notify_all();
+			}
+		}
+		catch (...) {
+			consumerEx = std::current_exception();
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				stopped = true;
+			}
+			cond.notify_all();
+		}
+	}
+	else {
+		for (size_t i = 1; i < threadNum; ++i) {
+			threads.push_back(new tbb::tbb_thread(worker));
+		}
+		worker(); // current thread is also a worker
+	}
+	for (auto t : threads) {
+		t->join();
+		delete t;
+	}
+	if (consumerEx) {
+		std::rethrow_exception(consumerEx);
+	}
+	llong rows = 0;
+	for (auto& c : chunks) {
+		if (c.error)
+			std::rethrow_exception(c.error);
+		rows += c.rowNum;
+		m_stat.lines += c.lines;
+		m_stat.rejected += c.rejected;
+	}
+	m_stat.rows += rows;
+	m_stat.bytes += mmap.size;
+	m_stat.seconds += pf.sf(t0, pf.now());
+	return rows;
+}
+
+} } // namespace terark::db
@@ -0,0 +1,134 @@
+#ifndef __terark_db_db_bulk_load_hpp__
+#define __terark_db_db_bulk_load_hpp__
+
+#include "db_table.hpp"
+#include "db_segment.hpp"
+#include <terark/util/sortable_strvec.hpp>
+#include <functional>
+#include <mutex>
+
+namespace terark { namespace db {
+
+// Load rows directly into ReadonlySegments, bypass the writable segment,
+// so rows are not inserted, frozen and compressed again:
+//
+//   BulkLoader loader(tab);
+//   loader.setSortIndex(indexId); // optional
+//   while (...) loader.addRow(row);
+//   loader.finish();
+//
+// Rows are split into chunks of MaxWritingSegmentSize bytes, each chunk is
+// built into a ReadonlySegment by a background thread, finish() attaches
+// all new segments to the table at once.
+//
+// The writable segment of the table must be empty, unique indices are not
+// checked, the caller is responsible for the uniqueness of the rows
+class TERARK_DB_DLL BulkLoader : boost::noncopyable {
+public:
+	explicit BulkLoader(CompositeTable* tab);
+	~BulkLoader();
+
+	///@{ rows of each chunk are sorted by the index key, if presorted is
+	/// true, rows are just checked and not sorted, sorted rows make the
+	/// record id order same as index order, and may compress better
+	void setSortIndex(size_t indexId, bool presorted = false);
+	///@}
+
+	void setThreadNum(size_t threadNum);
+	void setChunkSize(size_t bytes);
+
+	void addRow(fstring row);
+
+	///@returns number of new segments
+	size_t finish();
+
+	llong numAddedRows() const { return m_rowNum; }
+
+	///@{ remove chunk dirs left by crashed loaders, called on table open
+	static void removeStaleTempSegments(PathRef tableDir);
+	///@}
+
+private:
+	struct Worker;
+	void flushChunk();
+	void sortChunk(SortableStrVec& rows) const;
+	void joinOldestWorker();
+	void removeTempSegments();
+
+	CompositeTablePtr m_tab;
+	std::string       m_tmpPrefix; // of chunk dirs, unique per loader
+	SortableStrVec    m_rows;
+	valvec<Worker*>   m_workers; // FIFO, in chunk order
+	valvec<ReadonlySegmentPtr> m_segs;
+	std::exception_ptr m_error;
+	valvec<byte> m_prevKey;
+	valvec<byte> m_keyBuf;
+	ColumnVec    m_cols;
+	size_t m_sortIndexId;
+	size_t m_threadNum;
+	size_t m_chunkSize;
+	size_t m_chunkNum;
+	llong  m_rowNum;
+	bool   m_presorted;
+	bool   m_finished;
+};
+
+// Parse delimited text file(s) such as TSV/CSV(without quoting) by
+// Schema::parseDelimText in parallel:
+//
+//   DelimTextLoader textLoader(tab, '\t');
+//   textLoader.loadFile(fname, &bulkLoader); // or textLoader.loadFile(fname)
+//   textLoader.stat(); // rows, rejected lines, bytes, seconds
+//
+// The file is mmap'ed and split into chunks at line boundaries, chunks
+// are parsed by multiple threads. Rows are fed to BulkLoader in file order,
+// or inserted to the table by each thread with its own DbContext.
+// Bad lines are counted and passed to the reject callback, they never stop
+// the loading.
+class TERARK_DB_DLL DelimTextLoader : boost::noncopyable {
+public:
+	struct Stat {
+		llong  lines;
+		llong  rows;
+		llong  rejected;
+		llong  bytes;
+		double seconds;
+		double rowsPerSec() const { return seconds > 0 ? rows / seconds : 0; }
+	};
+	///@param offset of the line in the file
+	typedef std::function<void(fstring line, llong offset, const char* reason)>
+			RejectCallback;
+
+	DelimTextLoader(CompositeTable* tab, char delim);
+	~DelimTextLoader();
+
+	void setThreadNum(size_t threadNum);
+	void setChunkSize(size_t bytes);
+	void setSkipLines(size_t lines); // skip header lines of each file
+	void setRejectCallback(const RejectCallback&);
+
+	///@{ return number of loaded rows of this file
+	llong loadFile(fstring fname, BulkLoader*);
+	llong loadFile(fstring fname); // by CompositeTable::insertRow
+	///@}
+
+	const Stat& stat() const { return m_stat; }
+
+private:
+	struct Chunk;
+	void parseChunk(Chunk*, fstring text, llong baseOffset, DbContext*);
+	llong doLoadFile(fstring fname, BulkLoader*);
+
+	CompositeTablePtr m_tab;
+	RejectCallback m_onReject;
+	std::mutex m_rejectMutex;
+	Stat   m_stat;
+	size_t m_threadNum;
+	size_t m_chunkSize;
+	size_t m_skipLines;
+	char   m_delim;
+};
+
+} } // namespace terark::db
+
+#endif // __terark_db_db_bulk_load_hpp__
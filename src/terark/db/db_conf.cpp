@@ -5,10 +5,12 @@
 //#include <terark/io/MemStream.hpp>
 //#include <terark/io/StreamBuffer.hpp>
 #include <terark/io/var_int.hpp>
+#include <terark/bitmanip.hpp>
 #include <terark/num_to_str.hpp>
-//#include <terark/util/sortable_strvec.hpp>
+#include <terark/util/sortable_strvec.hpp>
 #include <terark/util/linebuf.hpp>
 #include <string.h>
+#include <limits>
 #include "json.hpp"
 #include <boost/algorithm/string/join.hpp>
 
@@ -152,6 +154,7 @@ Schema::Schema() {
 	m_dictZipSampleRatio = 0.0;
 	m_canEncodeToLexByteComparable = false;
 	m_needEncodeToLexByteComparable = false;
+	m_canEncodeNormKey = false;
 	m_useFastZip = false;
 	m_dictZipLocalMatch = true;
 	m_isInplaceUpdatable = false;
@@ -161,9 +164,13 @@ Schema::Schema() {
 	m_maxFragLen = 0;
 	m_sufarrMinFreq = 0;
 	m_rankSelectClass = 512;
+	m_blockZipBytes = 0;
+	m_blockZipLevel = 1;
 	m_nltNestLevel = DEFAULT_nltNestLevel;
 	m_lastVarLenCol = 0;
 	m_restFixLenSum = 0;
+	m_fixedPrefixLen = 0;
+	m_parseKind = ParseKind::Generic;
 }
 Schema::~Schema() {
 }
@@ -226,11 +233,49 @@ void Schema::compile(const Schema* parent) {
 			break;
 		}
 	}
+	m_canEncodeNormKey = true;
+	for (size_t i = 0; i < colnum; ++i) {
+		switch (m_columnsMeta.val(i).type) {
+		default:
+			break;
+		case ColumnType::Any:
+		case ColumnType::Nested:
+		case ColumnType::Decimal128:
+			m_canEncodeNormKey = false;
+			break;
+		}
+	}
+	compileParsePlan();
 	if (m_name.empty()) {
 		m_name = joinColumnNames();
 	}
 }
 
+void Schema::compileParsePlan() {
+	size_t colnum = m_columnsMeta.end_i();
+	m_fixedPrefixCols.erase_all();
+	m_fixedPrefixLen = 0;
+	for (size_t i = 0; i < colnum; ++i) {
+		const ColumnMeta& colmeta = m_columnsMeta.val(i);
+		if (0 == colmeta.fixedLen)
+			break;
+		m_fixedPrefixCols.push_back({uint32_t(m_fixedPrefixLen), colmeta.fixedLen});
+		m_fixedPrefixLen += colmeta.fixedLen;
+	}
+	size_t prefixNum = m_fixedPrefixCols.size();
+	if (prefixNum == colnum) {
+		m_parseKind = ParseKind::AllFixed;
+	}
+	else if (prefixNum + 1 == colnum &&
+			(ColumnType::Binary == m_columnsMeta.val(prefixNum).type ||
+			 ColumnType::CarBin == m_columnsMeta.val(prefixNum).type)) {
+		m_parseKind = ParseKind::RestBin;
+	}
+	else {
+		m_parseKind = ParseKind::Generic;
+	}
+}
+
 void Schema::parseRow(fstring row, ColumnVec* columns) const {
 	assert(size_t(-1) != m_fixedLen);
 	columns->erase_all();
@@ -250,8 +295,25 @@ void Schema::parseRowAppend(fstring row, size_t start, ColumnVec* columns) const
 			long(len), long(last-curr)); \
 	}
 #define CHECK_CURR_LAST(len) CHECK_CURR_LAST3(curr, last, len)
+	// fixed length prefix by the parse plan, no per column switch
+	const size_t prefixNum = m_fixedPrefixCols.size();
+	const ColumnVec::Elem* plan = m_fixedPrefixCols.data();
+	CHECK_CURR_LAST(m_fixedPrefixLen);
+	ColumnVec::Elem* cols = columns->m_cols.grow_no_init(prefixNum);
+	for (size_t i = 0; i < prefixNum; ++i) {
+		cols[i].pos = uint32_t(start + plan[i].pos);
+		cols[i].len = plan[i].len;
+	}
+	curr += m_fixedPrefixLen;
+	if (ParseKind::AllFixed == m_parseKind) {
+		return;
+	}
+	if (ParseKind::RestBin == m_parseKind) {
+		columns->push_back(curr - base, last - curr);
+		return;
+	}
 	size_t colnum = m_columnsMeta.end_i();
-	for (size_t i = 0; i < colnum; ++i) {
+	for (size_t i = prefixNum; i < colnum; ++i) {
 #ifndef NDEBUG
 		const fstring colname = m_columnsMeta.key(i);
 #endif
@@ -417,8 +479,14 @@ Schema::combineRowAppend(const ColumnVec& myCols, valvec<byte>* myRowData)
 const {
 	assert(size_t(-1) != m_fixedLen);
 	assert(myCols.size() == m_columnsMeta.end_i());
+	const size_t prefixNum = m_fixedPrefixCols.size();
+	for (size_t i = 0; i < prefixNum; ++i) {
+		const fstring coldata = myCols[i];
+		assert(m_fixedPrefixCols[i].len == coldata.size());
+		myRowData->append(coldata.udata(), m_fixedPrefixCols[i].len);
+	}
 	size_t colnum = m_columnsMeta.end_i();
-	for (size_t i = 0; i < colnum; ++i) {
+	for (size_t i = prefixNum; i < colnum; ++i) {
 		const ColumnMeta& colmeta = m_columnsMeta.val(i);
 		const fstring coldata = myCols[i];
 		switch (colmeta.type) {
@@ -869,6 +937,490 @@ void Schema::byteLexConvert(byte* data, size_t size) const {
 	}
 }
 
+namespace {
+	template<class Uint>
+	inline void appendBigEndian(valvec<byte>* key, Uint x) {
+		BYTE_SWAP_IF_LITTLE_ENDIAN(x);
+		unaligned_save(key->grow_no_init(sizeof(Uint)), x);
+	}
+	template<class Uint>
+	inline Uint loadBigEndian(const byte* p) {
+		Uint x = unaligned_load<Uint>(p);
+		BYTE_SWAP_IF_LITTLE_ENDIAN(x);
+		return x;
+	}
+	// float bits to unsigned order, -0.0 is encoded as +0.0 because they
+	// are equal by compareData
+	template<class Uint>
+	inline Uint floatToNorm(Uint x) {
+		const Uint signBit = Uint(1) << (sizeof(Uint)*8 - 1);
+		if (signBit == x)
+			x = 0;
+		return (x & signBit) ? ~x : x | signBit;
+	}
+	template<class Uint>
+	inline Uint normToFloat(Uint x) {
+		const Uint signBit = Uint(1) << (sizeof(Uint)*8 - 1);
+		return (x & signBit) ? x & ~signBit : ~x;
+	}
+	// n LittleEndian bytes of a sign-magnitude(float) or two's complement
+	// (int) number are output as BigEndian, with sign normalized
+	void appendNormBytes(valvec<byte>* key, const byte* p, size_t n, bool isFloat) {
+		byte* q = key->grow_no_init(n);
+		for (size_t i = 0; i < n; ++i)
+			q[i] = p[n-1-i];
+		if (!isFloat) {
+			q[0] ^= 0x80;
+		}
+		else if (q[0] & 0x80) {
+			bool isZero = (q[0] & 0x7F) == 0;
+			for (size_t i = 1; isZero && i < n; ++i)
+				isZero = 0 == q[i];
+			if (isZero)
+				q[0] = 0x80; // -0.0 is +0.0
+			else
+				for (size_t i = 0; i < n; ++i) q[i] = ~q[i];
+		}
+		else {
+			q[0] |= 0x80;
+		}
+	}
+	void loadNormBytes(byte* p, const byte* q, size_t n, bool isFloat) {
+		for (size_t i = 0; i < n; ++i)
+			p[n-1-i] = q[i];
+		if (!isFloat)
+			p[n-1] ^= 0x80;
+		else if (p[n-1] & 0x80)
+			p[n-1] &= 0x7F;
+		else
+			for (size_t i = 0; i < n; ++i) p[i] = ~p[i];
+	}
+	// x87 long double has 10 significant bytes, the rest are padding
+	inline size_t float128NormBytes() {
+		return std::numeric_limits<long double>::digits == 64 ? 10 : 16;
+	}
+	inline size_t varUintBytes(uint64_t x) {
+		return x ? (64 - fast_clz64(x) + 7) / 8 : 0;
+	}
+	// a length byte followed by the significant bytes in BigEndian,
+	// VarSint length byte is 0x80+n for positives, 0x7F-n for negatives
+	void appendNormVarUint(valvec<byte>* key, uint64_t x) {
+		size_t n = varUintBytes(x);
+		byte* q = key->grow_no_init(1 + n);
+		q[0] = byte(n);
+		for (size_t i = 0; i < n; ++i)
+			q[n-i] = byte(x >> 8*i);
+	}
+	void appendNormVarSint(valvec<byte>* key, int64_t x) {
+		size_t n = varUintBytes(x < 0 ? ~uint64_t(x) : uint64_t(x));
+		byte* q = key->grow_no_init(1 + n);
+		q[0] = byte(x < 0 ? 0x7F - n : 0x80 + n);
+		for (size_t i = 0; i < n; ++i)
+			q[n-i] = byte(uint64_t(x) >> 8*i);
+	}
+	// var length binary which is not the last column: 0x00 is escaped as
+	// 0x00 0xFF, terminated by 0x00 0x01, so shorter is less if it is a prefix
+	void appendNormEscaped(valvec<byte>* key, const byte* p, size_t n) {
+		const byte* end = p + n;
+		while (p < end) {
+			const byte* zero = (const byte*)memchr(p, 0, end - p);
+			if (NULL == zero) {
+				key->append(p, end - p);
+				break;
+			}
+			key->append(p, zero - p);
+			key->push_back(0x00);
+			key->push_back(0xFF);
+			p = zero + 1;
+		}
+		key->push_back(0x00);
+		key->push_back(0x01);
+	}
+}
+
+void Schema::encodeNormKeyAppend(fstring row, valvec<byte>* key) const {
+	assert(size_t(-1) != m_fixedLen);
+	assert(m_canEncodeNormKey);
+	const byte* curr = row.udata();
+	const byte* last = row.udata() + row.size();
+	size_t colnum = m_columnsMeta.end_i();
+	key->reserve(key->size() + row.size() + 2*colnum);
+	for (size_t i = 0; i < colnum; ++i) {
+		const ColumnMeta& colmeta = m_columnsMeta.val(i);
+		switch (colmeta.type) {
+		default:
+			THROW_STD(invalid_argument, "ColumnType=%s can not be encoded",
+				columnTypeStr(colmeta.type));
+			break;
+		case ColumnType::Uint08:
+			CHECK_CURR_LAST(1);
+			key->push_back(curr[0]);
+			curr += 1;
+			break;
+		case ColumnType::Sint08:
+			CHECK_CURR_LAST(1);
+			key->push_back(byte(curr[0] ^ 0x80));
+			curr += 1;
+			break;
+		case ColumnType::Uint16:
+			CHECK_CURR_LAST(2);
+			appendBigEndian(key, unaligned_load<uint16_t>(curr));
+			curr += 2;
+			break;
+		case ColumnType::Sint16:
+			CHECK_CURR_LAST(2);
+			appendBigEndian<uint16_t>(key, unaligned_load<uint16_t>(curr) ^ 0x8000);
+			curr += 2;
+			break;
+		case ColumnType::Uint32:
+			CHECK_CURR_LAST(4);
+			appendBigEndian(key, unaligned_load<uint32_t>(curr));
+			curr += 4;
+			break;
+		case ColumnType::Sint32:
+			CHECK_CURR_LAST(4);
+			appendBigEndian(key, unaligned_load<uint32_t>(curr) ^ (uint32_t(1) << 31));
+			curr += 4;
+			break;
+		case ColumnType::Uint64:
+			CHECK_CURR_LAST(8);
+			appendBigEndian(key, unaligned_load<uint64_t>(curr));
+			curr += 8;
+			break;
+		case ColumnType::Sint64:
+			CHECK_CURR_LAST(8);
+			appendBigEndian(key, unaligned_load<uint64_t>(curr) ^ (uint64_t(1) << 63));
+			curr += 8;
+			break;
+		case ColumnType::Uint128:
+			CHECK_CURR_LAST(16);
+			appendNormBytes(key, curr, 16, false);
+			key->data()[key->size() - 16] ^= 0x80; // unsigned
+			curr += 16;
+			break;
+		case ColumnType::Sint128:
+			CHECK_CURR_LAST(16);
+			appendNormBytes(key, curr, 16, false);
+			curr += 16;
+			break;
+		case ColumnType::Float32:
+			CHECK_CURR_LAST(4);
+			appendBigEndian(key, floatToNorm(unaligned_load<uint32_t>(curr)));
+			curr += 4;
+			break;
+		case ColumnType::Float64:
+			CHECK_CURR_LAST(8);
+			appendBigEndian(key, floatToNorm(unaligned_load<uint64_t>(curr)));
+			curr += 8;
+			break;
+		case ColumnType::Float128:
+			CHECK_CURR_LAST(16);
+			appendNormBytes(key, curr, float128NormBytes(), true);
+			curr += 16;
+			break;
+		case ColumnType::Uuid:
+			CHECK_CURR_LAST(16);
+			key->append(curr, 16);
+			curr += 16;
+			break;
+		case ColumnType::Fixed:
+			CHECK_CURR_LAST(colmeta.fixedLen);
+			key->append(curr, colmeta.fixedLen);
+			curr += colmeta.fixedLen;
+			break;
+		case ColumnType::VarSint:
+			{
+				const byte* next;
+				int64_t x = load_var_int64(curr, &next);
+				CHECK_CURR_LAST(next - curr);
+				appendNormVarSint(key, x);
+				curr = next;
+			}
+			break;
+		case ColumnType::VarUint:
+			{
+				const byte* next;
+				uint64_t x = load_var_uint64(curr, &next);
+				CHECK_CURR_LAST(next - curr);
+				appendNormVarUint(key, x);
+				curr = next;
+			}
+			break;
+		case ColumnType::StrZero: // '\0' is the terminator, as in row
+			{
+				size_t len = strnlen((const char*)curr, last - curr);
+				if (i < colnum - 1) {
+					CHECK_CURR_LAST(len + 1);
+					key->append(curr, len + 1);
+				}
+				else { // the last column
+					if (len + 1 < size_t(last - curr)) {
+						THROW_STD(invalid_argument,
+							"'\\0' in StrZero is not at string end");
+					}
+					key->append(curr, len);
+				}
+				curr += len + 1;
+			}
+			break;
+		case ColumnType::TwoStrZero:
+			{
+				size_t n1 = strnlen((const char*)curr, last - curr);
+				if (i < colnum - 1) {
+					CHECK_CURR_LAST(n1 + 1);
+					size_t n2 = strnlen((const char*)curr+n1+1, last-curr-n1-1);
+					CHECK_CURR_LAST(n1 + 1 + n2 + 1);
+					key->append(curr, n1 + 1 + n2 + 1);
+					curr += n1 + 1 + n2 + 1;
+				}
+				else { // the last column, same length as compareData
+					size_t nn = n1;
+					if (n1 + 1 < size_t(last - curr)) {
+						size_t n2 = strnlen((const char*)curr+n1+1, last-curr-n1-1);
+						if (n1+1 + n2+1 < size_t(last - curr)) {
+							THROW_STD(invalid_argument,
+								"second '\\0' in TwoStrZero is not at string end");
+						}
+						nn += 1 + n2;
+					}
+					key->append(curr, nn);
+				}
+			}
+			break;
+		case ColumnType::Binary:
+			if (i < colnum - 1) {
+				const byte* next;
+				size_t len = load_var_uint64(curr, &next);
+				CHECK_CURR_LAST3(next, last, len);
+				appendNormEscaped(key, next, len);
+				curr = next + len;
+			}
+			else {
+				key->append(curr, last - curr);
+			}
+			break;
+		case ColumnType::CarBin:
+			if (i < colnum - 1) {
+				CHECK_CURR_LAST(4);
+			#if defined(BOOST_BIG_ENDIAN)
+				size_t len = byte_swap(unaligned_load<uint32_t>(curr));
+			#else
+				size_t len = unaligned_load<uint32_t>(curr);
+			#endif
+				CHECK_CURR_LAST3(curr+4, last, len);
+				appendNormEscaped(key, curr + 4, len);
+				curr += 4 + len;
+			}
+			else {
+				key->append(curr, last - curr);
+			}
+			break;
+		}
+	}
+}
+
+void Schema::decodeNormKeyAppend(fstring key, valvec<byte>* row) const {
+	assert(size_t(-1) != m_fixedLen);
+	assert(m_canEncodeNormKey);
+	const byte* curr = key.udata();
+	const byte* last = key.udata() + key.size();
+	size_t colnum = m_columnsMeta.end_i();
+	row->reserve(row->size() + key.size());
+	for (size_t i = 0; i < colnum; ++i) {
+		const ColumnMeta& colmeta = m_columnsMeta.val(i);
+		switch (colmeta.type) {
+		default:
+			THROW_STD(invalid_argument, "ColumnType=%s can not be decoded",
+				columnTypeStr(colmeta.type));
+			break;
+		case ColumnType::Uint08:
+			CHECK_CURR_LAST(1);
+			row->push_back(curr[0]);
+			curr += 1;
+			break;
+		case ColumnType::Sint08:
+			CHECK_CURR_LAST(1);
+			row->push_back(byte(curr[0] ^ 0x80));
+			curr += 1;
+			break;
+		case ColumnType::Uint16:
+			CHECK_CURR_LAST(2);
+			unaligned_save(row->grow_no_init(2), loadBigEndian<uint16_t>(curr));
+			curr += 2;
+			break;
+		case ColumnType::Sint16:
+			CHECK_CURR_LAST(2);
+			unaligned_save(row->grow_no_init(2),
+				uint16_t(loadBigEndian<uint16_t>(curr) ^ 0x8000));
+			curr += 2;
+			break;
+		case ColumnType::Uint32:
+			CHECK_CURR_LAST(4);
+			unaligned_save(row->grow_no_init(4), loadBigEndian<uint32_t>(curr));
+			curr += 4;
+			break;
+		case ColumnType::Sint32:
+			CHECK_CURR_LAST(4);
+			unaligned_save(row->grow_no_init(4),
+				loadBigEndian<uint32_t>(curr) ^ (uint32_t(1) << 31));
+			curr += 4;
+			break;
+		case ColumnType::Uint64:
+			CHECK_CURR_LAST(8);
+			unaligned_save(row->grow_no_init(8), loadBigEndian<uint64_t>(curr));
+			curr += 8;
+			break;
+		case ColumnType::Sint64:
+			CHECK_CURR_LAST(8);
+			unaligned_save(row->grow_no_init(8),
+				loadBigEndian<uint64_t>(curr) ^ (uint64_t(1) << 63));
+			curr += 8;
+			break;
+		case ColumnType::Uint128:
+		case ColumnType::Sint128:
+			CHECK_CURR_LAST(16);
+			{
+				byte* p = row->grow_no_init(16);
+				loadNormBytes(p, curr, 16, false);
+				if (ColumnType::Uint128 == colmeta.type)
+					p[15] ^= 0x80;
+			}
+			curr += 16;
+			break;
+		case ColumnType::Float32:
+			CHECK_CURR_LAST(4);
+			unaligned_save(row->grow_no_init(4),
+				normToFloat(loadBigEndian<uint32_t>(curr)));
+			curr += 4;
+			break;
+		case ColumnType::Float64:
+			CHECK_CURR_LAST(8);
+			unaligned_save(row->grow_no_init(8),
+				normToFloat(loadBigEndian<uint64_t>(curr)));
+			curr += 8;
+			break;
+		case ColumnType::Float128:
+			{
+				size_t n = float128NormBytes();
+				CHECK_CURR_LAST(n);
+				byte* p = row->grow_no_init(16);
+				loadNormBytes(p, curr, n, true);
+				memset(p + n, 0, 16 - n);
+				curr += n;
+			}
+			break;
+		case ColumnType::Uuid:
+			CHECK_CURR_LAST(16);
+			row->append(curr, 16);
+			curr += 16;
+			break;
+		case ColumnType::Fixed:
+			CHECK_CURR_LAST(colmeta.fixedLen);
+			row->append(curr, colmeta.fixedLen);
+			curr += colmeta.fixedLen;
+			break;
+		case ColumnType::VarSint:
+		case ColumnType::VarUint:
+			{
+				CHECK_CURR_LAST(1);
+				bool isSigned = ColumnType::VarSint == colmeta.type;
+				bool isNeg = isSigned && curr[0] < 0x80;
+				size_t n = !isSigned ? curr[0] : isNeg ? 0x7F - curr[0] : curr[0] - 0x80;
+				if (n > 8) {
+					THROW_STD(invalid_argument, "bad VarInt len byte = %d", curr[0]);
+				}
+				CHECK_CURR_LAST(1 + n);
+				uint64_t x = isNeg ? ~uint64_t(0) : 0;
+				for (size_t j = 0; j < n; ++j)
+					x = x << 8 | curr[1 + j];
+				byte* p = row->grow_no_init(10);
+				byte* e = isSigned ? save_var_int64(p, int64_t(x)) : save_var_uint64(p, x);
+				row->risk_set_size(e - row->data());
+				curr += 1 + n;
+			}
+			break;
+		case ColumnType::StrZero:
+			if (i < colnum - 1) {
+				size_t len = strnlen((const char*)curr, last - curr);
+				CHECK_CURR_LAST(len + 1);
+				row->append(curr, len + 1);
+				curr += len + 1;
+			}
+			else {
+				row->append(curr, last - curr);
+				row->push_back('\0');
+				curr = last;
+			}
+			break;
+		case ColumnType::TwoStrZero:
+			if (i < colnum - 1) {
+				size_t n1 = strnlen((const char*)curr, last - curr);
+				CHECK_CURR_LAST(n1 + 1);
+				size_t n2 = strnlen((const char*)curr+n1+1, last-curr-n1-1);
+				CHECK_CURR_LAST(n1 + 1 + n2 + 1);
+				row->append(curr, n1 + 1 + n2 + 1);
+				curr += n1 + 1 + n2 + 1;
+			}
+			else {
+				row->append(curr, last - curr);
+				row->push_back('\0');
+				curr = last;
+			}
+			break;
+		case ColumnType::Binary:
+		case ColumnType::CarBin:
+			if (i < colnum - 1) {
+				size_t len = 0;
+				const byte* p = curr;
+				for (;;) {
+					const byte* zero = (const byte*)memchr(p, 0, last - p);
+					if (NULL == zero || zero + 1 == last) {
+						THROW_STD(invalid_argument, "missing binary terminator");
+					}
+					len += zero - p;
+					if (0x01 == zero[1])
+						break;
+					if (0xFF != zero[1]) {
+						THROW_STD(invalid_argument, "bad binary escape");
+					}
+					len += 1;
+					p = zero + 2;
+				}
+				if (ColumnType::Binary == colmeta.type) {
+					byte* q = row->grow_no_init(10);
+					q = save_var_uint64(q, len);
+					row->risk_set_size(q - row->data());
+				}
+				else {
+				#if defined(BOOST_BIG_ENDIAN)
+					unaligned_save(row->grow_no_init(4), byte_swap(uint32_t(len)));
+				#else
+					unaligned_save(row->grow_no_init(4), uint32_t(len));
+				#endif
+				}
+				byte* q = row->grow_no_init(len);
+				for (;;) {
+					const byte* zero = (const byte*)memchr(curr, 0, last - curr);
+					memcpy(q, curr, zero - curr);
+					q += zero - curr;
+					curr = zero + 2;
+					if (0x01 == zero[1])
+						break;
+					*q++ = 0;
+				}
+			}
+			else {
+				row->append(curr, last - curr);
+				curr = last;
+			}
+			break;
+		}
+	}
+	if (curr != last) {
+		THROW_STD(invalid_argument, "%zd extra bytes after the key", size_t(last - curr));
+	}
+}
+
 size_t
 Schema::parseDelimText(char delim, fstring text, valvec<byte>* row)
 const {
@@ -879,7 +1431,10 @@ const {
 	size_t iCol = 0;
 	row->erase_all();
 	for (; pos < end && iCol < nCol; ++iCol) {
-		const char* next = std::find(pos, end, delim);
+		// memchr is SIMD optimized, much faster than std::find
+		const char* next = (const char*)memchr(pos, delim, end - pos);
+		if (NULL == next)
+			next = end;
 		char* next2 = nullptr;
 		const ColumnMeta& colmeta = m_columnsMeta.val(iCol);
 		switch (colmeta.type) {
@@ -1189,6 +1744,11 @@ bool Schema::should_use_FixedLenStore() const {
 			// should use ZipIntStore
 			return false;
 		}
+		if ((ColumnType::Float32 == colmeta.type ||
+			 ColumnType::Float64 == colmeta.type) && !m_isInplaceUpdatable) {
+			// should use FloatXorStore
+			return false;
+		}
 	}
 	size_t fixlen = m_fixedLen;
 	if (m_isInplaceUpdatable) {
@@ -1376,14 +1936,16 @@ int Schema::compareData(fstring x, fstring y) const {
 			abort(); // not implemented yet
 			break;
 		case ColumnType::Uint08:
-			CHECK_CURR_LAST3(xcurr, ylast, 1);
+			CHECK_CURR_LAST3(xcurr, xlast, 1);
+			CHECK_CURR_LAST3(ycurr, ylast, 1);
 			if (*xcurr != *ycurr)
 				return *xcurr - *ycurr;
 			xcurr += 1;
 			ycurr += 1;
 			break;
 		case ColumnType::Sint08:
-			CHECK_CURR_LAST3(xcurr, ylast, 1);
+			CHECK_CURR_LAST3(xcurr, xlast, 1);
+			CHECK_CURR_LAST3(ycurr, ylast, 1);
 			if (sbyte(*xcurr) != sbyte(*ycurr))
 				return sbyte(*xcurr) - sbyte(*ycurr);
 			xcurr += 1;
@@ -1625,6 +2187,42 @@ int Schema::QsortCompareByIndex(const void* x, const void* y, const void* ctx) {
 	return cc->schema->compareData(xs, ys);
 }
 
+void Schema::sortKeyIds(size_t num, const std::function<fstring(size_t)>& getKey,
+						valvec<uint32_t>* ids) const {
+	assert(num < UINT32_MAX);
+	ids->resize_no_init(num);
+	if (m_canEncodeNormKey) {
+		// the last column is not escaped, so a norm key may be a prefix of
+		// another one, ties are broken by seq_id instead of an id suffix
+		SortableStrVec normKeys;
+		valvec<byte> key;
+		for (size_t i = 0; i < num; ++i) {
+			encodeNormKey(getKey(i), &key);
+			normKeys.push_back(key);
+		}
+		const byte* pool = normKeys.m_strpool.data();
+		std::sort(normKeys.m_index.begin(), normKeys.m_index.end(),
+		[pool](const SortableStrVec::SEntry& x, const SortableStrVec::SEntry& y) {
+			size_t n = std::min<size_t>(x.length, y.length);
+			int ret = memcmp(pool + x.offset, pool + y.offset, n);
+			if (ret)
+				return ret < 0;
+			if (x.length != y.length)
+				return x.length < y.length;
+			return x.seq_id < y.seq_id;
+		});
+		for (size_t i = 0; i < num; ++i) {
+			(*ids)[i] = normKeys.m_index[i].seq_id;
+		}
+	}
+	else {
+		for (size_t i = 0; i < num; ++i) (*ids)[i] = uint32_t(i);
+		std::stable_sort(ids->begin(), ids->end(), [&](uint32_t x, uint32_t y) {
+			return compareData(getKey(x), getKey(y)) < 0;
+		});
+	}
+}
+
 SchemaSet::SchemaSet() {
 	m_flattenColumnNum = 0;
 }
@@ -1931,6 +2529,9 @@ parseJsonColgroup(Schema& schema, const terark::json& js, int sufarrMinFreq) {
 	// -256: rank_select_il_256
 	schema.m_rankSelectClass = getJsonValue(js, "rs", 512);
 	schema.m_useFastZip = getJsonValue(js, "useFastZip", false);
+	// fast build store for new segments, merge rebuild it by nlt/dictZip
+	schema.m_blockZipBytes = getJsonValue(js, "blockZipBytes", 0);
+	schema.m_blockZipLevel = getJsonValue(js, "blockZipLevel", 1);
 	schema.m_nltNestLevel = (byte)limitInBound(
 		getJsonValue(js, "nltNestLevel", DEFAULT_nltNestLevel), 1u, 20u);
 }
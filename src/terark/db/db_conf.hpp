@@ -7,6 +7,7 @@
 #include <terark/pass_by_value.hpp>
 #include <terark/util/refcount.hpp>
 #include <boost/intrusive_ptr.hpp>
+#include <functional>
 
 #if defined(_MSC_VER)
 
@@ -168,6 +169,20 @@ namespace terark { namespace db {
 		void byteLexConvert(valvec<byte>&) const;
 		void byteLexConvert(byte* data, size_t size) const;
 
+		///@{ order preserving encoding of all column types except Any and
+		/// Decimal128, memcmp of encoded keys is same as compareData of rows
+		void encodeNormKeyAppend(fstring row, valvec<byte>* key) const;
+		void decodeNormKeyAppend(fstring key, valvec<byte>* row) const;
+		void encodeNormKey(fstring row, valvec<byte>* key) const {
+			key->erase_all();
+			encodeNormKeyAppend(row, key);
+		}
+		void decodeNormKey(fstring key, valvec<byte>* row) const {
+			row->erase_all();
+			decodeNormKeyAppend(key, row);
+		}
+		///@}
+
 		size_t parseDelimText(char delim, fstring text, valvec<byte>* row) const;
 
 		std::string toJsonStr(fstring row) const;
@@ -199,6 +214,10 @@ namespace terark { namespace db {
 		static int QsortCompareFixedLen(const void* x, const void* y, const void* ctx);
 		static int QsortCompareByIndex(const void* x, const void* y, const void* ctx);
 
+		// stable sort ids of [0, num) by getKey(id), use norm keys if possible
+		void sortKeyIds(size_t num, const std::function<fstring(size_t)>& getKey,
+						valvec<uint32_t>* ids) const;
+
 		hash_strmap<ColumnMeta> m_columnsMeta;
 		std::string m_name;
 		std::string m_nltDelims;
@@ -210,6 +229,8 @@ namespace terark { namespace db {
 		int    m_maxFragLen;
 		int    m_sufarrMinFreq;
 		int    m_rankSelectClass;
+		int    m_blockZipBytes; // > 0 for BlockZipStore on new segments
+		int    m_blockZipLevel;
 		float  m_dictZipSampleRatio;
 		byte   m_nltNestLevel;
 
@@ -219,6 +240,7 @@ namespace terark { namespace db {
 		bool   m_isUnique  : 1;
 		bool   m_needEncodeToLexByteComparable : 1;
 		bool   m_canEncodeToLexByteComparable  : 1;
+		bool   m_canEncodeNormKey : 1;
 		bool   m_useFastZip : 1;
 		bool   m_dictZipLocalMatch : 1;
 		bool   m_isInplaceUpdatable: 1;
@@ -235,6 +257,18 @@ namespace terark { namespace db {
 
 	protected:
 		size_t m_fixedLen;
+
+		// parse plan compiled by compile(): leading fixed length columns
+		// have precomputed offsets, just the rest are parsed by type
+		enum class ParseKind : unsigned char {
+			AllFixed,  // all columns are in m_fixedPrefixCols
+			RestBin,   // followed by a last Binary/CarBin taking the rest
+			Generic,
+		};
+		valvec<ColumnVec::Elem> m_fixedPrefixCols; // pos is offset in row
+		size_t    m_fixedPrefixLen;
+		ParseKind m_parseKind;
+		void compileParsePlan();
 	/*
 	// Backlog: select from multiple tables
 		struct ColumnLink {
@@ -78,6 +78,7 @@ DbContext::DbContext(const CompositeTable* tab)
 	if (m_wrSegPtr) {
 		m_transaction.reset(m_wrSegPtr->createTransaction());
 	}
+	wrSubIdBeg = wrSubIdEnd = 0;
 	m_rowNumVec.assign(tab->m_rowNumVec);
 	segArrayUpdateSeq = tab->m_segArrayUpdateSeq;
 	syncIndex = true;
@@ -89,6 +90,7 @@ DbContext::DbContext(const CompositeTable* tab)
 DbContext::~DbContext() {
 //	m_tab->unregisterDbContext(this);
 	this->m_transaction.reset(); // destory before m_segCtx
+	releaseWrSubIds(); // m_wrSegPtr is kept alive by m_segCtx
 	size_t indexNum = m_tab->getIndexNum();
 	for (auto& x : m_segCtx) {
 		assert(NULL != x);
@@ -96,6 +98,23 @@ DbContext::~DbContext() {
 	}
 }
 
+void DbContext::releaseWrSubIds() {
+	if (m_wrSegPtr && (wrSubIdReuse.size() || wrSubIdBeg < wrSubIdEnd)) {
+		WritableSegment* ws = m_wrSegPtr;
+		SpinRwLock wsLock(ws->m_segMutex, true);
+		// a frozen wrseg never allocates sub ids again, the ids are just
+		// left as deleted rows
+		if (!ws->m_isFreezed) {
+			auto& idset = ws->m_deletedWrIdSet;
+			idset.append(wrSubIdReuse);
+			for (llong subId = wrSubIdBeg; subId < wrSubIdEnd; ++subId)
+				idset.push_back(uint32_t(subId));
+		}
+	}
+	wrSubIdReuse.erase_all();
+	wrSubIdBeg = wrSubIdEnd = 0;
+}
+
 void DbContext::doSyncSegCtxNoLock(const CompositeTable* tab) {
 	assert(tab == m_tab);
 	assert(this->segArrayUpdateSeq < tab->getSegArrayUpdateSeq());
@@ -109,6 +128,7 @@ void DbContext::doSyncSegCtxNoLock(const CompositeTable* tab) {
 			m_segCtx[i] = SegCtx::create(tab->getSegmentPtr(i), indexNum);
 	}
 	if (tab->m_wrSeg.get() != m_wrSegPtr) {
+		releaseWrSubIds(); // old wrseg is kept alive by m_segCtx
 		m_wrSegPtr = tab->m_wrSeg.get();
 		if (m_wrSegPtr)
 			m_transaction.reset(m_wrSegPtr->createTransaction());
@@ -11,6 +11,7 @@ namespace terark { namespace db {
 
 typedef boost::intrusive_ptr<class CompositeTable> CompositeTablePtr;
 typedef boost::intrusive_ptr<class StoreIterator> StoreIteratorPtr;
+class TERARK_DB_DLL IndexQuery;
 
 class TERARK_DB_DLL DbContextLink : public RefCounter {
 	friend class CompositeTable;
@@ -33,6 +34,9 @@ public:
 
 	void getWrSegWrtStoreData(const class ReadableSegment* seg, llong subId, valvec<byte>* buf);
 
+	// give unused reserved sub ids back to m_wrSegPtr->m_deletedWrIdSet
+	void releaseWrSubIds();
+
 	void debugCheckUnique(fstring row, size_t uniqIndexId);
 
 /// @{ delegate methods
@@ -57,9 +61,16 @@ public:
 	void indexSearchExactNoLock(size_t indexId, fstring key, valvec<llong>* recIdvec);
 	bool indexKeyExistsNoLock(size_t indexId, fstring key);
 
+	void indexQuery(const IndexQuery&, valvec<llong>* recIdvec);
+	void indexQueryNoLock(const IndexQuery&, valvec<llong>* recIdvec);
+
 	bool indexMatchRegex(size_t indexId, BaseDFA* regexDFA, valvec<llong>* recIdvec);
 	bool indexMatchRegex(size_t indexId, fstring  regexStr, fstring regexOptions, valvec<llong>* recIdvec);
 
+	size_t indexSearchPrefix(size_t indexId, fstring prefix, size_t limit, valvec<llong>* recIdvec);
+	llong  indexCountPrefix(size_t indexId, fstring prefix);
+	llong  estimateRange(size_t indexId, fstring lo, fstring hi);
+
 	void selectColumns(llong id, const valvec<size_t>& cols, valvec<byte>* colsData);
 	void selectColumns(llong id, const size_t* colsId, size_t colsNum, valvec<byte>* colsData);
 	void selectOneColumn(llong id, size_t columnId, valvec<byte>* colsData, DbContext*);
@@ -111,7 +122,11 @@ public:
 	valvec<uint32_t> offsets;
 	ColumnVec    cols1;
 	ColumnVec    cols2;
+	valvec<fstring> views; // zero copy values, see ReadableStore::getValueView
 	valvec<llong> exactMatchRecIdvec;
+	valvec<uint32_t> wrSubIdReuse; // reserved from m_wrSegPtr->m_deletedWrIdSet
+	llong  wrSubIdBeg; // [wrSubIdBeg, wrSubIdEnd) is reserved in m_wrSegPtr
+	llong  wrSubIdEnd;
 	size_t regexMatchMemLimit;
 	size_t segArrayUpdateSeq;
 	bool syncIndex;
@@ -0,0 +1,416 @@
+#include "db_query.hpp"
+#include "db_segment.hpp"
+#include "db_context.hpp"
+#include <terark/bitmanip.hpp>
+#include <algorithm>
+
+namespace terark { namespace db {
+
+IndexQuery::IndexQuery(Op op) {
+	m_op = op;
+	m_indexId = size_t(-1);
+}
+IndexQuery::~IndexQuery() {
+}
+
+IndexQueryPtr IndexQuery::Exact(size_t indexId, fstring key) {
+	IndexQueryPtr q(new IndexQuery(Op::Exact));
+	q->m_indexId = indexId;
+	q->m_key.assign(key.udata(), key.size());
+	return q;
+}
+
+IndexQueryPtr
+IndexQuery::AnyOf(size_t indexId, std::initializer_list<fstring> keys) {
+	IndexQueryPtr q(new IndexQuery(Op::Or));
+	for (fstring key : keys)
+		q->m_children.push_back(Exact(indexId, key));
+	return q;
+}
+
+IndexQueryPtr
+IndexQuery::AnyOf(size_t indexId, const valvec<fstring>& keys) {
+	IndexQueryPtr q(new IndexQuery(Op::Or));
+	q->m_children.reserve(keys.size());
+	for (fstring key : keys)
+		q->m_children.push_back(Exact(indexId, key));
+	return q;
+}
+
+IndexQueryPtr IndexQuery::And(IndexQueryPtr x, IndexQueryPtr y) {
+	IndexQueryPtr q(new IndexQuery(Op::And));
+	q->m_children.push_back(std::move(x));
+	q->m_children.push_back(std::move(y));
+	return q;
+}
+
+IndexQueryPtr IndexQuery::Or(IndexQueryPtr x, IndexQueryPtr y) {
+	IndexQueryPtr q(new IndexQuery(Op::Or));
+	q->m_children.push_back(std::move(x));
+	q->m_children.push_back(std::move(y));
+	return q;
+}
+
+IndexQueryPtr IndexQuery::Not(IndexQueryPtr x) {
+	IndexQueryPtr q(new IndexQuery(Op::Not));
+	q->m_children.push_back(std::move(x));
+	return q;
+}
+
+IndexQuery* IndexQuery::add(IndexQueryPtr child) {
+	assert(Op::And == m_op || Op::Or == m_op);
+	m_children.push_back(std::move(child));
+	return this;
+}
+
+namespace {
+
+// A set of logic ids in one segment, a sorted id list when it is sparse,
+// a bitmap when it is dense
+struct SegRecSet {
+	valvec<size_t> m_list; // sorted and unique, when !m_isBits
+	febitvec       m_bits; // m_bits.size() == rows, when m_isBits
+	bool           m_isBits = false;
+
+	bool empty() const { return m_isBits ? m_bits.isall0() : m_list.empty(); }
+	void swap(SegRecSet& y) {
+		m_list.swap(y.m_list);
+		m_bits.swap(y.m_bits);
+		std::swap(m_isBits, y.m_isBits);
+	}
+};
+
+class SegQueryEval {
+	const ReadableSegment* m_seg;
+	size_t     m_segIdx;
+	size_t     m_rows; // snapshot of m_seg->m_isDel.size()
+	size_t     m_denseLimit;
+	DbContext* m_ctx;
+	valvec<llong>  m_tmp;
+	valvec<size_t> m_mergeBuf;
+
+	// resize does not touch bits past m_rows in the last word, keep them
+	// zero, then &=, |= and -= also keep them zero
+	static void clearTailBits(febitvec& bits) {
+		if (size_t tail = bits.size() % WordBits)
+			bits.bldata()[bits.num_words()-1] &= (bm_uint_t(1) << tail) - 1;
+	}
+	void toBits(SegRecSet* s) const {
+		if (s->m_isBits)
+			return;
+		s->m_bits.erase_all();
+		s->m_bits.resize(m_rows, false);
+		clearTailBits(s->m_bits);
+		for (size_t id : s->m_list)
+			s->m_bits.set1(id);
+		s->m_list.clear();
+		s->m_isBits = true;
+	}
+	void fillAll(SegRecSet* s) const {
+		s->m_list.clear();
+		s->m_bits.erase_all();
+		s->m_bits.resize(m_rows, true);
+		clearTailBits(s->m_bits);
+		s->m_isBits = true;
+	}
+	void evalExact(const IndexQuery& q, SegRecSet* s);
+	void evalAnd(const IndexQuery& q, SegRecSet* s);
+	void evalOr(const IndexQuery& q, SegRecSet* s);
+	void intersect(SegRecSet* x, SegRecSet* y);
+	void subtract(SegRecSet* x, const SegRecSet& y);
+	void unite(SegRecSet* x, SegRecSet* y);
+
+public:
+	SegQueryEval(const ReadableSegment* seg, size_t segIdx, DbContext* ctx) {
+		m_seg = seg;
+		m_segIdx = segIdx;
+		m_rows = seg->m_isDel.size();
+		m_denseLimit = m_rows / 64; // list size over this is slower than bits
+		m_ctx = ctx;
+	}
+	size_t rows() const { return m_rows; }
+	void eval(const IndexQuery& q, SegRecSet* s);
+};
+
+void SegQueryEval::eval(const IndexQuery& q, SegRecSet* s) {
+	switch (q.m_op) {
+	case IndexQuery::Op::Exact:
+		evalExact(q, s);
+		break;
+	case IndexQuery::Op::And:
+		evalAnd(q, s);
+		break;
+	case IndexQuery::Op::Or:
+		evalOr(q, s);
+		break;
+	case IndexQuery::Op::Not:
+		if (q.m_children.size() != 1) {
+			THROW_STD(invalid_argument,
+				"Not must have 1 child, but has %zd", q.m_children.size());
+		}
+		eval(*q.m_children[0], s);
+		{
+			SegRecSet y;
+			y.swap(*s);
+			fillAll(s);
+			subtract(s, y);
+		}
+		break;
+	}
+}
+
+void SegQueryEval::evalExact(const IndexQuery& q, SegRecSet* s) {
+	if (q.m_indexId >= m_seg->m_indices.size()) {
+		THROW_STD(invalid_argument, "indexId = %zd, indexNum = %zd",
+			q.m_indexId, m_seg->m_indices.size());
+	}
+	m_tmp.erase_all();
+	m_seg->indexSearchExactAppendNoDel(m_segIdx, q.m_indexId,
+		fstring(q.m_key.data(), q.m_key.size()), &m_tmp, m_ctx);
+	s->m_isBits = false;
+	s->m_bits.clear();
+	s->m_list.erase_all();
+	s->m_list.reserve(m_tmp.size());
+	for (llong id : m_tmp) {
+		if (size_t(id) < m_rows) // ignore rows inserted after snapshot
+			s->m_list.unchecked_push_back(size_t(id));
+	}
+	std::sort(s->m_list.begin(), s->m_list.end());
+	if (s->m_list.size() > m_denseLimit)
+		toBits(s);
+}
+
+void SegQueryEval::evalAnd(const IndexQuery& q, SegRecSet* s) {
+	bool hasPositive = false;
+	SegRecSet y;
+	for (auto& child : q.m_children) {
+		if (IndexQuery::Op::Not == child->m_op)
+			continue;
+		if (!hasPositive) {
+			eval(*child, s);
+			hasPositive = true;
+		}
+		else {
+			eval(*child, &y);
+			intersect(s, &y);
+		}
+		if (s->empty())
+			return;
+	}
+	if (!hasPositive)
+		fillAll(s);
+	// subtract NOT children instead of complement and intersect
+	for (auto& child : q.m_children) {
+		if (IndexQuery::Op::Not != child->m_op)
+			continue;
+		if (child->m_children.size() != 1) {
+			THROW_STD(invalid_argument,
+				"Not must have 1 child, but has %zd", child->m_children.size());
+		}
+		eval(*child->m_children[0], &y);
+		subtract(s, y);
+		if (s->empty())
+			return;
+	}
+}
+
+void SegQueryEval::evalOr(const IndexQuery& q, SegRecSet* s) {
+	s->m_isBits = false;
+	s->m_bits.clear();
+	s->m_list.erase_all();
+	// for AnyOf, all children are Exact, collect all ids then sort once
+	bool allExact = true;
+	for (auto& child : q.m_children) {
+		if (IndexQuery::Op::Exact != child->m_op) {
+			allExact = false;
+			break;
+		}
+	}
+	if (allExact) {
+		for (auto& child : q.m_children) {
+			if (child->m_indexId >= m_seg->m_indices.size()) {
+				THROW_STD(invalid_argument, "indexId = %zd, indexNum = %zd",
+					child->m_indexId, m_seg->m_indices.size());
+			}
+			m_seg->indexSearchExactAppendNoDel(m_segIdx, child->m_indexId,
+				fstring(child->m_key.data(), child->m_key.size()), &m_tmp, m_ctx);
+		}
+		s->m_list.reserve(m_tmp.size());
+		for (llong id : m_tmp) {
+			if (size_t(id) < m_rows)
+				s->m_list.unchecked_push_back(size_t(id));
+		}
+		m_tmp.erase_all();
+		std::sort(s->m_list.begin(), s->m_list.end());
+		s->m_list.trim(std::unique(s->m_list.begin(), s->m_list.end()));
+		if (s->m_list.size() > m_denseLimit)
+			toBits(s);
+		return;
+	}
+	SegRecSet y;
+	for (auto& child : q.m_children) {
+		eval(*child, &y);
+		unite(s, &y);
+	}
+}
+
+// galloping search in [lo, n), returns first pos which a[pos] >= key
+static inline
+size_t gallopLowerBound(const size_t* a, size_t lo, size_t n, size_t key) {
+	size_t step = 1;
+	size_t hi = lo;
+	while (hi < n && a[hi] < key) {
+		lo = hi + 1;
+		hi += step;
+		step *= 2;
+	}
+	if (hi > n)
+		hi = n;
+	return lower_bound_n(a, lo, hi, key);
+}
+
+void SegQueryEval::intersect(SegRecSet* x, SegRecSet* y) {
+	if (x->m_isBits && y->m_isBits) {
+		x->m_bits &= y->m_bits;
+		return;
+	}
+	if (x->m_isBits)
+		x->swap(*y); // now x is list
+	if (y->m_isBits) {
+		const bm_uint_t* bits = y->m_bits.bldata();
+		size_t* p = x->m_list.data();
+		size_t  n = x->m_list.size(), k = 0;
+		for (size_t i = 0; i < n; ++i) {
+			if (terark_bit_test(bits, p[i]))
+				p[k++] = p[i];
+		}
+		x->m_list.risk_set_size(k);
+		return;
+	}
+	// list & list: iterate the smaller list, gallop in the larger one
+	if (x->m_list.size() > y->m_list.size())
+		x->m_list.swap(y->m_list);
+	const size_t* b = y->m_list.data();
+	size_t* p = x->m_list.data();
+	size_t  n = x->m_list.size(), m = y->m_list.size();
+	size_t  j = 0, k = 0;
+	for (size_t i = 0; i < n && j < m; ++i) {
+		j = gallopLowerBound(b, j, m, p[i]);
+		if (j < m && b[j] == p[i])
+			p[k++] = p[i];
+	}
+	x->m_list.risk_set_size(k);
+}
+
+void SegQueryEval::subtract(SegRecSet* x, const SegRecSet& y) {
+	if (x->m_isBits) {
+		if (y.m_isBits)
+			x->m_bits -= y.m_bits;
+		else
+			for (size_t id : y.m_list)
+				x->m_bits.set0(id);
+		return;
+	}
+	size_t* p = x->m_list.data();
+	size_t  n = x->m_list.size(), k = 0;
+	if (y.m_isBits) {
+		const bm_uint_t* bits = y.m_bits.bldata();
+		for (size_t i = 0; i < n; ++i) {
+			if (!terark_bit_test(bits, p[i]))
+				p[k++] = p[i];
+		}
+	}
+	else {
+		const size_t* b = y.m_list.data();
+		size_t m = y.m_list.size(), j = 0;
+		for (size_t i = 0; i < n; ++i) {
+			j = gallopLowerBound(b, j, m, p[i]);
+			if (j == m || b[j] != p[i])
+				p[k++] = p[i];
+		}
+	}
+	x->m_list.risk_set_size(k);
+}
+
+void SegQueryEval::unite(SegRecSet* x, SegRecSet* y) {
+	if (x->m_isBits || y->m_isBits) {
+		if (!x->m_isBits)
+			x->swap(*y); // now x is bits
+		if (y->m_isBits)
+			x->m_bits |= y->m_bits;
+		else
+			for (size_t id : y->m_list)
+				x->m_bits.set1(id);
+		return;
+	}
+	if (y->m_list.empty())
+		return;
+	if (x->m_list.empty()) {
+		x->m_list.swap(y->m_list);
+		return;
+	}
+	m_mergeBuf.resize_no_init(x->m_list.size() + y->m_list.size());
+	size_t* e = std::set_union(x->m_list.begin(), x->m_list.end(),
+							   y->m_list.begin(), y->m_list.end(),
+							   m_mergeBuf.begin());
+	m_mergeBuf.risk_set_size(e - m_mergeBuf.begin());
+	x->m_list.swap(m_mergeBuf);
+	if (x->m_list.size() > m_denseLimit)
+		toBits(x);
+}
+
+// m_isDel is checked once here, not by each Exact
+static
+void appendUndeleted(const ReadableSegment* seg, const SegRecSet& s,
+					 llong baseId, valvec<llong>* recIdvec) {
+	const bm_uint_t* isDel = seg->m_isDel.bldata();
+	if (s.m_isBits) {
+		const bm_uint_t* bits = s.m_bits.bldata();
+		size_t nWords = s.m_bits.num_words();
+		size_t tail = s.m_bits.size() % WordBits;
+		for (size_t i = 0; i < nWords; ++i) {
+			bm_uint_t w = bits[i] & ~isDel[i];
+			if (i + 1 == nWords && tail)
+				w &= (bm_uint_t(1) << tail) - 1; // ids must be < rows
+			while (w) {
+				size_t id = i * WordBits + fast_ctz(w);
+				recIdvec->push_back(baseId + llong(id));
+				w &= w - 1;
+			}
+		}
+	}
+	else {
+		for (size_t id : s.m_list) {
+			if (!terark_bit_test(isDel, id))
+				recIdvec->push_back(baseId + llong(id));
+		}
+	}
+}
+
+} // namespace
+
+/// appended ids are sorted and are global ids(baseId + logicId)
+void
+IndexQuery::searchSegment(const ReadableSegment* seg, size_t segIdx,
+						  llong baseId, valvec<llong>* recIdvec,
+						  DbContext* ctx) const {
+	SegQueryEval ev(seg, segIdx, ctx);
+	if (0 == ev.rows())
+		return;
+	SegRecSet s;
+	ev.eval(*this, &s);
+	if (s.empty())
+		return;
+	// m_isDel may be remapped by a concurrent pushIsDel, same as
+	// WritableSegment::indexSearchExactAppend
+	const size_t ProtectCnt = 100;
+	if (seg->m_isFreezed || seg->m_isDel.unused() > ProtectCnt) {
+		appendUndeleted(seg, s, baseId, recIdvec);
+	}
+	else {
+		SpinRwLock lock(seg->m_segMutex, false);
+		appendUndeleted(seg, s, baseId, recIdvec);
+	}
+}
+
+} } // namespace terark::db
@@ -0,0 +1,54 @@
+#ifndef __terark_db_db_query_hpp__
+#define __terark_db_db_query_hpp__
+
+#include "db_conf.hpp"
+
+namespace terark { namespace db {
+
+class TERARK_DB_DLL ReadableSegment;
+class TERARK_DB_DLL DbContext;
+typedef boost::intrusive_ptr<class IndexQuery> IndexQueryPtr;
+
+// Boolean combination of index exact-match predicates, evaluated per
+// segment by CompositeTable::indexQuery, for example:
+//
+//   // index A = x AND index B in (y, z)
+//   IndexQueryPtr q = IndexQuery::And(IndexQuery::Exact(idA, x),
+//                                     IndexQuery::AnyOf(idB, {y, z}));
+//   ctx->indexQuery(*q, &recIdvec);
+//
+class TERARK_DB_DLL IndexQuery : public RefCounter {
+public:
+	enum class Op : unsigned char {
+		Exact,
+		And,
+		Or,
+		Not,
+	};
+	Op     m_op;
+	size_t m_indexId;       // for Exact
+	valvec<byte> m_key;     // for Exact
+	valvec<IndexQueryPtr> m_children; // for And, Or, Not
+
+	explicit IndexQuery(Op op);
+	~IndexQuery();
+
+	static IndexQueryPtr Exact(size_t indexId, fstring key);
+	static IndexQueryPtr AnyOf(size_t indexId, std::initializer_list<fstring> keys);
+	static IndexQueryPtr AnyOf(size_t indexId, const valvec<fstring>& keys);
+	static IndexQueryPtr And(IndexQueryPtr x, IndexQueryPtr y);
+	static IndexQueryPtr Or (IndexQueryPtr x, IndexQueryPtr y);
+	static IndexQueryPtr Not(IndexQueryPtr x);
+
+	IndexQuery* add(IndexQueryPtr child); // for And, Or
+
+	// each segment yields a sorted id list when the result is sparse, or a
+	// bitmap when dense, And/Or/Not are combined on them, m_isDel is
+	// checked only once for the final result
+	void searchSegment(const ReadableSegment*, size_t segIdx, llong baseId,
+					   valvec<llong>* recIdvec, DbContext*) const;
+};
+
+} } // namespace terark::db
+
+#endif // __terark_db_db_query_hpp__
@@ -2,9 +2,16 @@
 #include "db_segment.hpp"
 #include "intkey_index.hpp"
 #include "zip_int_store.hpp"
+#include "block_int_store.hpp"
+#include "dict_str_store.hpp"
+#include "run_len_store.hpp"
+#include "float_xor_store.hpp"
+#include "value_cache.hpp"
 #include "fixed_len_key_index.hpp"
+#include "mph_index.hpp"
 #include "fixed_len_store.hpp"
 #include "appendonly.hpp"
+#include "db_trace.hpp"
 #include <terark/util/autoclose.hpp>
 #include <terark/io/FileStream.hpp>
 #include <terark/io/StreamBuffer.hpp>
@@ -28,6 +35,7 @@
 #endif
 #include <fcntl.h>
 #include <float.h>
+#include <atomic>
 
 #include "json.hpp"
 
@@ -152,6 +160,12 @@ void ReadableSegment::openIndices(PathRef segDir) {
 		const Schema& schema = m_schema->getIndexSchema(i);
 		fs::path path = segDir / ("index-" + schema.m_name);
 		m_indices[i] = this->openIndex(schema, path.string());
+		fs::path histPath = path + ".hist";
+		if (fs::exists(histPath)) {
+			m_histograms.resize(m_schema->getIndexNum());
+			m_histograms[i] = new IndexHistogram();
+			m_histograms[i]->load(histPath);
+		}
 	}
 }
 
@@ -161,6 +175,9 @@ void ReadableSegment::saveIndices(PathRef segDir) const {
 		const Schema& schema = m_schema->getIndexSchema(i);
 		fs::path path = segDir / ("index-" + schema.m_name);
 		m_indices[i]->save(path.string());
+		if (i < m_histograms.size() && m_histograms[i]) {
+			m_histograms[i]->save(path + ".hist");
+		}
 	}
 }
 
@@ -260,6 +277,7 @@ ReadonlySegment::ReadonlySegment() {
 	m_dataInflateSize = 0;
 	m_isFreezed = true;
 	m_isPurgedMmap = 0;
+	m_valueCacheId = ValueCache::newSegmentId();
 }
 ReadonlySegment::~ReadonlySegment() {
 	if (m_isPurgedMmap) {
@@ -311,13 +329,19 @@ const {
 		const Schema& iSchema = m_schema->getColgroupSchema(i);
 		if (iSchema.m_keepCols.has_any1()) {
 			size_t oldsize = ctx->buf1.size();
-			m_colgroups[i]->getValueAppend(id, &ctx->buf1, ctx);
+			getColgroupValueAppend(i, id, &ctx->buf1, ctx);
 			iSchema.parseRowAppend(ctx->buf1, oldsize, &ctx->cols1);
 		}
 		else {
 			ctx->cols1.grow(iSchema.columnNum());
 		}
 	}
+	combineColgroups(val, ctx);
+}
+
+// ctx->cols1 are columns of all colgroups, combine them to a row
+void ReadonlySegment::combineColgroups(valvec<byte>* val, DbContext* ctx) const {
+	const size_t colgroupNum = m_colgroups.size();
 	assert(ctx->cols1.size() == m_schema->m_colgroupSchemaSet->m_flattenColumnNum);
 
 	// combine columns to ctx->cols2
@@ -375,6 +399,24 @@ ReadonlySegment::indexSearchExactAppend(size_t mySegIdx, size_t indexId,
 	recIdvec->risk_set_size(newsize);
 }
 
+void
+ReadonlySegment::indexSearchExactAppendNoDel(size_t mySegIdx, size_t indexId,
+											 fstring key, valvec<llong>* recIdvec,
+											 DbContext* ctx) const {
+	size_t oldsize = recIdvec->size();
+	auto index = m_indices[indexId].get();
+	index->searchExactAppend(key, recIdvec, ctx);
+	if (!m_isPurged.empty()) {
+		assert(m_isPurged.size() == m_isDel.size());
+		llong* recIdvecData = recIdvec->data();
+		for(size_t k = oldsize; k < recIdvec->size(); ++k) {
+			size_t physicId = (size_t)recIdvecData[k];
+			assert(physicId < m_isPurged.max_rank0());
+			recIdvecData[k] = m_isPurged.select0(physicId);
+		}
+	}
+}
+
 void
 ReadonlySegment::selectColumns(llong recId,
 							   const size_t* colsId, size_t colsNum,
@@ -384,8 +426,11 @@ const {
 	recId = getPhysicId(size_t(recId));
 	colsData->erase_all();
 	ctx->buf1.erase_all();
+	ctx->cols1.erase_all();
+	ctx->views.erase_all();
 	ctx->offsets.resize_fill(m_colgroups.size(), UINT32_MAX);
 	auto offsets = ctx->offsets.data();
+	const uint32_t isView = uint32_t(1) << 31; // offsets[cg] is in views
 	for(size_t i = 0; i < colsNum; ++i) {
 		assert(colsId[i] < m_schema->m_rowSchema->columnNum());
 		auto cp = m_schema->m_colproject[colsId[i]];
@@ -393,11 +438,31 @@ const {
 		size_t oldsize = ctx->buf1.size();
 		const Schema& schema = m_schema->getColgroupSchema(colgroupId);
 		if (offsets[colgroupId] == UINT32_MAX) {
-			offsets[colgroupId] = ctx->cols1.size();
-			m_colgroups[colgroupId]->getValueAppend(recId, &ctx->buf1, ctx);
-			schema.parseRowAppend(ctx->buf1, oldsize, &ctx->cols1);
+			fstring view;
+			if (getColgroupValueView(colgroupId, recId, &view, ctx)) {
+				offsets[colgroupId] = isView | uint32_t(ctx->views.size());
+				ctx->views.push_back(view);
+			}
+			else {
+				offsets[colgroupId] = ctx->cols1.size();
+				getColgroupValueAppend(colgroupId, recId, &ctx->buf1, ctx);
+				schema.parseRowAppend(ctx->buf1, oldsize, &ctx->cols1);
+			}
+		}
+		fstring d;
+		if (offsets[colgroupId] & isView) {
+			fstring view = ctx->views[offsets[colgroupId] & ~isView];
+			if (schema.getFixedRowLen()) {
+				const ColumnMeta& colmeta = schema.getColumnMeta(cp.subColumnId);
+				d = fstring(view.data() + colmeta.fixedOffset, colmeta.fixedLen);
+			} else {
+				schema.parseRow(view, &ctx->cols2);
+				d = ctx->cols2[cp.subColumnId];
+			}
+		}
+		else {
+			d = ctx->cols1[offsets[colgroupId] + cp.subColumnId];
 		}
-		fstring d = ctx->cols1[offsets[colgroupId] + cp.subColumnId];
 		if (i < colsNum-1)
 			schema.projectToNorm(d, cp.subColumnId, colsData);
 		else
@@ -417,11 +482,28 @@ const {
 	const Schema& schema = m_schema->getColgroupSchema(colgroupId);
 //	printf("colprojects = %zd, colgroupId = %zd, schema.cols = %zd\n"
 //		, m_schema->m_colproject.size(), colgroupId, schema.columnNum());
-	if (schema.columnNum() == 1) {
-		m_colgroups[colgroupId]->getValue(recId, colsData, ctx);
+	fstring view;
+	if (getColgroupValueView(colgroupId, recId, &view, ctx)) {
+		if (schema.columnNum() == 1) {
+			colsData->assign(view.udata(), view.size());
+		}
+		else if (schema.getFixedRowLen()) {
+			const ColumnMeta& colmeta = schema.getColumnMeta(cp.subColumnId);
+			colsData->assign(view.udata() + colmeta.fixedOffset, colmeta.fixedLen);
+		}
+		else {
+			schema.parseRow(view, &ctx->cols1);
+			fstring d = ctx->cols1[cp.subColumnId];
+			colsData->assign(d.udata(), d.size());
+		}
+	}
+	else if (schema.columnNum() == 1) {
+		colsData->erase_all();
+		getColgroupValueAppend(colgroupId, recId, colsData, ctx);
 	}
 	else {
-		m_colgroups[colgroupId]->getValue(recId, &ctx->buf1, ctx);
+		ctx->buf1.erase_all();
+		getColgroupValueAppend(colgroupId, recId, &ctx->buf1, ctx);
 		schema.parseRow(ctx->buf1, &ctx->cols1);
 		colsData->erase_all();
 		colsData->append(ctx->cols1[cp.subColumnId]);
@@ -438,17 +520,91 @@ void ReadonlySegment::selectColgroups(llong recId,
 				, cgId, m_schema->getColgroupNum());
 		}
 		llong physicId = this->getPhysicId(recId);
-		m_colgroups[cgId]->getValue(physicId, &cgDataVec[i], ctx);
+		cgDataVec[i].erase_all();
+		getColgroupValueAppend(cgId, physicId, &cgDataVec[i], ctx);
 	}
 }
 
+void
+ReadonlySegment::getColgroupValueAppend(size_t colgroupId, size_t physicId,
+										valvec<byte>* val, DbContext* ctx)
+const {
+	const ReadableStore* store = m_colgroups[colgroupId].get();
+	if (m_cachedColgroups.empty() || !m_cachedColgroups[colgroupId]) {
+		store->getValueAppend(physicId, val, ctx);
+		return;
+	}
+	ValueCache* cache = ValueCache::global();
+	if (cache->getAppend(m_valueCacheId, colgroupId, physicId, val)) {
+		return;
+	}
+	size_t oldsize = val->size();
+	store->getValueAppend(physicId, val, ctx);
+	cache->put(m_valueCacheId, colgroupId, physicId,
+			   fstring(val->data() + oldsize, val->size() - oldsize));
+}
+
+bool
+ReadonlySegment::getColgroupValueView(size_t colgroupId, size_t physicId,
+									  fstring* view, DbContext* ctx)
+const {
+	if (!m_cachedColgroups.empty() && m_cachedColgroups[colgroupId]) {
+		return false;
+	}
+	return m_colgroups[colgroupId]->getValueView(physicId, view, ctx);
+}
+
+bool ReadonlySegment::isValueCacheable(const ReadableStore*) const {
+	return false;
+}
+
+// zip native forward iterators of colgroups, so a full scan decodes each
+// colgroup sequentially instead of random access by getValueByPhysicId
 class ReadonlySegment::MyStoreIterForward : public StoreIterator {
 	llong  m_id = 0;
+	llong  m_nextPhysicId = 0; // position of all m_cgIters
 	DbContextPtr m_ctx;
+	valvec<StoreIteratorPtr> m_cgIters; // null for colgroups not kept
+	valvec<byte> m_cgData;
+	void getValueByPhysicId(llong physicId, valvec<byte>* val) {
+		auto owner = static_cast<const ReadonlySegment*>(m_store.get());
+		DbContext* ctx = m_ctx.get();
+		val->risk_set_size(0);
+		ctx->buf1.risk_set_size(0);
+		ctx->cols1.erase_all();
+		for (size_t i = 0; i < m_cgIters.size(); ++i) {
+			const Schema& iSchema = owner->m_schema->getColgroupSchema(i);
+			if (m_cgIters[i]) {
+				llong subId = -1;
+				bool ok = physicId == m_nextPhysicId
+						? m_cgIters[i]->increment(&subId, &m_cgData)
+						: m_cgIters[i]->seekExact(physicId, &m_cgData);
+				if (!ok) {
+					THROW_STD(out_of_range, "colgroup %s, physicId = %lld"
+						, iSchema.m_name.c_str(), physicId);
+				}
+				size_t oldsize = ctx->buf1.size();
+				ctx->buf1.append(m_cgData);
+				iSchema.parseRowAppend(ctx->buf1, oldsize, &ctx->cols1);
+			}
+			else {
+				ctx->cols1.grow(iSchema.columnNum());
+			}
+		}
+		m_nextPhysicId = physicId + 1;
+		owner->combineColgroups(val, ctx);
+	}
 public:
 	MyStoreIterForward(const ReadonlySegment* owner, DbContext* ctx)
 	  : m_ctx(ctx) {
 		m_store.reset(const_cast<ReadonlySegment*>(owner));
+		m_cgIters.resize(owner->m_colgroups.size());
+		for (size_t i = 0; i < m_cgIters.size(); ++i) {
+			const Schema& iSchema = owner->m_schema->getColgroupSchema(i);
+			if (iSchema.m_keepCols.has_any1()) {
+				m_cgIters[i] = owner->m_colgroups[i]->ensureStoreIterForward(ctx);
+			}
+		}
 	}
 	bool increment(llong* id, valvec<byte>* val) override {
 		auto owner = static_cast<const ReadonlySegment*>(m_store.get());
@@ -456,7 +612,7 @@ public:
 			m_id++;
 		if (size_t(m_id) < owner->m_isDel.size()) {
 			*id = m_id++;
-			owner->getValueByLogicId(*id, val, m_ctx.get());
+			getValueByPhysicId(owner->getPhysicId(*id), val);
 			return true;
 		}
 		return false;
@@ -468,6 +624,11 @@ public:
 	}
 	void reset() override {
 		m_id = 0;
+		m_nextPhysicId = 0;
+		for (auto& iter : m_cgIters) {
+			if (iter)
+				iter->reset();
+		}
 	}
 };
 class ReadonlySegment::MyStoreIterBackward : public StoreIterator {
@@ -507,85 +668,83 @@ StoreIterator* ReadonlySegment::createStoreIterBackward(DbContext* ctx) const {
 	return new MyStoreIterBackward(this, ctx);
 }
 
-namespace {
-	class TempFileList {
-		const SchemaSet& m_schemaSet;
-		valvec<byte> m_projRowBuf;
-		valvec<ReadableStorePtr> m_readers;
-		valvec<AppendableStore*> m_appenders;
-		TERARK_IF_DEBUG(ColumnVec m_debugCols;,;);
-	public:
-		TempFileList(PathRef segDir, const SchemaSet& schemaSet)
-			: m_schemaSet(schemaSet)
-		{
-			size_t cgNum = schemaSet.m_nested.end_i();
-			m_readers.resize(cgNum);
-			m_appenders.resize(cgNum);
-			for (size_t i = 0; i < cgNum; ++i) {
-				const Schema& schema = *schemaSet.m_nested.elem_at(i);
-				if (schema.getFixedRowLen()) {
-					m_readers[i] = new FixedLenStore(segDir, schema);
-				}
-				else {
-					m_readers[i] = new SeqReadAppendonlyStore(segDir, schema);
-				}
-				m_appenders[i] = m_readers[i]->getAppendableStore();
+class ReadonlySegment::TempFileList {
+	const SchemaSet& m_schemaSet;
+	valvec<byte> m_projRowBuf;
+	valvec<ReadableStorePtr> m_readers;
+	valvec<AppendableStore*> m_appenders;
+	TERARK_IF_DEBUG(ColumnVec m_debugCols;,;);
+public:
+	TempFileList(PathRef segDir, const SchemaSet& schemaSet)
+		: m_schemaSet(schemaSet)
+	{
+		size_t cgNum = schemaSet.m_nested.end_i();
+		m_readers.resize(cgNum);
+		m_appenders.resize(cgNum);
+		for (size_t i = 0; i < cgNum; ++i) {
+			const Schema& schema = *schemaSet.m_nested.elem_at(i);
+			if (schema.getFixedRowLen()) {
+				m_readers[i] = new FixedLenStore(segDir, schema);
+			}
+			else {
+				m_readers[i] = new SeqReadAppendonlyStore(segDir, schema);
 			}
+			m_appenders[i] = m_readers[i]->getAppendableStore();
 		}
-		void writeColgroups(const ColumnVec& columns) {
-			size_t colgroupNum = m_readers.size();
-			for (size_t i = 0; i < colgroupNum; ++i) {
-				const Schema& schema = *m_schemaSet.m_nested.elem_at(i);
-				schema.selectParent(columns, &m_projRowBuf);
+	}
+	void writeColgroups(const ColumnVec& columns) {
+		size_t colgroupNum = m_readers.size();
+		for (size_t i = 0; i < colgroupNum; ++i) {
+			const Schema& schema = *m_schemaSet.m_nested.elem_at(i);
+			schema.selectParent(columns, &m_projRowBuf);
 #if !defined(NDEBUG)
-				schema.parseRow(m_projRowBuf, &m_debugCols);
-				assert(m_debugCols.size() == schema.columnNum());
-				for(size_t j = 0; j < m_debugCols.size(); ++j) {
-					size_t k = schema.parentColumnId(j);
-					assert(k < columns.size());
-					assert(m_debugCols[j] == columns[k]);
-				}
+			schema.parseRow(m_projRowBuf, &m_debugCols);
+			assert(m_debugCols.size() == schema.columnNum());
+			for(size_t j = 0; j < m_debugCols.size(); ++j) {
+				size_t k = schema.parentColumnId(j);
+				assert(k < columns.size());
+				assert(m_debugCols[j] == columns[k]);
+			}
 #endif
-				m_appenders[i]->append(m_projRowBuf, NULL);
+			m_appenders[i]->append(m_projRowBuf, NULL);
+		}
+	}
+	void completeWrite() {
+		size_t colgroupNum = m_readers.size();
+		for (size_t i = 0; i < colgroupNum; ++i) {
+			m_appenders[i]->shrinkToFit();
+		}
+	}
+	ReadableStore* getStore(size_t cgId) const {
+		return m_readers[cgId].get();
+	}
+	size_t size() const { return m_readers.size(); }
+	size_t
+	collectData(size_t cgId, StoreIterator* iter, SortableStrVec& strVec,
+				size_t maxMemSize = size_t(-1)) const {
+		assert(strVec.m_index.size() == 0);
+		assert(strVec.m_strpool.size() == 0);
+		const Schema& schema = *m_schemaSet.getSchema(cgId);
+		const llong   rows = iter->getStore()->numDataRows();
+		const size_t  fixlen = schema.getFixedRowLen();
+		if (fixlen == 0) {
+			valvec<byte> buf;
+			llong  recId = INT_MAX; // for fail fast
+			while (strVec.mem_size() < maxMemSize && iter->increment(&recId, &buf)) {
+				assert(recId < rows);
+				strVec.push_back(buf);
 			}
+			return strVec.size();
 		}
-		void completeWrite() {
-			size_t colgroupNum = m_readers.size();
-			for (size_t i = 0; i < colgroupNum; ++i) {
-				m_appenders[i]->shrinkToFit();
-			}
+		else { // ignore maxMemSize
+			size_t size = fixlen * rows;
+			strVec.m_strpool.resize_no_init(size);
+			byte_t* basePtr = iter->getStore()->getRecordsBasePtr();
+			memcpy(strVec.m_strpool.data(), basePtr, size);
+			return rows;
 		}
-		ReadableStore* getStore(size_t cgId) const {
-			return m_readers[cgId].get();
-		}
-		size_t size() const { return m_readers.size(); }
-		size_t
-		collectData(size_t cgId, StoreIterator* iter, SortableStrVec& strVec,
-					size_t maxMemSize = size_t(-1)) const {
-			assert(strVec.m_index.size() == 0);
-			assert(strVec.m_strpool.size() == 0);
-			const Schema& schema = *m_schemaSet.getSchema(cgId);
-			const llong   rows = iter->getStore()->numDataRows();
-			const size_t  fixlen = schema.getFixedRowLen();
-			if (fixlen == 0) {
-				valvec<byte> buf;
-				llong  recId = INT_MAX; // for fail fast
-				while (strVec.mem_size() < maxMemSize && iter->increment(&recId, &buf)) {
-					assert(recId < rows);
-					strVec.push_back(buf);
-				}
-				return strVec.size();
-			}
-			else { // ignore maxMemSize
-				size_t size = fixlen * rows;
-				strVec.m_strpool.resize_no_init(size);
-				byte_t* basePtr = iter->getStore()->getRecordsBasePtr();
-				memcpy(strVec.m_strpool.data(), basePtr, size);
-				return rows;
-			}
-		}
-	};
-}
+	}
+};
 
 ///@param iter record id from iter is physical id
 ///@param isDel new logical deletion mark
@@ -598,6 +757,12 @@ ReadonlySegment::buildDictZipStore(const Schema&, PathRef, StoreIterator& iter,
 		"Not Implemented, Only Implemented by DfaDbReadonlySegment");
 }
 
+ReadableStore*
+ReadonlySegment::buildFastStore(const Schema& schema, SortableStrVec& storeData)
+const {
+	return this->buildStore(schema, storeData);
+}
+
 /*
 namespace {
 
@@ -636,6 +801,81 @@ public:
 }
 */
 
+void
+ReadonlySegment::buildFromTempFiles(TempFileList& colgroupTempFiles,
+									llong newRowNum, PathRef tmpDir,
+									const std::string& tabDir, size_t segIdx,
+									const char* traceCat)
+{
+	size_t indexNum = m_schema->getIndexNum();
+	// build index from temporary index files
+	colgroupTempFiles.completeWrite();
+	m_indices.resize(indexNum);
+	m_colgroups.resize(m_schema->getColgroupNum());
+	for (size_t i = 0; i < indexNum; ++i) {
+		SortableStrVec strVec;
+		const Schema& schema = m_schema->getIndexSchema(i);
+		auto tmpStore = colgroupTempFiles.getStore(i);
+		BgTaskTraceScope trace(traceCat, "buildIndex", tabDir, segIdx);
+		trace.setBytesIn(tmpStore->dataInflateSize());
+		StoreIteratorPtr iter = tmpStore->ensureStoreIterForward(NULL);
+		colgroupTempFiles.collectData(i, iter.get(), strVec);
+		m_indices[i] = this->buildIndex(schema, strVec);
+		m_colgroups[i] = m_indices[i]->getReadableStore();
+		trace.setBytesOut(m_indices[i]->indexStorageSize());
+		if (!schema.m_enableLinearScan) {
+			iter.reset();
+			tmpStore->deleteFiles();
+		}
+	}
+	buildHistograms();
+	for (size_t i = indexNum; i < colgroupTempFiles.size(); ++i) {
+		const Schema& schema = m_schema->getColgroupSchema(i);
+		auto tmpStore = colgroupTempFiles.getStore(i);
+		if (schema.should_use_FixedLenStore()) {
+			m_colgroups[i] = tmpStore;
+			continue;
+		}
+		// dictZipLocalMatch is true by default
+		// dictZipLocalMatch == false is just for experiment
+		// dictZipLocalMatch should always be true in production
+		// dictZipSampleRatio < 0 indicate don't use dictZip
+		if (schema.m_dictZipLocalMatch && schema.m_dictZipSampleRatio >= 0.0
+				&& schema.m_blockZipBytes <= 0) {
+			double sRatio = schema.m_dictZipSampleRatio;
+			double avgLen = double(tmpStore->dataInflateSize()) / newRowNum;
+			if (sRatio > 0 || (sRatio < FLT_EPSILON && avgLen > 100)) {
+				BgTaskTraceScope trace(traceCat, "dictZip", tabDir, segIdx);
+				trace.setBytesIn(tmpStore->dataInflateSize());
+				StoreIteratorPtr iter = tmpStore->ensureStoreIterForward(NULL);
+				m_colgroups[i] = buildDictZipStore(schema, tmpDir, *iter, NULL, NULL);
+				trace.setBytesOut(m_colgroups[i]->dataStorageSize());
+				iter.reset();
+				tmpStore->deleteFiles();
+				continue;
+			}
+		}
+		size_t maxMem = m_schema->m_compressingWorkMemSize;
+		llong rows = 0;
+		valvec<ReadableStorePtr> parts;
+		BgTaskTraceScope trace(traceCat, "buildStore", tabDir, segIdx);
+		trace.setBytesIn(tmpStore->dataInflateSize());
+		StoreIteratorPtr iter = tmpStore->ensureStoreIterForward(NULL);
+		while (rows < newRowNum) {
+			SortableStrVec strVec;
+			rows += colgroupTempFiles.collectData(i, iter.get(), strVec, maxMem);
+			if (schema.m_blockZipBytes > 0)
+				parts.push_back(this->buildFastStore(schema, strVec));
+			else
+				parts.push_back(this->buildStore(schema, strVec));
+		}
+		m_colgroups[i] = parts.size()==1 ? parts[0] : new MultiPartStore(parts);
+		trace.setBytesOut(m_colgroups[i]->dataStorageSize());
+		iter.reset();
+		tmpStore->deleteFiles();
+	}
+}
+
 void
 ReadonlySegment::convFrom(CompositeTable* tab, size_t segIdx)
 {
@@ -660,10 +900,12 @@ ReadonlySegment::convFrom(CompositeTable* tab, size_t segIdx)
 	llong logicRowNum = input->m_isDel.size();
 	llong newRowNum = 0;
 	assert(logicRowNum > 0);
-	size_t indexNum = m_schema->getIndexNum();
+	const std::string tabDir = tab->m_dir.string();
 {
 	TempFileList colgroupTempFiles(tmpDir, *m_schema->m_colgroupSchemaSet);
 {
+	BgTaskTraceScope trace("compress", "parse", tabDir, segIdx);
+	llong bytesIn = 0;
 	ColumnVec columns(m_schema->columnNum(), valvec_reserve());
 	valvec<byte> buf;
 	StoreIteratorPtr iter(input->createStoreIterForward(ctx.get()));
@@ -676,6 +918,7 @@ ReadonlySegment::convFrom(CompositeTable* tab, size_t segIdx)
 		if (!m_isDel[id]) {
 			m_schema->m_rowSchema->parseRow(buf, &columns);
 			colgroupTempFiles.writeColgroups(columns);
+			bytesIn += buf.size();
 			newRowNum++;
 			m_isDel.beg_end_set1(prevId+1, id);
 			prevId = id;
@@ -693,66 +936,62 @@ ReadonlySegment::convFrom(CompositeTable* tab, size_t segIdx)
 	m_delcnt = m_isDel.popcnt(); // recompute delcnt
 	assert(newRowNum <= inputRowNum);
 	assert(size_t(logicRowNum - newRowNum) == m_delcnt);
+	trace.setBytesIn(bytesIn);
 }
-	// build index from temporary index files
-	colgroupTempFiles.completeWrite();
-	m_indices.resize(indexNum);
-	m_colgroups.resize(m_schema->getColgroupNum());
-	for (size_t i = 0; i < indexNum; ++i) {
-		SortableStrVec strVec;
-		const Schema& schema = m_schema->getIndexSchema(i);
-		auto tmpStore = colgroupTempFiles.getStore(i);
-		StoreIteratorPtr iter = tmpStore->ensureStoreIterForward(NULL);
-		colgroupTempFiles.collectData(i, iter.get(), strVec);
-		m_indices[i] = this->buildIndex(schema, strVec);
-		m_colgroups[i] = m_indices[i]->getReadableStore();
-		if (!schema.m_enableLinearScan) {
-			iter.reset();
-			tmpStore->deleteFiles();
-		}
-	}
-	for (size_t i = indexNum; i < colgroupTempFiles.size(); ++i) {
-		const Schema& schema = m_schema->getColgroupSchema(i);
-		auto tmpStore = colgroupTempFiles.getStore(i);
-		if (schema.should_use_FixedLenStore()) {
-			m_colgroups[i] = tmpStore;
-			continue;
-		}
-		// dictZipLocalMatch is true by default
-		// dictZipLocalMatch == false is just for experiment
-		// dictZipLocalMatch should always be true in production
-		// dictZipSampleRatio < 0 indicate don't use dictZip
-		if (schema.m_dictZipLocalMatch && schema.m_dictZipSampleRatio >= 0.0) {
-			double sRatio = schema.m_dictZipSampleRatio;
-			double avgLen = double(tmpStore->dataInflateSize()) / newRowNum;
-			if (sRatio > 0 || (sRatio < FLT_EPSILON && avgLen > 100)) {
-				StoreIteratorPtr iter = tmpStore->ensureStoreIterForward(NULL);
-				m_colgroups[i] = buildDictZipStore(schema, tmpDir, *iter, NULL, NULL);
-				iter.reset();
-				tmpStore->deleteFiles();
-				continue;
-			}
-		}
-		size_t maxMem = m_schema->m_compressingWorkMemSize;
-		llong rows = 0;
-		valvec<ReadableStorePtr> parts;
-		StoreIteratorPtr iter = tmpStore->ensureStoreIterForward(NULL);
-		while (rows < newRowNum) {
-			SortableStrVec strVec;
-			rows += colgroupTempFiles.collectData(i, iter.get(), strVec, maxMem);
-			parts.push_back(this->buildStore(schema, strVec));
-		}
-		m_colgroups[i] = parts.size()==1 ? parts[0] : new MultiPartStore(parts);
-		iter.reset();
-		tmpStore->deleteFiles();
-	}
+	buildFromTempFiles(colgroupTempFiles, newRowNum, tmpDir, tabDir, segIdx, "compress");
 }
+  {
+	BgTaskTraceScope trace("compress", "completeAndReload", tabDir, segIdx);
 	completeAndReload(tab, segIdx, &*input);
-
+  }
+	BgTaskTraceScope trace("compress", "rename", tabDir, segIdx);
 	fs::rename(tmpDir, m_segDir);
 	input->deleteSegment();
 }
 
+///@param rows  full rows, no one is deleted
+///@param chunkIdx is just for trace
+///@note  build and save into m_segDir, then reload as mmap
+void
+ReadonlySegment::buildFromRows(const SortableStrVec& rows,
+							   const std::string& tabDir, size_t chunkIdx)
+{
+	llong newRowNum = rows.size();
+	assert(newRowNum > 0);
+	fs::create_directories(m_segDir);
+	m_isDel.resize_fill(size_t(newRowNum), false);
+	m_delcnt = 0;
+{
+	TempFileList colgroupTempFiles(m_segDir, *m_schema->m_colgroupSchemaSet);
+  {
+	BgTaskTraceScope trace("bulkload", "parse", tabDir, chunkIdx);
+	ColumnVec columns(m_schema->columnNum(), valvec_reserve());
+	for (size_t i = 0; i < rows.size(); ++i) {
+		m_schema->m_rowSchema->parseRow(rows[i], &columns);
+		colgroupTempFiles.writeColgroups(columns);
+	}
+	trace.setBytesIn(rows.str_size());
+  }
+	buildFromTempFiles(colgroupTempFiles, newRowNum, m_segDir, tabDir, chunkIdx, "bulkload");
+}
+	m_dataMemSize = 0;
+	m_dataInflateSize = 0;
+	for (size_t i = 0; i < m_colgroups.size(); ++i) {
+		m_dataMemSize += m_colgroups[i]->dataStorageSize();
+		m_dataInflateSize += m_colgroups[i]->dataInflateSize();
+	}
+	BgTaskTraceScope trace("bulkload", "save", tabDir, chunkIdx);
+	this->save(m_segDir);
+
+	// reload as mmap
+	m_isDel.clear();
+	m_isPurged.clear();
+	m_indices.erase_all();
+	m_colgroups.erase_all();
+	this->load(m_segDir);
+	assert(this->m_isDel.size() == size_t(newRowNum));
+}
+
 void
 ReadonlySegment::completeAndReload(CompositeTable* tab, size_t segIdx,
 								   ReadableSegment* input) {
@@ -904,7 +1143,11 @@ static inline
 void pushRecord(SortableStrVec& strVec, const ReadableStore& store,
 				llong physicId, size_t fixlen, DbContext* ctx) {
 	size_t oldsize = strVec.str_size();
-	store.getValueAppend(physicId, &strVec.m_strpool, ctx);
+	fstring view;
+	if (store.getValueView(physicId, &view, ctx))
+		strVec.m_strpool.append(view.udata(), view.size());
+	else
+		store.getValueAppend(physicId, &strVec.m_strpool, ctx);
 	if (!fixlen) {
 		SortableStrVec::SEntry ent;
 		ent.offset = oldsize;
@@ -956,14 +1199,25 @@ ReadonlySegment::purgeDeletedRecords(CompositeTable* tab, size_t segIdx) {
 	m_colgroups.resize(m_schema->getColgroupNum());
 	auto tmpSegDir = m_segDir + ".tmp";
 	fs::create_directories(tmpSegDir);
+	const std::string tabDir = tab->m_dir.string();
 	for (size_t i = 0; i < m_indices.size(); ++i) {
+		BgTaskTraceScope trace("purge", "buildIndex", tabDir, segIdx);
 		m_indices[i] = purgeIndex(i, input.get(), ctx.get());
 		m_colgroups[i] = m_indices[i]->getReadableStore();
+		trace.setBytesOut(m_indices[i]->indexStorageSize());
 	}
+	buildHistograms();
 	for (size_t i = m_indices.size(); i < m_colgroups.size(); ++i) {
+		BgTaskTraceScope trace("purge", "buildStore", tabDir, segIdx);
+		trace.setBytesIn(input->m_colgroups[i]->dataStorageSize());
 		m_colgroups[i] = purgeColgroup(i, input.get(), ctx.get(), tmpSegDir);
+		trace.setBytesOut(m_colgroups[i]->dataStorageSize());
 	}
+  {
+	BgTaskTraceScope trace("purge", "completeAndReload", tabDir, segIdx);
 	completeAndReload(tab, segIdx, &*input);
+  }
+	BgTaskTraceScope trace("purge", "rename", tabDir, segIdx);
 	assert(input->m_segDir == this->m_segDir);
 	fs::path backupDir = renameToBackupFromDir(input->m_segDir);
 	{
@@ -983,6 +1237,25 @@ ReadonlySegment::purgeDeletedRecords(CompositeTable* tab, size_t segIdx) {
 	}
 }
 
+void ReadonlySegment::buildHistograms() {
+	size_t buckets = IndexHistogram::getDefaultBucketNum();
+	m_histograms.erase_all();
+	if (0 == buckets) {
+		return; // disabled
+	}
+	m_histograms.resize(m_indices.size());
+	for (size_t i = 0; i < m_indices.size(); ++i) {
+		const Schema& schema = m_schema->getIndexSchema(i);
+		if (!schema.m_isOrdered)
+			continue;
+		IndexIteratorPtr iter = m_indices[i]->createIndexIterForward(NULL);
+		if (!iter)
+			continue;
+		m_histograms[i] = new IndexHistogram();
+		m_histograms[i]->build(schema, iter.get(), getPhysicRows(), buckets);
+	}
+}
+
 ReadableIndexPtr
 ReadonlySegment::purgeIndex(size_t indexId, ReadonlySegment* input, DbContext* ctx) {
 	llong inputRowNum = input->m_isDel.size();
@@ -1045,9 +1318,9 @@ ReadonlySegment::purgeColgroup(size_t colgroupId, ReadonlySegment* input, DbCont
 		for (llong logicId = 0; logicId < inputRowNum; logicId++) {
 			if (!isPurged || !terark_bit_test(isPurged, logicId)) {
 				if (!terark_bit_test(isDel, logicId)) {
-					colgroup.getValue(physicId, &buf, ctx);
-					assert(buf.size() == schema.getFixedRowLen());
-					store->append(buf, ctx);
+					fstring val = colgroup.getValueViewOrCopy(physicId, &buf, ctx);
+					assert(val.size() == schema.getFixedRowLen());
+					store->append(val, ctx);
 				}
 				physicId++;
 			}
@@ -1279,6 +1552,16 @@ void ReadonlySegment::loadRecordStore(PathRef segDir) {
 			m_colgroups[i] = ReadableStore::openStore(schema, segDir, fname);
 		}
 	}
+	m_cachedColgroups.clear();
+	if (ValueCache::global()) {
+		m_cachedColgroups.resize(colgroupNum, false);
+		for (size_t i = 0; i < colgroupNum; ++i) {
+			const Schema& schema = m_schema->getColgroupSchema(i);
+			if (!schema.m_isInplaceUpdatable &&
+					isValueCacheable(m_colgroups[i].get()))
+				m_cachedColgroups.set1(i);
+		}
+	}
 }
 
 void ReadonlySegment::closeFiles() {
@@ -1304,6 +1587,11 @@ ReadonlySegment::openIndex(const Schema& schema, PathRef path) const {
 		store->load(path);
 		return store.release();
 	}
+	if (boost::filesystem::exists(path + ".mph")) {
+		std::unique_ptr<MinPerfectHashIndex> store(new MinPerfectHashIndex());
+		store->load(path);
+		return store.release();
+	}
 	if (boost::filesystem::exists(path + ".empty")) {
 		std::unique_ptr<EmptyIndexStore> store(new EmptyIndexStore());
 		store->load(path);
@@ -1316,6 +1604,11 @@ ReadableIndex*
 ReadonlySegment::buildIndex(const Schema& schema, SortableStrVec& indexData)
 const {
 	const size_t fixlen = schema.getFixedRowLen();
+	if (!schema.m_isOrdered) {
+		std::unique_ptr<MinPerfectHashIndex> index(new MinPerfectHashIndex());
+		index->build(schema, indexData);
+		return index.release();
+	}
 	if (schema.columnNum() == 1 && schema.getColumnMeta(0).isInteger()) {
 		try {
 			std::unique_ptr<ZipIntKeyIndex> index(new ZipIntKeyIndex());
@@ -1338,24 +1631,74 @@ ReadableStore*
 ReadonlySegment::buildStore(const Schema& schema, SortableStrVec& storeData)
 const {
 	assert(!schema.should_use_FixedLenStore());
+	// build all applicable stores, keep the smallest one
+	std::unique_ptr<ReadableStore> best;
+	auto pick = [&](ReadableStore* store) {
+		if (!best || store->dataStorageSize() < best->dataStorageSize())
+			best.reset(store);
+		else
+			delete store;
+	};
+	const size_t fixlen = schema.getFixedRowLen();
+	const size_t rows = storeData.m_index.size() ? storeData.m_index.size()
+					  : fixlen ? storeData.m_strpool.size() / fixlen : 0;
+	const double maxRunRatio = RunLenStore::getMaxRunRatio();
+	if (maxRunRatio > 0) {
+		std::unique_ptr<RunLenStore> store(new RunLenStore(schema));
+		if (store->build(schema, storeData, size_t(rows * maxRunRatio)))
+			pick(store.release());
+	}
 	if (schema.columnNum() == 1 && schema.getColumnMeta(0).isInteger()) {
-		assert(schema.getFixedRowLen() > 0);
+		assert(fixlen > 0);
+		ColumnType intType = schema.getColumnMeta(0).type;
+		// ZipIntStore is good for low cardinality, BlockIntStore is good
+		// for time series and columns with outliers
 		try {
 			std::unique_ptr<ZipIntStore> store(new ZipIntStore(schema));
-			store->build(schema.getColumnMeta(0).type, storeData);
-			return store.release();
+			store->build(intType, storeData);
+			pick(store.release());
+		}
+		catch (const std::exception&) {
+		}
+		try {
+			std::unique_ptr<BlockIntStore> store(new BlockIntStore(schema));
+			store->build(intType, storeData);
+			pick(store.release());
 		}
 		catch (const std::exception&) {
-			// ignore and fall through
-			fprintf(stderr,
-"try to build ZipIntStore: on %s failed, fallback to FixedLenStore\n",
-				schema.m_name.c_str());
-			std::unique_ptr<FixedLenStore> store(new FixedLenStore(m_segDir, schema));
-			store->build(storeData);
-			return store.release();
 		}
+		if (best)
+			return best.release();
+		// ignore and fall through
+		fprintf(stderr,
+"try to build ZipIntStore: on %s failed, fallback to FixedLenStore\n",
+			schema.m_name.c_str());
+		std::unique_ptr<FixedLenStore> store(new FixedLenStore(m_segDir, schema));
+		store->build(storeData);
+		return store.release();
 	}
-	return nullptr;
+	if (schema.columnNum() == 1 &&
+		(ColumnType::Float32 == schema.getColumnMeta(0).type ||
+		 ColumnType::Float64 == schema.getColumnMeta(0).type)) {
+		assert(fixlen > 0);
+		std::unique_ptr<FloatXorStore> store(new FloatXorStore(schema));
+		store->build(schema.getColumnMeta(0).type, storeData);
+		pick(store.release());
+		if (best->dataStorageSize() < llong(storeData.m_strpool.size()))
+			return best.release();
+		// random floats are not compressible
+		best.reset();
+		std::unique_ptr<FixedLenStore> fixstore(new FixedLenStore(m_segDir, schema));
+		fixstore->build(storeData);
+		return fixstore.release();
+	}
+	const double maxDictRatio = DictStrStore::getMaxDistinctRatio();
+	if (maxDictRatio > 0) {
+		std::unique_ptr<DictStrStore> store(new DictStrStore(schema));
+		if (store->build(schema, storeData, size_t(rows * maxDictRatio)))
+			pick(store.release());
+	}
+	return best.release();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1403,6 +1746,14 @@ void WritableSegment::pushIsDel(bool val) {
 	((uint64_t*)m_isDelMmap)[0] = m_isDel.size();
 }
 
+void WritableSegment::atomicSet0IsDel(size_t subId) {
+	assert(subId < m_isDel.size());
+	assert(m_isDel.is1(subId));
+	auto word = (std::atomic<bm_uint_t>*)(m_isDel.bldata() + subId / WordBits);
+	word->fetch_and(~(bm_uint_t(1) << subId % WordBits), std::memory_order_release);
+	((std::atomic<size_t>&)m_delcnt).fetch_sub(1, std::memory_order_relaxed);
+}
+
 void WritableSegment::popIsDel() {
 	assert(m_isDel.size() >= 1);
 	assert(m_isDel.size() == size_t(((uint64_t*)m_isDelMmap)[0]));
@@ -1440,6 +1791,28 @@ const {
 	}
 }
 
+void
+WritableSegment::indexSearchExactAppendNoDel(size_t mySegIdx, size_t indexId,
+											 fstring key, valvec<llong>* recIdvec,
+											 DbContext* ctx) const {
+	assert(mySegIdx < ctx->m_segCtx.size());
+	assert(ctx->getSegmentPtr(mySegIdx) == this);
+	assert(m_isPurged.empty());
+	IndexIterator* iter = ctx->getIndexIterNoLock(mySegIdx, indexId);
+	llong recId = -1;
+	int cmp = iter->seekLowerBound(key, &recId, &ctx->key2);
+	if (cmp == 0) {
+		if (iter->isUniqueInSchema()) {
+			recIdvec->push_back(recId);
+		}
+		else {
+			do {
+				recIdvec->push_back(recId);
+			} while (iter->increment(&recId, &ctx->key2) && key == ctx->key2);
+		}
+	}
+}
+
 void
 WritableSegment::indexSearchExactAppend(size_t mySegIdx, size_t indexId,
 										fstring key, valvec<llong>* recIdvec,
@@ -3,6 +3,7 @@
 
 #include "db_index.hpp"
 #include "db_store.hpp"
+#include "index_stat.hpp"
 #include <terark/bitmap.hpp>
 #include <terark/rank_select.hpp>
 #include <tbb/spin_rw_mutex.h>
@@ -47,6 +48,12 @@ public:
 										fstring key, valvec<llong>* recIdvec,
 										DbContext*) const = 0;
 
+	///@{ m_isDel is not checked, appended ids are logic ids, not sorted
+	virtual void indexSearchExactAppendNoDel(size_t mySegIdx, size_t indexId,
+											 fstring key, valvec<llong>* recIdvec,
+											 DbContext*) const = 0;
+	///@}
+
 	virtual void selectColumns(llong recId, const size_t* colsId, size_t colsNum,
 							   valvec<byte>* colsData, DbContext*) const = 0;
 	virtual void selectOneColumn(llong recId, size_t columnId,
@@ -82,6 +89,7 @@ public:
 	febitvec    m_isDel;
 	byte*       m_isDelMmap = nullptr;
 	rank_select_se m_isPurged; // just for ReadonlySegment
+	valvec<IndexHistogramPtr> m_histograms; // just for ReadonlySegment
 	byte*          m_isPurgedMmap;
 	boost::filesystem::path m_segDir;
 	mutable SpinRwMutex m_segMutex;
@@ -125,14 +133,23 @@ public:
 	StoreIterator* createStoreIterBackward(DbContext*) const override;
 
 	void convFrom(class CompositeTable*, size_t segIdx);
+	void buildFromRows(const SortableStrVec& rows,
+					   const std::string& tabDir, size_t chunkIdx);
 	void purgeDeletedRecords(class CompositeTable*, size_t segIdx);
 
+	// histograms of ordered indices, for range cardinality estimation
+	void buildHistograms();
+
 	void getValueByLogicId(size_t id, valvec<byte>* val, DbContext*) const;
 	void getValueByPhysicId(size_t id, valvec<byte>* val, DbContext*) const;
+	void combineColgroups(valvec<byte>* val, DbContext*) const;
 
 	void indexSearchExactAppend(size_t mySegIdx, size_t indexId,
 								fstring key, valvec<llong>* recIdvec,
 								DbContext*) const override;
+	void indexSearchExactAppendNoDel(size_t mySegIdx, size_t indexId,
+									 fstring key, valvec<llong>* recIdvec,
+									 DbContext*) const override;
 
 	void selectColumns(llong recId, const size_t* colsId, size_t colsNum,
 					   valvec<byte>* colsData, DbContext*) const override;
@@ -163,6 +180,25 @@ protected:
 							  const bm_uint_t* isDel, const febitvec* isPurged)
 			const;
 
+	// for new segments when schema.m_blockZipBytes > 0, trade compression
+	// ratio for build speed, purge and merge rebuild it by buildStore
+	virtual ReadableStore*
+			buildFastStore(const Schema&, SortableStrVec& storeData)
+			const;
+
+	// decompressed values of expensive colgroups are cached in the global
+	// ValueCache, cheap stores such as FixedLenStore should not be cached
+	virtual bool isValueCacheable(const ReadableStore*) const;
+	void getColgroupValueAppend(size_t colgroupId, size_t physicId,
+								valvec<byte>* val, DbContext*) const;
+	// false if the store has no view or the colgroup is cached
+	bool getColgroupValueView(size_t colgroupId, size_t physicId,
+							  fstring* view, DbContext*) const;
+
+	class TempFileList;
+	void buildFromTempFiles(TempFileList&, llong newRowNum, PathRef tmpDir,
+							const std::string& tabDir, size_t segIdx,
+							const char* traceCat);
 	void completeAndReload(class CompositeTable*, size_t segIdx,
 						   class ReadableSegment* input);
 	void syncUpdateRecordNoLock(size_t dstBaseId, size_t logicId,
@@ -186,6 +222,8 @@ protected:
 	llong  m_dataInflateSize;
 	llong  m_dataMemSize;
 	llong  m_totalStorageSize;
+	uint64_t m_valueCacheId;
+	febitvec m_cachedColgroups; // empty if ValueCache is disabled
 };
 typedef boost::intrusive_ptr<ReadonlySegment> ReadonlySegmentPtr;
 
@@ -285,6 +323,11 @@ public:
 	void pushIsDel(bool val);
 	void popIsDel();
 
+	// m_segMutex must be held as reader, because pushIsDel may remap
+	// m_isDel, concurrent inserters do not block each other by the reader
+	// lock and atomic word ops
+	void atomicSet0IsDel(size_t subId);
+
 	WritableSegment* getWritableSegment() const override;
 
 	llong totalStorageSize() const override;
@@ -312,6 +355,9 @@ public:
 	void indexSearchExactAppend(size_t mySegIdx, size_t indexId,
 								fstring key, valvec<llong>* recIdvec,
 								DbContext*) const override;
+	void indexSearchExactAppendNoDel(size_t mySegIdx, size_t indexId,
+									 fstring key, valvec<llong>* recIdvec,
+									 DbContext*) const override;
 
 	void getCombineAppend(llong recId, valvec<byte>* val, valvec<byte>& wrtBuf, ColumnVec& cols1, ColumnVec& cols2) const;
 
@@ -1,4 +1,8 @@
 #include "db_store.hpp"
+#if !defined(_MSC_VER)
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
 
 namespace terark { namespace db {
 
@@ -87,6 +91,10 @@ UpdatableStore* ReadableStore::getUpdatableStore() {
 	return nullptr;
 }
 
+bool ReadableStore::getValueView(llong, fstring*, DbContext*) const {
+	return false;
+}
+
 void ReadableStore::deleteFiles() {
 	THROW_STD(invalid_argument, "Unsupportted Method");
 }
@@ -137,8 +145,8 @@ namespace {
 		}
 		bool increment(llong* id, valvec<byte>* val) override {
 			if (m_id > 0) {
-				m_store->getValue(m_id, val, m_ctx.get());
 				*id = --m_id;
+				m_store->getValue(m_id, val, m_ctx.get());
 				return true;
 			}
 			return false;
@@ -184,6 +192,40 @@ ReadableStore::ensureStoreIterBackward(DbContext* ctx) const {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+size_t SeqReadAhead::windowSize() {
+	static size_t bytes = []() -> size_t {
+		if (const char* env = getenv("TerarkDB_ReadAheadBytes")) {
+			return (size_t)strtoull(env, NULL, 10);
+		}
+		return size_t(4) << 20;
+	}();
+	return bytes;
+}
+
+SeqReadAhead::SeqReadAhead(const void* base, size_t size) {
+	m_base = (const byte*)base;
+	m_size = size;
+	m_nextPos = 0;
+}
+
+void SeqReadAhead::doAdvise(size_t pos) {
+	const size_t window = windowSize();
+	if (0 == window || pos >= m_size) {
+		m_nextPos = size_t(-1);
+		return;
+	}
+#if !defined(_MSC_VER)
+	static const size_t pageSize = sysconf(_SC_PAGESIZE);
+	size_t beg = size_t(m_base + pos) & ~(pageSize - 1);
+	size_t end = size_t(m_base + std::min(pos + window, m_size));
+	madvise((void*)beg, end - beg, MADV_WILLNEED); // just a hint
+#endif
+	// advise again when half of the window has been read
+	m_nextPos = pos + window / 2;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 AppendableStore::~AppendableStore() {
 }
 
@@ -238,10 +280,32 @@ const {
 	m_parts[upp-1]->getValueAppend(id - baseId, val, ctx);
 }
 
+bool
+MultiPartStore::getValueView(llong id, fstring* view, DbContext* ctx)
+const {
+	assert(m_parts.size() + 1 == m_rowNumVec.size());
+	llong maxId = m_rowNumVec.back();
+	if (id >= maxId) {
+		THROW_STD(out_of_range, "id %lld, maxId = %lld", id, maxId);
+	}
+	size_t upp = upper_bound_a(m_rowNumVec, uint32_t(id));
+	assert(upp < m_rowNumVec.size());
+	llong baseId = m_rowNumVec[upp-1];
+	return m_parts[upp-1]->getValueView(id - baseId, view, ctx);
+}
+
 class MultiPartStore::MyStoreIterForward : public StoreIterator {
 	size_t m_partIdx = 0;
 	llong  m_id = 0;
 	DbContextPtr m_ctx;
+	StoreIteratorPtr m_partIter; // of m_parts[m_partIdx], for sequential read
+	void openPart(size_t partIdx) {
+		auto owner = static_cast<const MultiPartStore*>(m_store.get());
+		if (partIdx != m_partIdx || !m_partIter) {
+			m_partIter = owner->m_parts[partIdx]->ensureStoreIterForward(m_ctx.get());
+			m_partIdx = partIdx;
+		}
+	}
 public:
 	MyStoreIterForward(const MultiPartStore* owner, DbContext* ctx)
 	  : m_ctx(ctx) {
@@ -251,18 +315,21 @@ public:
 		auto owner = static_cast<const MultiPartStore*>(m_store.get());
 		assert(m_partIdx < owner->m_parts.size());
 		if (terark_likely(m_id < owner->m_rowNumVec[m_partIdx + 1])) {
-			// do nothing
+			openPart(m_partIdx);
 		}
 		else if (m_partIdx + 1 < owner->m_parts.size()) {
-			m_partIdx++;
+			openPart(m_partIdx + 1);
 		}
 		else {
 			return false;
 		}
+		llong subId = -1;
+		if (!m_partIter->increment(&subId, val)) {
+			THROW_STD(out_of_range, "part %zd ends at subId %lld"
+				, m_partIdx, m_id - owner->m_rowNumVec[m_partIdx]);
+		}
 		*id = m_id++;
-		llong baseId = owner->m_rowNumVec[m_partIdx];
-		llong subId = *id - baseId;
-		owner->m_parts[m_partIdx]->getValue(subId, val, m_ctx.get());
+		assert(subId == *id - owner->m_rowNumVec[m_partIdx]);
 		return true;
 	}
 	bool seekExact(llong id, valvec<byte>* val) override {
@@ -273,14 +340,17 @@ public:
 		size_t upp = upper_bound_a(owner->m_rowNumVec, id);
 		llong  baseId = owner->m_rowNumVec[upp-1];
 		llong  subId = id - baseId;
-		owner->m_parts[upp-1]->getValue(subId, val, m_ctx.get());
+		openPart(upp-1);
+		if (!m_partIter->seekExact(subId, val)) {
+			THROW_STD(out_of_range, "part %zd, subId %lld", upp-1, subId);
+		}
 		m_id = id+1;
-		m_partIdx = upp-1;
 		return true;
 	}
 	void reset() override {
 		m_partIdx = 0;
 		m_id = 0;
+		m_partIter = nullptr;
 	}
 };
 
@@ -73,6 +73,13 @@ public:
 	virtual llong dataInflateSize() const = 0;
 	virtual llong numDataRows() const = 0;
 	virtual void getValueAppend(llong id, valvec<byte>* val, DbContext*) const = 0;
+
+	// zero copy access: view into memory(mostly mmap) of the store, it is
+	// valid while the store is alive and not updated, segments hold their
+	// stores, so it is pinned by the segment ref.
+	// return false if the store has no plain copy of the value
+	virtual bool getValueView(llong id, fstring* view, DbContext*) const;
+
 	virtual void deleteFiles();
 	virtual StoreIterator* createStoreIterForward(DbContext*) const = 0;
 	virtual StoreIterator* createStoreIterBackward(DbContext*) const = 0;
@@ -86,6 +93,16 @@ public:
 		getValueAppend(id, val, ctx);
 	}
 
+	// view into the store if possible, else the value is copied to buf
+	fstring getValueViewOrCopy(llong id, valvec<byte>* buf, DbContext* ctx) const {
+		fstring view;
+		if (!getValueView(id, &view, ctx)) {
+			getValue(id, buf, ctx);
+			view = fstring(buf->data(), buf->size());
+		}
+		return view;
+	}
+
 	StoreIterator* createDefaultStoreIterForward(DbContext*) const;
 	StoreIterator* createDefaultStoreIterBackward(DbContext*) const;
 
@@ -93,6 +110,69 @@ public:
 	StoreIterator* ensureStoreIterBackward(DbContext*) const;
 };
 
+// Stores decoding fixed length values block by block: each block is decoded
+// once by Store::getValueBatchAppend instead of once per getValueAppend
+template<class Store>
+class BatchStoreIterForward : public StoreIterator {
+	valvec<byte> m_buf; // values of [m_bufBeg, m_bufEnd)
+	llong  m_bufBeg = 0;
+	llong  m_bufEnd = 0;
+	llong  m_id = 0;
+	size_t m_valueBytes = 0;
+	bool fetch(llong id, valvec<byte>* val) {
+		auto owner = static_cast<const Store*>(m_store.get());
+		llong rows = owner->numDataRows();
+		if (id < 0 || id >= rows) {
+			return false;
+		}
+		if (id < m_bufBeg || id >= m_bufEnd) {
+			m_bufBeg = id / Store::BlockSize * Store::BlockSize;
+			m_bufEnd = std::min<llong>(m_bufBeg + Store::BlockSize, rows);
+			m_buf.erase_all();
+			owner->getValueBatchAppend(m_bufBeg, m_bufEnd - m_bufBeg, &m_buf);
+			m_valueBytes = m_buf.size() / (m_bufEnd - m_bufBeg);
+		}
+		val->assign(m_buf.data() + m_valueBytes * (id - m_bufBeg), m_valueBytes);
+		m_id = id + 1;
+		return true;
+	}
+public:
+	explicit BatchStoreIterForward(const Store* owner) {
+		m_store.reset(const_cast<Store*>(owner));
+	}
+	bool increment(llong* id, valvec<byte>* val) override {
+		llong curr = m_id;
+		if (fetch(curr, val)) {
+			*id = curr;
+			return true;
+		}
+		return false;
+	}
+	bool seekExact(llong id, valvec<byte>* val) override {
+		return fetch(id, val);
+	}
+	void reset() override {
+		m_id = 0;
+	}
+};
+
+// madvise(MADV_WILLNEED) a window ahead of sequential reads of mmap'ed data,
+// so full scans read the file ahead instead of faulting page by page.
+// The window size is env TerarkDB_ReadAheadBytes, default 4M
+class TERARK_DB_DLL SeqReadAhead {
+	const byte* m_base;
+	size_t m_size;
+	size_t m_nextPos;
+	void doAdvise(size_t pos);
+public:
+	SeqReadAhead(const void* base, size_t size);
+	void advance(size_t pos) {
+		if (terark_unlikely(pos >= m_nextPos))
+			doAdvise(pos);
+	}
+	static size_t windowSize();
+};
+
 class TERARK_DB_DLL AppendableStore {
 public:
 	virtual ~AppendableStore();
@@ -124,6 +204,7 @@ public:
 	llong dataStorageSize() const override;
 	llong numDataRows() const override;
 	void getValueAppend(llong id, valvec<byte>* val, DbContext*) const override;
+	bool getValueView(llong id, fstring* view, DbContext*) const override;
 	StoreIterator* createStoreIterForward(DbContext*) const override;
 	StoreIterator* createStoreIterBackward(DbContext*) const override;
 
@@ -1,6 +1,9 @@
 #include "db_table.hpp"
 #include "db_segment.hpp"
 #include "appendonly.hpp"
+#include "db_trace.hpp"
+#include "db_query.hpp"
+#include "db_bulk_load.hpp"
 #include <terark/db/fixed_len_store.hpp>
 #include <terark/util/autoclose.hpp>
 #include <terark/util/linebuf.hpp>
@@ -15,6 +18,7 @@
 #include <boost/scope_exit.hpp>
 #include <thread> // for std::this_thread::sleep_for
 #include <tbb/tbb_thread.h>
+#include <tbb/spin_mutex.h>
 #include <terark/util/concurrent_queue.hpp>
 #include <float.h>
 
@@ -285,6 +289,7 @@ void CompositeTable::load(PathRef dir) {
 void CompositeTable::doLoad(PathRef dir) {
 	assert(m_schema.get() != nullptr);
 	m_dir = dir;
+	BulkLoader::removeStaleTempSegments(m_dir);
 	discoverMergeDir(m_dir);
 	fs::path mergeDir = getMergePath(m_dir, m_mergeSeqNum);
 	SortableStrVec segDirList = getWorkingSegDirList(mergeDir);
@@ -755,7 +760,11 @@ CompositeTable::doCreateNewSegmentInLock() {
 	m_rowNumVec.push_back(newMaxRowNum);
 	m_newWrSegNum++;
 	m_segArrayUpdateSeq++;
-	oldwrseg->m_deletedWrIdSet.clear(); // free memory
+	{
+		// DbContext::releaseWrSubIds may push to it concurrently
+		SpinRwLock wsLock(oldwrseg->m_segMutex, true);
+		oldwrseg->m_deletedWrIdSet.clear(); // free memory
+	}
 	// freeze oldwrseg, this may be too slow
 	// auto& oldwrseg = m_segments.ende(2);
 	// oldwrseg->saveIsDel(oldwrseg->m_segDir);
@@ -858,60 +867,66 @@ CompositeTable::insertRowImpl(fstring row, DbContext* ctx, MyRwLock& lock) {
 	return insertRowDoInsert(row, ctx);
 }
 
+// sub ids are reserved in batch for each DbContext, concurrent inserters
+// only need to sync on m_wrSeg->m_segMutex when the reservation ran out
+static const size_t WrSubIdReserveNum = 32;
+
 llong
 CompositeTable::insertRowDoInsert(fstring row, DbContext* ctx) {
 	TransactionGuard txn(ctx->m_transaction.get());
 	llong subId;
 	llong wrBaseId = m_rowNumVec.end()[-2];
 	auto& ws = *m_wrSeg;
-	{
+	assert(ctx->m_wrSegPtr == &ws);
+	if (!ctx->wrSubIdReuse.empty()) {
+		subId = ctx->wrSubIdReuse.pop_val();
+		assert(ws.m_isDel[subId]);
+	}
+	else if (ctx->wrSubIdBeg < ctx->wrSubIdEnd) {
+		subId = ctx->wrSubIdBeg++;
+		assert(ws.m_isDel[subId]);
+	}
+	else {
 		SpinRwLock wsLock(ws.m_segMutex, true);
-		if (ws.m_deletedWrIdSet.empty()) {
+		auto& idset = ws.m_deletedWrIdSet;
+		if (idset.empty()) {
 			subId = (llong)ws.m_isDel.size();
-			ws.pushIsDel(true); // invisible to others
-			ws.m_delcnt++;
-			m_rowNum = m_rowNumVec.back() = wrBaseId + subId + 1;
-			assert(ws.m_isDel.popcnt() == ws.m_delcnt);
+			for (size_t i = 0; i < WrSubIdReserveNum; ++i)
+				ws.pushIsDel(true); // invisible to others
+			ws.m_delcnt += WrSubIdReserveNum;
+			m_rowNum = m_rowNumVec.back() = wrBaseId + ws.m_isDel.size();
+			ctx->wrSubIdBeg = subId + 1;
+			ctx->wrSubIdEnd = (llong)ws.m_isDel.size();
 		}
 		else {
-			subId = ws.m_deletedWrIdSet.pop_val();
+			size_t n = std::min(idset.size(), WrSubIdReserveNum);
+			ctx->wrSubIdReuse.assign(idset.end() - n, n);
+			idset.risk_set_size(idset.size() - n);
+			subId = ctx->wrSubIdReuse.pop_val();
 			assert(ws.m_isDel[subId]);
-			assert(ws.m_isDel.popcnt() == ws.m_delcnt);
 		}
+		ws.m_isDirty = true;
+		assert(ws.m_isDel.popcnt() == ws.m_delcnt);
 	}
 	if (ctx->syncIndex) {
 		if (insertSyncIndex(subId, txn, ctx)) {
 			txn.storeUpsert(subId, row);
-			SpinRwLock wsLock(ws.m_segMutex, true);
+			SpinRwLock wsLock(ws.m_segMutex, false);
+			ws.atomicSet0IsDel(subId);
 			ws.m_isDirty = true;
-			ws.m_isDel.set0(subId);
-			ws.m_delcnt--;
-			assert(ws.m_isDel.popcnt() == ws.m_delcnt);
-		}
-		else {{
-				SpinRwLock wsLock(ws.m_segMutex, true);
-				if (wrBaseId + subId + 1 == m_rowNum) {
-					m_rowNumVec.back()--;
-					m_rowNum--;
-					ws.popIsDel();
-					ws.m_delcnt--;
-					assert(ws.m_isDel.popcnt() == ws.m_delcnt);
-				}
-				else {
-					ws.m_deletedWrIdSet.push_back(subId);
-				}
-			}
+		}
+		else {
+			// subId is still deleted and reserved by ctx, reuse it later
+			ctx->wrSubIdReuse.push_back(uint32_t(subId));
 			txn.rollback();
 			return -1; // fail
 		}
 	}
 	else {
 		ws.update(subId, row, ctx);
-		SpinRwLock wsLock(ws.m_segMutex, true);
+		SpinRwLock wsLock(ws.m_segMutex, false);
+		ws.atomicSet0IsDel(subId);
 		ws.m_isDirty = true;
-		ws.m_isDel.set0(subId);
-		ws.m_delcnt--;
-		assert(ws.m_isDel.popcnt() == ws.m_delcnt);
 	}
 	if (!txn.commit()) {
 		TERARK_THROW(CommitException
@@ -1366,6 +1381,32 @@ CompositeTable::removeRow(llong id, DbContext* ctx) {
 	return true;
 }
 
+// striped row locks for inplace column updating, the table lock is held
+// in read mode, so updating different rows will not block each other
+namespace {
+	struct alignas(64) UpdateColumnStripe {
+		tbb::spin_mutex mutex;
+	};
+	const size_t UpdateColumnStripeNum = 256;
+	UpdateColumnStripe g_updateColumnStripes[UpdateColumnStripeNum];
+
+	class UpdateColumnStripeLock : public tbb::spin_mutex::scoped_lock {
+	public:
+		explicit UpdateColumnStripeLock(llong recordId)
+		  : tbb::spin_mutex::scoped_lock(
+				g_updateColumnStripes[size_t(recordId) % UpdateColumnStripeNum].mutex)
+		{}
+	};
+}
+
+static inline
+void bookUpdateColumn(ReadableSegment* seg, llong subId) {
+	if (seg->m_isFreezed) {
+		SpinRwLock segLock(seg->m_segMutex, true);
+		seg->addtoUpdateList(size_t(subId));
+	}
+}
+
 ///! Can inplace update column in ReadonlySegment
 void
 CompositeTable::updateColumn(llong recordId, size_t columnId,
@@ -1380,9 +1421,11 @@ CompositeTable::updateColumn(llong recordId, size_t columnId,
 			, newColumnData.size()
 			);
 	}
-	memcpy(coldata, newColumnData.data(), newColumnData.size());
-	if (seg->m_isFreezed)
-		seg->addtoUpdateList(subId);
+	{
+		UpdateColumnStripeLock stripeLock(recordId);
+		memcpy(coldata, newColumnData.data(), newColumnData.size());
+	}
+	bookUpdateColumn(seg, subId);
 }
 
 void
@@ -1393,12 +1436,13 @@ CompositeTable::updateColumn(llong recordId, fstring colname,
 		THROW_STD(invalid_argument, "colname = %.*s is not existed"
 			, colname.ilen(), colname.data());
 	}
-	updateColumn(recordId, columnId, newColumnData);
+	updateColumn(recordId, columnId, newColumnData, ctx);
 }
 
 template<class WireType, class LlongOrFloat, class OP>
 static inline
-bool updateValueByOp(byte& byteRef, const OP& op) {
+bool updateValueByOp(byte& byteRef, const OP& op, llong recordId) {
+	UpdateColumnStripeLock stripeLock(recordId);
 	LlongOrFloat val = reinterpret_cast<WireType&>(byteRef);
 	if (op(val)) {
 		reinterpret_cast<WireType&>(byteRef) = val;
@@ -1419,19 +1463,18 @@ CompositeTable::updateColumnInteger(llong recordId, size_t columnId,
 			, columnId, rowSchema.getColumnName(columnId).c_str()
 			, Schema::columnTypeStr(rowSchema.getColumnType(columnId))
 			);
-	case ColumnType::Uint08:  updateValueByOp<uint8_t , llong>(*coldata, op); break;
-	case ColumnType::Sint08:  updateValueByOp< int8_t , llong>(*coldata, op); break;
-	case ColumnType::Uint16:  updateValueByOp<uint16_t, llong>(*coldata, op); break;
-	case ColumnType::Sint16:  updateValueByOp< int16_t, llong>(*coldata, op); break;
-	case ColumnType::Uint32:  updateValueByOp<uint32_t, llong>(*coldata, op); break;
-	case ColumnType::Sint32:  updateValueByOp< int32_t, llong>(*coldata, op); break;
-	case ColumnType::Uint64:  updateValueByOp<uint64_t, llong>(*coldata, op); break;
-	case ColumnType::Sint64:  updateValueByOp< int64_t, llong>(*coldata, op); break;
-	case ColumnType::Float32: updateValueByOp<   float, llong>(*coldata, op); break;
-	case ColumnType::Float64: updateValueByOp<  double, llong>(*coldata, op); break;
+	case ColumnType::Uint08:  updateValueByOp<uint8_t , llong>(*coldata, op, recordId); break;
+	case ColumnType::Sint08:  updateValueByOp< int8_t , llong>(*coldata, op, recordId); break;
+	case ColumnType::Uint16:  updateValueByOp<uint16_t, llong>(*coldata, op, recordId); break;
+	case ColumnType::Sint16:  updateValueByOp< int16_t, llong>(*coldata, op, recordId); break;
+	case ColumnType::Uint32:  updateValueByOp<uint32_t, llong>(*coldata, op, recordId); break;
+	case ColumnType::Sint32:  updateValueByOp< int32_t, llong>(*coldata, op, recordId); break;
+	case ColumnType::Uint64:  updateValueByOp<uint64_t, llong>(*coldata, op, recordId); break;
+	case ColumnType::Sint64:  updateValueByOp< int64_t, llong>(*coldata, op, recordId); break;
+	case ColumnType::Float32: updateValueByOp<   float, llong>(*coldata, op, recordId); break;
+	case ColumnType::Float64: updateValueByOp<  double, llong>(*coldata, op, recordId); break;
 	}
-	if (seg->m_isFreezed)
-		seg->addtoUpdateList(subId);
+	bookUpdateColumn(seg, subId);
 }
 
 void
@@ -1443,7 +1486,7 @@ CompositeTable::updateColumnInteger(llong recordId, fstring colname,
 		THROW_STD(invalid_argument, "colname = %.*s is not existed"
 			, colname.ilen(), colname.data());
 	}
-	updateColumnInteger(recordId, colname, op);
+	updateColumnInteger(recordId, columnId, op, ctx);
 }
 
 void
@@ -1458,19 +1501,18 @@ CompositeTable::updateColumnDouble(llong recordId, size_t columnId,
 			, columnId, rowSchema.getColumnName(columnId).c_str()
 			, Schema::columnTypeStr(rowSchema.getColumnType(columnId))
 			);
-	case ColumnType::Uint08:  updateValueByOp<uint08_t, double>(*coldata, op); break;
-	case ColumnType::Sint08:  updateValueByOp< int08_t, double>(*coldata, op); break;
-	case ColumnType::Uint16:  updateValueByOp<uint16_t, double>(*coldata, op); break;
-	case ColumnType::Sint16:  updateValueByOp< int16_t, double>(*coldata, op); break;
-	case ColumnType::Uint32:  updateValueByOp<uint32_t, double>(*coldata, op); break;
-	case ColumnType::Sint32:  updateValueByOp< int32_t, double>(*coldata, op); break;
-	case ColumnType::Uint64:  updateValueByOp<uint64_t, double>(*coldata, op); break;
-	case ColumnType::Sint64:  updateValueByOp< int64_t, double>(*coldata, op); break;
-	case ColumnType::Float32: updateValueByOp<   float, double>(*coldata, op); break;
-	case ColumnType::Float64: updateValueByOp<  double, double>(*coldata, op); break;
+	case ColumnType::Uint08:  updateValueByOp<uint08_t, double>(*coldata, op, recordId); break;
+	case ColumnType::Sint08:  updateValueByOp< int08_t, double>(*coldata, op, recordId); break;
+	case ColumnType::Uint16:  updateValueByOp<uint16_t, double>(*coldata, op, recordId); break;
+	case ColumnType::Sint16:  updateValueByOp< int16_t, double>(*coldata, op, recordId); break;
+	case ColumnType::Uint32:  updateValueByOp<uint32_t, double>(*coldata, op, recordId); break;
+	case ColumnType::Sint32:  updateValueByOp< int32_t, double>(*coldata, op, recordId); break;
+	case ColumnType::Uint64:  updateValueByOp<uint64_t, double>(*coldata, op, recordId); break;
+	case ColumnType::Sint64:  updateValueByOp< int64_t, double>(*coldata, op, recordId); break;
+	case ColumnType::Float32: updateValueByOp<   float, double>(*coldata, op, recordId); break;
+	case ColumnType::Float64: updateValueByOp<  double, double>(*coldata, op, recordId); break;
 	}
-	if (seg->m_isFreezed)
-		seg->addtoUpdateList(subId);
+	bookUpdateColumn(seg, subId);
 }
 
 void
@@ -1482,7 +1524,16 @@ CompositeTable::updateColumnDouble(llong recordId, fstring colname,
 		THROW_STD(invalid_argument, "colname = %.*s is not existed"
 			, colname.ilen(), colname.data());
 	}
-	updateColumnDouble(recordId, colname, op);
+	updateColumnDouble(recordId, columnId, op, ctx);
+}
+
+// same protocol as updateValueByOp: all in place writers of a cell hold
+// the stripe lock of the row, else concurrent updates may be lost
+template<class Num, class IncType>
+static inline
+void incrementLocked(byte* coldata, IncType incVal, llong recordId) {
+	UpdateColumnStripeLock stripeLock(recordId);
+	*(Num*)coldata += incVal;
 }
 
 void
@@ -1497,18 +1548,17 @@ CompositeTable::incrementColumnValue(llong recordId, size_t columnId,
 			, Schema::columnTypeStr(rowSchema.getColumnType(columnId))
 			);
 	case ColumnType::Uint08:
-	case ColumnType::Sint08: *(int8_t*)coldata += incVal; break;
+	case ColumnType::Sint08: incrementLocked<int8_t >(coldata, incVal, recordId); break;
 	case ColumnType::Uint16:
-	case ColumnType::Sint16: *(int16_t*)coldata += incVal; break;
+	case ColumnType::Sint16: incrementLocked<int16_t>(coldata, incVal, recordId); break;
 	case ColumnType::Uint32:
-	case ColumnType::Sint32: *(int32_t*)coldata += incVal; break;
+	case ColumnType::Sint32: incrementLocked<int32_t>(coldata, incVal, recordId); break;
 	case ColumnType::Uint64:
-	case ColumnType::Sint64: *(int64_t*)coldata += incVal; break;
-	case ColumnType::Float32: *(float *)coldata += incVal; break;
-	case ColumnType::Float64: *(double*)coldata += incVal; break;
+	case ColumnType::Sint64: incrementLocked<int64_t>(coldata, incVal, recordId); break;
+	case ColumnType::Float32: incrementLocked<float >(coldata, incVal, recordId); break;
+	case ColumnType::Float64: incrementLocked<double>(coldata, incVal, recordId); break;
 	}
-	if (seg->m_isFreezed)
-		seg->addtoUpdateList(subId);
+	bookUpdateColumn(seg, subId);
 }
 
 void
@@ -1519,7 +1569,7 @@ CompositeTable::incrementColumnValue(llong recordId, fstring colname,
 		THROW_STD(invalid_argument, "colname = %.*s is not existed"
 			, colname.ilen(), colname.data());
 	}
-	incrementColumnValue(recordId, colname, incVal);
+	incrementColumnValue(recordId, columnId, incVal, ctx);
 }
 
 void
@@ -1534,18 +1584,17 @@ CompositeTable::incrementColumnValue(llong recordId, size_t columnId,
 			, Schema::columnTypeStr(rowSchema.getColumnType(columnId))
 			);
 	case ColumnType::Uint08:
-	case ColumnType::Sint08: *(int8_t*)coldata += incVal; break;
+	case ColumnType::Sint08: incrementLocked<int8_t >(coldata, incVal, recordId); break;
 	case ColumnType::Uint16:
-	case ColumnType::Sint16: *(int16_t*)coldata += incVal; break;
+	case ColumnType::Sint16: incrementLocked<int16_t>(coldata, incVal, recordId); break;
 	case ColumnType::Uint32:
-	case ColumnType::Sint32: *(int32_t*)coldata += incVal; break;
+	case ColumnType::Sint32: incrementLocked<int32_t>(coldata, incVal, recordId); break;
 	case ColumnType::Uint64:
-	case ColumnType::Sint64: *(int64_t*)coldata += incVal; break;
-	case ColumnType::Float32: *(float *)coldata += incVal; break;
-	case ColumnType::Float64: *(double*)coldata += incVal; break;
+	case ColumnType::Sint64: incrementLocked<int64_t>(coldata, incVal, recordId); break;
+	case ColumnType::Float32: incrementLocked<float >(coldata, incVal, recordId); break;
+	case ColumnType::Float64: incrementLocked<double>(coldata, incVal, recordId); break;
 	}
-	if (seg->m_isFreezed)
-		seg->addtoUpdateList(subId);
+	bookUpdateColumn(seg, subId);
 }
 
 void
@@ -1556,7 +1605,7 @@ CompositeTable::incrementColumnValue(llong recordId, fstring colname,
 		THROW_STD(invalid_argument, "colname = %.*s is not existed"
 			, colname.ilen(), colname.data());
 	}
-	incrementColumnValue(recordId, colname, incVal);
+	incrementColumnValue(recordId, columnId, incVal, ctx);
 }
 
 bool
@@ -1620,6 +1669,26 @@ const {
 //	std::reverse(recIdvec->begin(), recIdvec->end()); // make descending
 }
 
+void
+CompositeTable::indexQuery(const IndexQuery& q, valvec<llong>* recIdvec, DbContext* ctx)
+const {
+	ctx->trySyncSegCtxSpeculativeLock(this);
+	indexQueryNoLock(q, recIdvec, ctx);
+}
+
+void
+CompositeTable::indexQueryNoLock(const IndexQuery& q, valvec<llong>* recIdvec, DbContext* ctx)
+const {
+	recIdvec->erase_all();
+	size_t segNum = ctx->m_segCtx.size();
+	for (size_t i = 0; i < segNum; ++i) {
+		auto seg = ctx->m_segCtx[i]->seg;
+		if (seg->m_isDel.size() == seg->m_delcnt)
+			continue;
+		q.searchSegment(seg, i, ctx->m_rowNumVec[i], recIdvec, ctx);
+	}
+}
+
 // implemented in DfaDbTable
 ///@params recIdvec result of matched record id list
 bool
@@ -1637,6 +1706,124 @@ const {
 	THROW_STD(invalid_argument, "Methed is not implemented");
 }
 
+// generic implementation by TableIndexIter, recIdvec is in key order
+size_t
+CompositeTable::indexSearchPrefix(size_t indexId, fstring prefix, size_t limit,
+								  valvec<llong>* recIdvec, DbContext* ctx)
+const {
+	if (indexId >= m_schema->getIndexNum()) {
+		THROW_STD(invalid_argument
+			, "invalid indexId=%zd is not less than indexNum=%zd"
+			, indexId, m_schema->getIndexNum());
+	}
+	const Schema& schema = m_schema->getIndexSchema(indexId);
+	if (!schema.m_isOrdered) {
+		THROW_STD(invalid_argument, "index: %s is not ordered",
+			schema.m_name.c_str());
+	}
+	recIdvec->erase_all();
+	if (0 == limit)
+		return 0;
+	IndexIteratorPtr iter = createIndexIterForward(indexId);
+	valvec<byte>& key = ctx->key2;
+	llong recId = -1;
+	if (iter->seekLowerBound(prefix, &recId, &key) >= 0) {
+		while (fstring(key).startsWith(prefix)) {
+			recIdvec->push_back(recId);
+			if (recIdvec->size() >= limit || !iter->increment(&recId, &key))
+				break;
+		}
+	}
+	return recIdvec->size();
+}
+
+llong
+CompositeTable::estimateRange(size_t indexId, fstring lo, fstring hi, DbContext* ctx)
+const {
+	if (indexId >= m_schema->getIndexNum()) {
+		THROW_STD(invalid_argument
+			, "invalid indexId=%zd is not less than indexNum=%zd"
+			, indexId, m_schema->getIndexNum());
+	}
+	const Schema& schema = m_schema->getIndexSchema(indexId);
+	if (!schema.m_isOrdered) {
+		THROW_STD(invalid_argument, "index: %s is not ordered",
+			schema.m_name.c_str());
+	}
+	ctx->trySyncSegCtxSpeculativeLock(this);
+	double est = 0;
+	double sampleHits = 0, sampleRows = 0; // for segments without histogram
+	valvec<size_t> noHistSegs;
+	size_t segNum = ctx->m_segCtx.size();
+	for (size_t i = 0; i < segNum; ++i) {
+		auto seg = ctx->m_segCtx[i]->seg;
+		if (seg->m_isDel.size() == seg->m_delcnt)
+			continue;
+		if (indexId < seg->m_histograms.size() && seg->m_histograms[indexId]) {
+			const IndexHistogram& hist = *seg->m_histograms[indexId];
+			if (0 == hist.m_rows)
+				continue;
+			double hits = hist.estimateRange(schema, lo, hi);
+			double live = double(seg->m_isDel.size() - seg->m_delcnt);
+			est += hits * live / hist.m_rows; // deleted rows are uniformly distributed
+			sampleHits += hits;
+			sampleRows += hist.m_rows;
+		}
+		else {
+			noHistSegs.push_back(i);
+		}
+	}
+	for (size_t i : noHistSegs) {
+		auto seg = ctx->m_segCtx[i]->seg;
+		double live = double(seg->m_isDel.size() - seg->m_delcnt);
+		if (sampleRows > 0) {
+			est += live * sampleHits / sampleRows;
+			continue;
+		}
+		// no histogram at all, count keys by the segment's index
+		IndexIterator* iter = ctx->getIndexIterNoLock(i, indexId);
+		valvec<byte>& key = ctx->key2;
+		llong recId = -1;
+		llong cnt = 0;
+		bool hasNext = lo.empty()
+			? (iter->reset(), iter->increment(&recId, &key))
+			: iter->seekLowerBound(lo, &recId, &key) >= 0;
+		while (hasNext && (hi.empty() || schema.compareData(key, hi) < 0)) {
+			cnt++;
+			hasNext = iter->increment(&recId, &key);
+		}
+		est += cnt;
+	}
+	return llong(est + 0.5);
+}
+
+llong
+CompositeTable::indexCountPrefix(size_t indexId, fstring prefix, DbContext* ctx)
+const {
+	if (indexId >= m_schema->getIndexNum()) {
+		THROW_STD(invalid_argument
+			, "invalid indexId=%zd is not less than indexNum=%zd"
+			, indexId, m_schema->getIndexNum());
+	}
+	const Schema& schema = m_schema->getIndexSchema(indexId);
+	if (!schema.m_isOrdered) {
+		THROW_STD(invalid_argument, "index: %s is not ordered",
+			schema.m_name.c_str());
+	}
+	IndexIteratorPtr iter = createIndexIterForward(indexId);
+	valvec<byte>& key = ctx->key2;
+	llong recId = -1;
+	llong cnt = 0;
+	if (iter->seekLowerBound(prefix, &recId, &key) >= 0) {
+		while (fstring(key).startsWith(prefix)) {
+			cnt++;
+			if (!iter->increment(&recId, &key))
+				break;
+		}
+	}
+	return cnt;
+}
+
 bool
 CompositeTable::indexInsert(size_t indexId, fstring indexKey, llong id,
 							DbContext* txn)
@@ -1769,6 +1956,7 @@ class TableIndexIter : public IndexIterator {
 		ReadableSegmentPtr seg;
 		IndexIteratorPtr   iter;
 		valvec<byte>       data;
+		valvec<byte>       normKey; // encoded data, used if m_useNormKey
 		llong              subId = -1;
 		llong              baseId;
 	};
@@ -1784,10 +1972,32 @@ class TableIndexIter : public IndexIterator {
 			}
 			if (ykey.empty())
 				return false; // xkey > ykey
-			int r = schema->compareData(xkey, ykey);
+			int r;
+			if (m_useNormKey) {
+				const auto& xnorm = m_segs[x].normKey;
+				const auto& ynorm = m_segs[y].normKey;
+				r = memcmp(xnorm.data(), ynorm.data(), std::min(xnorm.size(), ynorm.size()));
+				if (0 == r)
+					r = int(xnorm.size() > ynorm.size()) - int(xnorm.size() < ynorm.size());
+			}
+			else {
+				r = schema->compareData(xkey, ykey);
+			}
 			if (r) return r < 0;
 			else   return x < y;
 	}
+	// heap compares are memcmp of norm keys, encoding a key is about the
+	// cost of a compareData, thus it pays off if the heap is not tiny
+	void setUseNormKey() {
+		const Schema& schema = m_tab->m_schema->getIndexSchema(m_indexId);
+		m_useNormKey = schema.m_canEncodeNormKey && m_segs.size() >= 4;
+	}
+	void syncNormKey(OneSeg& cur) {
+		if (m_useNormKey) {
+			const Schema& schema = m_tab->m_schema->getIndexSchema(m_indexId);
+			schema.encodeNormKey(cur.data, &cur.normKey);
+		}
+	}
 	bool lessThan(const Schema* schema, size_t x, size_t y) {
 		if (m_forward)
 			return lessThanImp(schema, x, y);
@@ -1813,6 +2023,33 @@ class TableIndexIter : public IndexIterator {
 	size_t m_oldnewWrSegNum;
 	const bool m_forward;
 	bool m_isHeapBuilt;
+	bool m_useNormKey;
+
+	///@{ covering scan: output key is projected columns from index key
+	valvec<size_t> m_coverCols; // column id in index schema
+	ColumnVec      m_keyCols;
+	valvec<byte>   m_projBuf;
+	///@}
+
+	void outputKey(valvec<byte>* key) {
+		if (m_coverCols.empty()) {
+			key->swap(m_keyBuf);
+			return;
+		}
+		const Schema& schema = m_tab->m_schema->getIndexSchema(m_indexId);
+		schema.parseRow(m_keyBuf, &m_keyCols);
+		m_projBuf.erase_all();
+		size_t colsNum = m_coverCols.size();
+		for (size_t i = 0; i < colsNum; ++i) {
+			size_t subColumnId = m_coverCols[i];
+			fstring d = m_keyCols[subColumnId];
+			if (i < colsNum-1)
+				schema.projectToNorm(d, subColumnId, &m_projBuf);
+			else
+				schema.projectToLast(d, subColumnId, &m_projBuf);
+		}
+		key->swap(m_projBuf);
+	}
 
 	IndexIterator* createIter(const ReadableSegment& seg) {
 		auto index = seg.m_indices[m_indexId];
@@ -1851,12 +2088,15 @@ class TableIndexIter : public IndexIterator {
 	}
 
 public:
-	TableIndexIter(const CompositeTable* tab, size_t indexId, bool forward)
+	TableIndexIter(const CompositeTable* tab, size_t indexId, bool forward,
+				   const valvec<size_t>* coverCols = nullptr)
 	  : m_tab(const_cast<CompositeTable*>(tab))
 	  , m_ctx(tab->createDbContext())
 	  , m_indexId(indexId)
 	  , m_forward(forward)
 	{
+		if (coverCols)
+			m_coverCols = *coverCols;
 		assert(tab->m_schema->getIndexSchema(indexId).m_isOrdered);
 		m_isUniqueInSchema = tab->m_schema->getIndexSchema(indexId).m_isUnique;
 		{
@@ -1866,6 +2106,7 @@ public:
 		m_oldmergeSeqNum = size_t(-1);
 		m_oldnewWrSegNum = size_t(-1);
 		m_isHeapBuilt = false;
+		m_useNormKey = false;
 	}
 	~TableIndexIter() {
 		MyRwLock lock(m_tab->m_rwMutex);
@@ -1889,11 +2130,13 @@ public:
 			}
 			m_heap.erase_all();
 			m_heap.reserve(m_segs.size());
+			setUseNormKey();
 			for (size_t i = 0; i < m_segs.size(); ++i) {
 				auto& cur = m_segs[i];
 				if (cur.iter->increment(&cur.subId, &cur.data)) {
 					m_heap.push_back(i);
 					cur.subId = cur.seg->getLogicId(cur.subId);
+					syncNormKey(cur);
 				}
 			}
 			std::make_heap(m_heap.begin(), m_heap.end(), HeapKeyCompare(this));
@@ -1908,7 +2151,7 @@ public:
 				*id = baseId + subId;
 				assert(*id < m_tab->numDataRows());
 				if (key)
-					key->swap(m_keyBuf);
+					outputKey(key);
 				return true;
 			}
 		}
@@ -1923,6 +2166,7 @@ public:
 		m_keyBuf.swap(cur.data); // should be assign, but swap is more efficient
 		if (cur.iter->increment(&cur.subId, &cur.data)) {
 			assert(m_heap.back() == segIdx);
+			syncNormKey(cur);
 			std::push_heap(m_heap.begin(), m_heap.end(), HeapKeyCompare(this));
 			cur.subId = cur.seg->getLogicId(cur.subId);
 		}
@@ -1973,12 +2217,14 @@ public:
 		}
 		m_heap.erase_all();
 		m_heap.reserve(m_segs.size());
+		setUseNormKey();
 		for(size_t i = 0; i < m_segs.size(); ++i) {
 			auto& cur = m_segs[i];
 			int ret = cur.iter->seekLowerBound(key, &cur.subId, &cur.data);
 			if (ret >= 0) {
 				m_heap.push_back(i);
 				cur.subId = cur.seg->getLogicId(cur.subId);
+				syncNormKey(cur);
 			}
 		}
 		m_isHeapBuilt = true;
@@ -2008,7 +2254,7 @@ public:
 				#endif
 					int ret = (key == m_keyBuf) ? 0 : 1;
 					if (retKey)
-						retKey->swap(m_keyBuf);
+						outputKey(retKey);
 					return ret;
 				}
 			}
@@ -2045,6 +2291,40 @@ IndexIteratorPtr CompositeTable::createIndexIterBackward(fstring indexCols) cons
 	return createIndexIterBackward(indexId);
 }
 
+bool
+CompositeTable::isIndexCovering(size_t indexId,
+								const size_t* colsId, size_t colsNum,
+								valvec<size_t>* subColumnIds) const {
+	assert(indexId < m_schema->getIndexNum());
+	const Schema& schema = m_schema->getIndexSchema(indexId);
+	const valvec<size_t>& proj = schema.getProj();
+	if (subColumnIds)
+		subColumnIds->erase_all();
+	for (size_t i = 0; i < colsNum; ++i) {
+		size_t j = 0;
+		while (j < proj.size() && proj[j] != colsId[i]) ++j;
+		if (j == proj.size())
+			return false;
+		if (subColumnIds)
+			subColumnIds->push_back(j);
+	}
+	return colsNum > 0;
+}
+
+IndexIteratorPtr
+CompositeTable::createCoveringIndexIter(size_t indexId,
+										const valvec<size_t>& colsId,
+										bool forward) const {
+	assert(indexId < m_schema->getIndexNum());
+	assert(m_schema->getIndexSchema(indexId).m_isOrdered);
+	valvec<size_t> subColumnIds;
+	if (!isIndexCovering(indexId, colsId.data(), colsId.size(), &subColumnIds)) {
+		THROW_STD(invalid_argument, "index: %s does not cover the columns",
+			m_schema->getIndexSchema(indexId).m_name.c_str());
+	}
+	return new TableIndexIter(this, indexId, forward, &subColumnIds);
+}
+
 template<class T>
 static
 valvec<size_t>
@@ -2229,9 +2509,20 @@ struct SegEntry {
 		newNumPurged = 0;
 	}
 	bool needsRePurge() const { return newNumPurged != oldNumPurged; }
+	bool hasStoreFiles(const std::string& prefix, fstring dotExt) const;
 	void reuseOldStoreFiles(PathRef destSegDir, const std::string& prefix, size_t& newPartIdx);
 };
 
+bool
+SegEntry::hasStoreFiles(const std::string& prefix, fstring dotExt) const {
+	size_t j = files.lower_bound(prefix);
+	for (; j < files.size() && files[j].startsWith(prefix); ++j) {
+		if (files[j].endsWith(dotExt))
+			return true;
+	}
+	return false;
+}
+
 void
 SegEntry::reuseOldStoreFiles(PathRef destSegDir, const std::string& prefix, size_t& newPartIdx) {
 	PathRef srcSegDir = seg->m_segDir;
@@ -2463,17 +2754,17 @@ mergeIndex(ReadonlySegment* dseg, size_t indexId, DbContext* ctx) {
 		for (size_t logicId = 0; logicId < logicRows; ++logicId) {
 			if (!oldpurgeBits || !terark_bit_test(oldpurgeBits, logicId)) {
 				if (!newpurgeBits || !terark_bit_test(newpurgeBits, logicId)) {
-					indexStore->getValue(physicId, &rec, ctx);
+					fstring key = indexStore->getValueViewOrCopy(physicId, &rec, ctx);
 					if (fixedIndexRowLen) {
-						assert(rec.size() == fixedIndexRowLen);
-						strVec.m_strpool.append(rec);
+						assert(key.size() == fixedIndexRowLen);
+						strVec.m_strpool.append(key.udata(), key.size());
 					} else {
-						strVec.push_back(rec);
+						strVec.push_back(key);
 						if (seqStore)
-							seqStore->append(rec, ctx);
+							seqStore->append(key, ctx);
 					}
 #if !defined(NDEBUG)
-					key2id[rec].push_back(baseLogicId + logicId);
+					key2id[key].push_back(baseLogicId + logicId);
 #endif
 				}
 				physicId++;
@@ -2720,12 +3011,12 @@ mergeAndPurgeColgroup(ReadonlySegment* dseg, size_t colgroupId) {
 		for (size_t logicId = 0; logicId < logicRows; ++logicId) {
 			if (!segOldpurgeBits || !terark_bit_test(segOldpurgeBits, logicId)) {
 				if (!segNewpurgeBits || !terark_bit_test(segNewpurgeBits, logicId)) {
-					store->getValue(physicId, &rec, m_ctx.get());
+					fstring val = store->getValueViewOrCopy(physicId, &rec, m_ctx.get());
 					if (fixedIndexRowLen) {
-						assert(rec.size() == fixedIndexRowLen);
-						strVec.m_strpool.append(rec);
+						assert(val.size() == fixedIndexRowLen);
+						strVec.m_strpool.append(val.udata(), val.size());
 					} else {
-						strVec.push_back(rec);
+						strVec.push_back(val);
 					}
 				}
 				physicId++;
@@ -2795,6 +3086,12 @@ void CompositeTable::merge(MergeParam& toMerge) {
 	std::string segPathList = toMerge.joinPathList();
 	fprintf(stderr, "INFO: merge segments:\n%sTo\t%s ...\n"
 		, segPathList.c_str(), destSegDir.string().c_str());
+	BgTaskTraceScope mergeTrace("merge", "merge", m_dir.string(), toMerge[0].idx);
+	if (BgTaskTracer::isEnabled()) {
+		llong bytesIn = 0;
+		for (auto& e : toMerge) bytesIn += e.seg->totalStorageSize();
+		mergeTrace.setBytesIn(bytesIn);
+	}
 #if defined(NDEBUG)
 try{
 #endif
@@ -2837,11 +3134,15 @@ try{
 		dseg->m_isPurged.build_cache(true, false);
 		assert(dseg->m_isPurged.size() == toMerge.m_newSegRows);
 	}
+  {
+	BgTaskTraceScope trace("merge", "buildIndex", m_dir.string(), toMerge[0].idx);
 	for (size_t i = 0; i < indexNum; ++i) {
 		ReadableIndex* index = toMerge.mergeIndex(dseg.get(), i, ctx.get());
 		dseg->m_indices[i] = index;
 		dseg->m_colgroups[i] = index->getReadableStore();
 	}
+	dseg->buildHistograms();
+  }
 	for (auto& e : toMerge) {
 		for(auto fpath : fs::directory_iterator(e.seg->m_segDir)) {
 			e.files.push_back(fpath.path().filename().string());
@@ -2849,6 +3150,8 @@ try{
 		e.files.sort();
 		assert(e.seg->m_bookUpdates);
 	}
+  {
+	BgTaskTraceScope trace("merge", "buildStore", m_dir.string(), toMerge[0].idx);
 	for (size_t i = indexNum; i < colgroupNum; ++i) {
 		const Schema& schema = m_schema->getColgroupSchema(i);
 		if (schema.should_use_FixedLenStore()) {
@@ -2862,6 +3165,16 @@ try{
 		}
 		const std::string prefix = "colgroup-" + schema.m_name;
 		size_t newPartIdx = 0;
+		auto rebuildStore = [&](SegEntry& e, febitvec& isPurged) {
+			auto tmpDir1 = destSegDir / "temp-store";
+			fs::create_directory(tmpDir1);
+			dseg->m_isDel.swap(isPurged);
+			auto store = dseg->purgeColgroup(i, e.seg, ctx.get(), tmpDir1);
+			dseg->m_isDel.swap(isPurged);
+			store->save(tmpDir1 / prefix);
+			moveStoreFiles(tmpDir1, destSegDir, prefix, newPartIdx);
+			fs::remove_all(tmpDir1);
+		};
 		for (auto& e : toMerge) {
 			if (e.needsRePurge()) {
 				assert(e.newIsPurged.size() >= 1);
@@ -2870,25 +3183,30 @@ try{
 					// new store is empty, all records are purged
 					continue;
 				}
-				auto tmpDir1 = destSegDir / "temp-store";
-				fs::create_directory(tmpDir1);
-				dseg->m_isDel.swap(e.newIsPurged);
-				auto store = dseg->purgeColgroup(i, e.seg, ctx.get(), tmpDir1);
-				dseg->m_isDel.swap(e.newIsPurged);
-				store->save(tmpDir1 / prefix);
-				moveStoreFiles(tmpDir1, destSegDir, prefix, newPartIdx);
-				fs::remove_all(tmpDir1);
+				rebuildStore(e, e.newIsPurged);
 			} else {
 				if (e.seg->m_isPurged.max_rank1() == e.seg->m_isDel.size()) {
 					// old store is empty, all records are purged
 					continue;
 				}
-				e.reuseOldStoreFiles(destSegDir, prefix, newPartIdx);
+				if (e.hasStoreFiles(prefix, ".zblk")) {
+					// BlockZipStore is fast built for new segments,
+					// recompress it as normal store
+					febitvec isPurged(e.seg->m_isDel.size(), false);
+					if (!e.seg->m_isPurged.empty())
+						isPurged = e.seg->m_isPurged;
+					rebuildStore(e, isPurged);
+				}
+				else {
+					e.reuseOldStoreFiles(destSegDir, prefix, newPartIdx);
+				}
 			}
 			newPartIdx++;
 		}
 	}
-
+  }
+  {
+	BgTaskTraceScope trace("merge", "completeAndReload", m_dir.string(), toMerge[0].idx);
 	if (toMerge.needsPurgeBits() || dseg->m_isDel.empty()) {
 		if (dseg->m_isPurged.max_rank1() == dseg->m_isPurged.size()) {
 			ReadableStorePtr store = new EmptyIndexStore();
@@ -2910,10 +3228,12 @@ try{
 	dseg->load(destSegDir);
 //	assert(dseg->m_isDel.size() == dseg->m_isPurged.size());
 	assert(dseg->m_isDel.size() == toMerge.m_newSegRows);
+  }
 
 	// m_isMerging is true, m_segments will never be changed
 	// so lock is not needed
 	assert(m_isMerging);
+	BgTaskTraceScope renameTrace("merge", "rename", m_dir.string(), toMerge[0].idx);
 	assert(m_segments.size() == toMerge.m_tabSegNum);
 	if (m_segments.size() != toMerge.m_tabSegNum) {
 		THROW_STD(logic_error
@@ -3104,6 +3424,7 @@ try{
 	for (auto& tobeDel : toMerge) {
 		tobeDel.seg->deleteSegment();
 	}
+	mergeTrace.setBytesOut(dseg->totalStorageSize());
 	fprintf(stderr, "INFO: merge segments:\n%sTo\t%s done!\n"
 		, segPathList.c_str(), destSegDir.string().c_str());
 #if defined(NDEBUG)
@@ -3204,6 +3525,96 @@ void CompositeTable::syncFinishWriting() {
 	waitForBackgroundTasks(m_rwMutex, m_bgTaskNum);
 }
 
+///@param segs are built by BulkLoader in temporary dirs
+///@note  the writable segment must be empty, new segments are placed
+///       before it, so no existing record id is changed
+void CompositeTable::attachBulkSegments(const valvec<ReadonlySegmentPtr>& segs) {
+	if (segs.empty())
+		return;
+	for (size_t retryNum = 0; ; retryNum++) {
+	  {
+		MyRwLock lock(m_rwMutex, true);
+		if (nullptr == m_wrSeg) {
+			THROW_STD(invalid_argument, "table writing was finished: %s"
+				, m_dir.string().c_str());
+		}
+		if (m_wrSeg->m_isDel.size() > 0) {
+			THROW_STD(invalid_argument
+				, "writable segment is not empty, rows = %zd: %s"
+				, m_wrSeg->m_isDel.size(), m_wrSeg->m_segDir.string().c_str());
+		}
+		assert(m_segments.back() == m_wrSeg);
+		size_t wrIdx = m_segments.size() - 1;
+		if (wrIdx + segs.size() + 1 > m_segments.capacity()) {
+			THROW_STD(invalid_argument,
+				"Reaching maxSegNum=%d", int(m_segments.capacity()));
+		}
+		bool busy = m_isMerging || PurgeStatus::none != m_purgeStatus;
+		for (size_t i = 0; i < wrIdx && !busy; ++i) {
+			// wait for frozen segments being compressed
+			busy = nullptr != m_segments[i]->getWritableStore();
+		}
+		if (!busy) {
+			// all or nothing: renames are rolled back on failure, the table
+			// state is changed only after all fallible steps succeeded
+			valvec<fs::path> oldDirs;
+			WritableSegmentPtr newWrSeg;
+			try {
+				for (size_t i = 0; i < segs.size(); ++i) {
+					auto segDir = getSegPath("rd", wrIdx + i);
+					fprintf(stderr, "INFO: rename(%s, %s)\n"
+						, segs[i]->m_segDir.string().c_str()
+						, segDir.string().c_str());
+					fs::rename(segs[i]->m_segDir, segDir);
+					oldDirs.push_back(segs[i]->m_segDir);
+					segs[i]->m_segDir = segDir;
+				}
+				newWrSeg = myCreateWritableSegment(getSegPath("wr", wrIdx + segs.size()));
+			}
+			catch (const std::exception& ex) {
+				fprintf(stderr, "ERROR: attachBulkSegments: %s, rollback\n", ex.what());
+				for (size_t i = oldDirs.size(); i-- > 0; ) {
+					boost::system::error_code ec;
+					fs::rename(segs[i]->m_segDir, oldDirs[i], ec);
+					if (ec) {
+						fprintf(stderr, "ERROR: rollback rename(%s, %s): %s\n"
+							, segs[i]->m_segDir.string().c_str()
+							, oldDirs[i].string().c_str(), ec.message().c_str());
+					}
+					else {
+						segs[i]->m_segDir = oldDirs[i];
+					}
+				}
+				throw;
+			}
+			m_wrSeg->deleteSegment();
+			m_segments.pop_back();
+			m_rowNumVec.pop_back();
+			llong rows = m_rowNumVec.back();
+			for (auto& seg : segs) {
+				rows += seg->m_isDel.size();
+				m_segments.push_back(seg.get());
+				m_rowNumVec.push_back(rows);
+			}
+			m_wrSeg = newWrSeg;
+			m_segments.push_back(m_wrSeg);
+			m_rowNumVec.push_back(rows);
+			m_rowNum = rows;
+			m_newWrSegNum++;
+			m_segArrayUpdateSeq++;
+			DebugCheckRowNumVecNoLock(this);
+			return;
+		}
+	  }
+		if (retryNum % 100 == 0) {
+			fprintf(stderr
+				, "INFO: attachBulkSegments: wait for background tasks, retry = %zd\n"
+				, retryNum);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+}
+
 void CompositeTable::asyncPurgeDelete() {
 	MyRwLock lock(m_rwMutex, true);
 	asyncPurgeDeleteInLock();
@@ -3298,8 +3709,14 @@ void CompositeTable::convWritableSegmentToReadonly(size_t segIdx) {
   {
 	auto segDir = getSegPath("rd", segIdx);
 	fprintf(stderr, "INFO: convWritableSegmentToReadonly: %s\n", segDir.string().c_str());
+	BgTaskTraceScope trace("compress", "convWrToRd", m_dir.string(), segIdx);
+	if (BgTaskTracer::isEnabled()) {
+		MyRwLock lock(m_rwMutex, false);
+		trace.setBytesIn(m_segments[segIdx]->totalStorageSize());
+	}
 	ReadonlySegmentPtr newSeg = myCreateReadonlySegment(segDir);
 	newSeg->convFrom(this, segIdx);
+	trace.setBytesOut(newSeg->totalStorageSize());
 	fprintf(stderr, "INFO: convWritableSegmentToReadonly: %s done!\n", segDir.string().c_str());
 	fs::path wrSegPath = getSegPath("wr", segIdx);
 	try {
@@ -3348,9 +3765,11 @@ void CompositeTable::freezeFlushWritableSegment(size_t segIdx) {
 		return;
 	}
 	fprintf(stderr, "freezeFlushWritableSegment: %s\n", seg->m_segDir.string().c_str());
+	BgTaskTraceScope trace("flush", "freezeFlush", m_dir.string(), segIdx);
 	seg->saveIndices(seg->m_segDir);
 	seg->saveRecordStore(seg->m_segDir);
 	seg->saveIsDel(seg->m_segDir);
+	trace.setBytesOut(seg->totalStorageSize());
 	fprintf(stderr, "freezeFlushWritableSegment: %s done!\n", seg->m_segDir.string().c_str());
 }
 
@@ -3384,8 +3803,11 @@ void CompositeTable::runPurgeDelete() {
 		if (size_t(-1) == segIdx) {
 			break;
 		}
+		BgTaskTraceScope trace("purge", "purgeDelete", m_dir.string(), segIdx);
+		trace.setBytesIn(srcSeg->totalStorageSize());
 		ReadonlySegmentPtr dest = myCreateReadonlySegment(srcSeg->m_segDir);
 		dest->purgeDeletedRecords(this, segIdx);
+		trace.setBytesOut(dest->totalStorageSize());
 	}
 }
 
@@ -3458,6 +3880,7 @@ public:
 		fprintf(stderr, "INFO: compression threads(%zd) completed!\n", this->size());
 		this->clear();
 		g_compressQueue.clearQueue();
+		BgTaskTracer::saveJsonOnEnv();
 	}
 };
 tbb::tbb_thread g_flushThread(&FlushThreadFunc);
@@ -22,8 +22,10 @@ typedef MyRwMutex::scoped_lock MyRwLock;
 class TERARK_DB_DLL ReadableSegment;
 class TERARK_DB_DLL ReadonlySegment;
 class TERARK_DB_DLL WritableSegment;
+class TERARK_DB_DLL IndexQuery;
 typedef boost::intrusive_ptr<ReadableSegment> ReadableSegmentPtr;
 typedef boost::intrusive_ptr<WritableSegment> WritableSegmentPtr;
+typedef boost::intrusive_ptr<ReadonlySegment> ReadonlySegmentPtr;
 
 // is not a WritableStore
 class TERARK_DB_DLL CompositeTable : public ReadableStore {
@@ -116,9 +118,26 @@ public:
 	void indexSearchExactNoLock(size_t indexId, fstring key, valvec<llong>* recIdvec, DbContext*) const;
 	bool indexKeyExistsNoLock(size_t indexId, fstring key, DbContext*) const;
 
+	///@{ returned recIdvec is sorted by recId ascending
+	void indexQuery(const IndexQuery&, valvec<llong>* recIdvec, DbContext*) const;
+	void indexQueryNoLock(const IndexQuery&, valvec<llong>* recIdvec, DbContext*) const;
+	///@}
+
 	virtual	bool indexMatchRegex(size_t indexId, BaseDFA* regexDFA, valvec<llong>* recIdvec, DbContext*) const;
 	virtual	bool indexMatchRegex(size_t indexId, fstring  regexStr, fstring regexOptions, valvec<llong>* recIdvec, DbContext*) const;
 
+	///@{ index key prefix search, the prefix is a byte prefix of index key
+	///@returns number of ids in recIdvec, at most limit
+	virtual	size_t indexSearchPrefix(size_t indexId, fstring prefix, size_t limit, valvec<llong>* recIdvec, DbContext*) const;
+	virtual	llong  indexCountPrefix(size_t indexId, fstring prefix, DbContext*) const;
+	///@}
+
+	///@{ estimated number of rows with index key in [lo, hi),
+	/// empty lo is min key, empty hi is max key
+	/// by histograms of readonly segments, O(#segments * log(buckets))
+	llong estimateRange(size_t indexId, fstring lo, fstring hi, DbContext*) const;
+	///@}
+
 	bool indexInsert(size_t indexId, fstring indexKey, llong id, DbContext*);
 	bool indexRemove(size_t indexId, fstring indexKey, llong id, DbContext*);
 	bool indexReplace(size_t indexId, fstring indexKey, llong oldId, llong newId, DbContext*);
@@ -131,6 +150,16 @@ public:
 	IndexIteratorPtr createIndexIterBackward(size_t indexId) const;
 	IndexIteratorPtr createIndexIterBackward(fstring indexCols) const;
 
+	///@{ covering index scan
+	/// when colsId are all in the index schema, the iterator's output key
+	/// is the projected columns decoded from the index key, in the same
+	/// format as selectColumns, so the row store need not to be fetched
+	bool isIndexCovering(size_t indexId, const size_t* colsId, size_t colsNum,
+						 valvec<size_t>* subColumnIds = nullptr) const;
+	IndexIteratorPtr createCoveringIndexIter(size_t indexId,
+						const valvec<size_t>& colsId, bool forward = true) const;
+	///@}
+
 	valvec<size_t> getProjectColumns(const hash_strmap<>& colnames) const;
 
 	void selectColumns(llong id, const valvec<size_t>& cols,
@@ -214,6 +243,7 @@ protected:
 
 	class MergeParam; friend class MergeParam;
 	void merge(MergeParam&);
+	void attachBulkSegments(const valvec<ReadonlySegmentPtr>&);
 	void checkRowNumVecNoLock() const;
 
 	bool maybeCreateNewSegment(MyRwLock&);
@@ -279,6 +309,8 @@ protected:
 	friend class TableIndexIterBackward;
 	friend class DbContext;
 	friend class ReadonlySegment;
+	friend class BulkLoader;
+	friend class ArrowExporter;
 };
 typedef boost::intrusive_ptr<CompositeTable> CompositeTablePtr;
 
@@ -359,6 +391,26 @@ inline bool
 DbContext::indexKeyExistsNoLock(size_t indexId, fstring key) {
 	return m_tab->indexKeyExistsNoLock(indexId, key, this);
 }
+inline void
+DbContext::indexQuery(const IndexQuery& q, valvec<llong>* recIdvec) {
+	m_tab->indexQuery(q, recIdvec, this);
+}
+inline void
+DbContext::indexQueryNoLock(const IndexQuery& q, valvec<llong>* recIdvec) {
+	m_tab->indexQueryNoLock(q, recIdvec, this);
+}
+inline size_t
+DbContext::indexSearchPrefix(size_t indexId, fstring prefix, size_t limit, valvec<llong>* recIdvec) {
+	return m_tab->indexSearchPrefix(indexId, prefix, limit, recIdvec, this);
+}
+inline llong
+DbContext::indexCountPrefix(size_t indexId, fstring prefix) {
+	return m_tab->indexCountPrefix(indexId, prefix, this);
+}
+inline llong
+DbContext::estimateRange(size_t indexId, fstring lo, fstring hi) {
+	return m_tab->estimateRange(indexId, lo, hi, this);
+}
 inline bool
 DbContext::indexMatchRegex(size_t indexId, BaseDFA* regexDFA, valvec<llong>* recIdvec) {
 	return m_tab->indexMatchRegex(indexId, regexDFA, recIdvec, this);
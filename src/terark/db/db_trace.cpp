@@ -0,0 +1,205 @@
+#include "db_trace.hpp"
+#include <terark/io/FileStream.hpp>
+#include <terark/util/profiling.hpp>
+#include <tbb/spin_mutex.h>
+#include <atomic>
+#include <vector>
+#include "json.hpp"
+
+namespace terark { namespace db {
+
+namespace {
+
+struct TraceEvent {
+	const char* cat;
+	const char* name;
+	std::string table;
+	size_t   segIdx;
+	llong    beginTime; // nanoseconds
+	llong    endTime;
+	llong    bytesIn;
+	llong    bytesOut;
+	unsigned tid;
+};
+
+class TraceRingBuffer {
+public:
+	tbb::spin_mutex     m_mutex;
+	std::vector<TraceEvent> m_events; // TraceEvent is not memmovable
+	size_t              m_capacity;
+	size_t              m_head; // oldest event when m_events is full
+	std::atomic_bool    m_enabled;
+	profiling           m_pf;
+	llong               m_startTime;
+
+	TraceRingBuffer() {
+		m_capacity = 0;
+		m_head = 0;
+		m_enabled = false;
+		m_startTime = m_pf.now();
+		if (const char* env = getenv("TerarkDB_BgTaskTraceNum")) {
+			size_t cap = (size_t)strtoull(env, NULL, 10);
+			if (cap)
+				enable(cap);
+		}
+		else if (getenv("TerarkDB_BgTaskTraceFile")) {
+			enable(4096);
+		}
+	}
+	void enable(size_t cap) {
+		tbb::spin_mutex::scoped_lock lock(m_mutex);
+		m_events.clear();
+		m_events.reserve(cap);
+		m_capacity = cap;
+		m_head = 0;
+		m_enabled = cap > 0;
+	}
+	void push(TraceEvent&& ev) {
+		tbb::spin_mutex::scoped_lock lock(m_mutex);
+		if (!m_enabled) {
+			return;
+		}
+		if (m_events.size() < m_capacity) {
+			m_events.push_back(std::move(ev));
+		}
+		else {
+			m_events[m_head] = std::move(ev);
+			m_head = (m_head + 1) % m_events.size();
+		}
+	}
+};
+
+TraceRingBuffer& traceBuf() {
+	static TraceRingBuffer instance;
+	return instance;
+}
+
+unsigned currentThreadTraceId() {
+	static std::atomic<unsigned> s_seq(0);
+	static thread_local unsigned tid = ++s_seq;
+	return tid;
+}
+
+} // namespace
+
+bool BgTaskTracer::isEnabled() {
+	return traceBuf().m_enabled;
+}
+
+void BgTaskTracer::enable(size_t capacity) {
+	traceBuf().enable(capacity);
+}
+
+void BgTaskTracer::disable() {
+	traceBuf().m_enabled = false;
+}
+
+void BgTaskTracer::clear() {
+	auto& tb = traceBuf();
+	tbb::spin_mutex::scoped_lock lock(tb.m_mutex);
+	tb.m_events.clear();
+	tb.m_head = 0;
+}
+
+llong BgTaskTracer::now() {
+	return traceBuf().m_pf.now();
+}
+
+void BgTaskTracer::addEvent(const char* cat, const char* name,
+							const std::string& table, size_t segIdx,
+							llong beginTime, llong endTime,
+							llong bytesIn, llong bytesOut) {
+	auto& tb = traceBuf();
+	if (!tb.m_enabled) {
+		return;
+	}
+	TraceEvent ev;
+	ev.cat = cat;
+	ev.name = name;
+	ev.table = table;
+	ev.segIdx = segIdx;
+	ev.beginTime = beginTime;
+	ev.endTime = endTime;
+	ev.bytesIn = bytesIn;
+	ev.bytesOut = bytesOut;
+	ev.tid = currentThreadTraceId();
+	tb.push(std::move(ev));
+}
+
+std::string BgTaskTracer::toJson() {
+	auto& tb = traceBuf();
+	terark::json events = json::array();
+	tbb::spin_mutex::scoped_lock lock(tb.m_mutex);
+	size_t num = tb.m_events.size();
+	for (size_t i = 0; i < num; ++i) {
+		const TraceEvent& ev = tb.m_events[(tb.m_head + i) % num];
+		terark::json js;
+		js["cat"] = ev.cat;
+		js["name"] = ev.name;
+		js["ph"] = "X";
+		js["pid"] = 0;
+		js["tid"] = ev.tid;
+		js["ts"] = tb.m_pf.uf(tb.m_startTime, ev.beginTime);
+		js["dur"] = tb.m_pf.uf(ev.beginTime, ev.endTime);
+		auto& args = js["args"];
+		args["table"] = ev.table;
+		if (size_t(-1) != ev.segIdx)
+			args["segIdx"] = ev.segIdx;
+		if (ev.bytesIn)
+			args["bytesIn"] = ev.bytesIn;
+		if (ev.bytesOut)
+			args["bytesOut"] = ev.bytesOut;
+		events.push_back(std::move(js));
+	}
+	lock.release();
+	terark::json top;
+	top["traceEvents"] = std::move(events);
+	top["displayTimeUnit"] = "ms";
+	return top.dump();
+}
+
+void BgTaskTracer::saveJson(const std::string& fpath) {
+	std::string js = toJson();
+	FileStream fp(fpath.c_str(), "w");
+	fp.ensureWrite(js.data(), js.size());
+}
+
+void BgTaskTracer::saveJsonOnEnv() {
+	if (const char* fpath = getenv("TerarkDB_BgTaskTraceFile")) {
+		try {
+			saveJson(fpath);
+			fprintf(stderr, "INFO: saved background task trace to: %s\n", fpath);
+		}
+		catch (const std::exception& ex) {
+			fprintf(stderr
+				, "ERROR: save background task trace to: %s, ex.what = %s\n"
+				, fpath, ex.what());
+		}
+	}
+}
+
+BgTaskTraceScope::BgTaskTraceScope(const char* cat, const char* name,
+								   const std::string& table, size_t segIdx) {
+	m_cat = cat;
+	m_segIdx = segIdx;
+	m_bytesIn = 0;
+	m_bytesOut = 0;
+	if (BgTaskTracer::isEnabled()) {
+		m_name = name;
+		m_table = table;
+		m_beginTime = BgTaskTracer::now();
+	}
+	else {
+		m_name = NULL;
+		m_beginTime = 0;
+	}
+}
+
+BgTaskTraceScope::~BgTaskTraceScope() {
+	if (m_name) {
+		BgTaskTracer::addEvent(m_cat, m_name, m_table, m_segIdx,
+			m_beginTime, BgTaskTracer::now(), m_bytesIn, m_bytesOut);
+	}
+}
+
+} } // namespace terark::db
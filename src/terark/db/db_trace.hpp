@@ -0,0 +1,58 @@
+#ifndef __terark_db_db_trace_hpp__
+#define __terark_db_db_trace_hpp__
+
+#include "db_conf.hpp"
+#include <string>
+
+namespace terark { namespace db {
+
+// Tracer for background tasks(flush, compress, purge, merge), events are
+// kept in a ring buffer and can be dumped as Chrome trace-event json, which
+// can be viewed by chrome://tracing
+//
+// It is disabled by default, enabled by:
+//   env TerarkDB_BgTaskTraceNum=<ring buffer capacity>
+//   env TerarkDB_BgTaskTraceFile=<json file>, auto saved when bg threads stop
+// or by calling BgTaskTracer::enable(capacity)
+class TERARK_DB_DLL BgTaskTracer {
+public:
+	static bool isEnabled();
+	static void enable(size_t capacity);
+	static void disable();
+	static void clear();
+
+	static void addEvent(const char* cat, const char* name,
+						 const std::string& table, size_t segIdx,
+						 llong beginTime, llong endTime,
+						 llong bytesIn, llong bytesOut);
+	static llong now();
+
+	static std::string toJson();
+	static void saveJson(const std::string& fpath);
+
+	///@{ save to env TerarkDB_BgTaskTraceFile if it is set
+	static void saveJsonOnEnv();
+	///@}
+};
+
+// Record a complete event("ph":"X") when destructed
+class TERARK_DB_DLL BgTaskTraceScope {
+	TERARK_DB_NON_COPYABLE_CLASS(BgTaskTraceScope);
+	const char* m_cat;
+	const char* m_name; // NULL indicate tracer is disabled
+	std::string m_table;
+	size_t m_segIdx;
+	llong  m_beginTime;
+	llong  m_bytesIn;
+	llong  m_bytesOut;
+public:
+	BgTaskTraceScope(const char* cat, const char* name,
+					 const std::string& table, size_t segIdx);
+	~BgTaskTraceScope();
+	void setBytesIn (llong bytes) { m_bytesIn  = bytes; }
+	void setBytesOut(llong bytes) { m_bytesOut = bytes; }
+};
+
+} } // namespace terark::db
+
+#endif // __terark_db_db_trace_hpp__
@@ -0,0 +1,325 @@
+#include "block_zip_store.hpp"
+#include <terark/io/FileStream.hpp>
+#include <terark/io/DataIO.hpp>
+#include <terark/util/mmap.hpp>
+#include <atomic>
+
+#if defined(_MSC_VER)
+#	pragma comment(lib, "zlibwapi.lib")
+#endif
+#define ZLIB_WINAPI
+#include <zlib.h>
+
+namespace terark { namespace db { namespace dfadb {
+
+static std::atomic<uint64_t> g_blockZipStoreSeq(0);
+
+BlockZipStore::BlockZipStore(const Schema& schema) {
+	m_mmapBase = nullptr;
+	m_mmapSize = 0;
+	m_uniqId = ++g_blockZipStoreSeq;
+}
+BlockZipStore::~BlockZipStore() {
+	if (m_mmapBase) {
+		m_rowOffsets.risk_release_ownership();
+		m_blockRows.risk_release_ownership();
+		m_blockOffsets.risk_release_ownership();
+		m_dict.risk_release_ownership();
+		m_zipData.risk_release_ownership();
+		mmap_close(m_mmapBase, m_mmapSize);
+	}
+}
+
+llong BlockZipStore::dataStorageSize() const {
+	return m_rowOffsets.mem_size()
+		 + m_blockRows.mem_size()
+		 + m_blockOffsets.mem_size()
+		 + m_dict.used_mem_size()
+		 + m_zipData.used_mem_size();
+}
+
+llong BlockZipStore::dataInflateSize() const {
+	return m_rowOffsets.size() ? m_rowOffsets.get(m_rowOffsets.size() - 1) : 0;
+}
+
+llong BlockZipStore::numDataRows() const {
+	return m_rowOffsets.size() ? m_rowOffsets.size() - 1 : 0;
+}
+
+size_t BlockZipStore::findBlock(size_t id) const {
+	size_t lo = 0, hi = numBlocks();
+	while (lo < hi) { // upper_bound
+		size_t mid = (lo + hi) / 2;
+		if (m_blockRows.get(mid) <= id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	assert(lo > 0);
+	return lo - 1;
+}
+
+struct BlockZipStore::Unzipper {
+	z_stream zs;
+	valvec<byte> buf;
+	uint64_t storeId;
+	size_t   blockIdx;
+	Unzipper() {
+		memset(&zs, 0, sizeof(zs));
+		if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+			THROW_STD(runtime_error, "inflateInit2 failed");
+		}
+		storeId = 0;
+		blockIdx = size_t(-1);
+	}
+	~Unzipper() {
+		inflateEnd(&zs);
+	}
+};
+
+const byte*
+BlockZipStore::unzipBlock(size_t blockIdx, Unzipper* uz) const {
+	if (uz->storeId == m_uniqId && uz->blockIdx == blockIdx) {
+		return uz->buf.data();
+	}
+	const size_t rawBeg = m_rowOffsets.get(m_blockRows.get(blockIdx));
+	const size_t rawEnd = m_rowOffsets.get(m_blockRows.get(blockIdx + 1));
+	const size_t zipBeg = m_blockOffsets.get(blockIdx);
+	const size_t zipEnd = m_blockOffsets.get(blockIdx + 1);
+	uz->buf.resize_no_init(rawEnd - rawBeg);
+	if (rawEnd == rawBeg) {
+		return uz->buf.data(); // all rows are empty
+	}
+	uz->storeId = 0; // invalidate cache on error
+	inflateReset(&uz->zs);
+	if (!m_dict.empty()) {
+		inflateSetDictionary(&uz->zs, m_dict.data(), uInt(m_dict.size()));
+	}
+	uz->zs.next_in = (Bytef*)m_zipData.data() + zipBeg;
+	uz->zs.avail_in = uInt(zipEnd - zipBeg);
+	uz->zs.next_out = uz->buf.data();
+	uz->zs.avail_out = uInt(uz->buf.size());
+	int err = inflate(&uz->zs, Z_FINISH);
+	if (Z_STREAM_END != err || uz->zs.avail_out != 0) {
+		THROW_STD(runtime_error, "inflate block %zd failed, err = %d", blockIdx, err);
+	}
+	uz->storeId = m_uniqId;
+	uz->blockIdx = blockIdx;
+	return uz->buf.data();
+}
+
+void BlockZipStore::getValueAppend(llong id, valvec<byte>* val, DbContext*) const {
+	assert(id >= 0);
+	assert(id < numDataRows());
+	// one unzipped block per thread, sequential reads of a block just
+	// unzip it once
+	static thread_local Unzipper tlsUnzipper;
+	size_t blockIdx = findBlock(size_t(id));
+	size_t blockBeg = m_rowOffsets.get(m_blockRows.get(blockIdx));
+	size_t beg = m_rowOffsets.get(size_t(id));
+	size_t end = m_rowOffsets.get(size_t(id) + 1);
+	const byte* block = unzipBlock(blockIdx, &tlsUnzipper);
+	val->append(block + (beg - blockBeg), end - beg);
+}
+
+// has its own Unzipper, so scanning multiple BlockZipStore colgroups
+// together does not thrash the per thread block of getValueAppend
+class BlockZipStore::MyStoreIterForward : public StoreIterator {
+	llong  m_id = 0;
+	size_t m_blockIdx = 0;
+	size_t m_blockBegRow = 0;
+	size_t m_blockEndRow = 0; // empty range: no block is unzipped
+	size_t m_blockBegOffset = 0;
+	const byte*  m_block = nullptr;
+	Unzipper     m_unzipper;
+	SeqReadAhead m_readAhead;
+	bool fetch(llong id, valvec<byte>* val) {
+		auto owner = static_cast<const BlockZipStore*>(m_store.get());
+		if (id < 0 || id >= owner->numDataRows()) {
+			return false;
+		}
+		if (size_t(id) < m_blockBegRow || size_t(id) >= m_blockEndRow) {
+			m_blockIdx = owner->findBlock(size_t(id));
+			m_blockBegRow = owner->m_blockRows.get(m_blockIdx);
+			m_blockEndRow = owner->m_blockRows.get(m_blockIdx + 1);
+			m_blockBegOffset = owner->m_rowOffsets.get(m_blockBegRow);
+			m_readAhead.advance(owner->m_blockOffsets.get(m_blockIdx));
+			m_block = owner->unzipBlock(m_blockIdx, &m_unzipper);
+		}
+		size_t beg = owner->m_rowOffsets.get(size_t(id));
+		size_t end = owner->m_rowOffsets.get(size_t(id) + 1);
+		val->assign(m_block + (beg - m_blockBegOffset), end - beg);
+		m_id = id + 1;
+		return true;
+	}
+public:
+	explicit MyStoreIterForward(const BlockZipStore* owner)
+	  : m_readAhead(owner->m_zipData.data(), owner->m_zipData.size()) {
+		m_store.reset(const_cast<BlockZipStore*>(owner));
+	}
+	bool increment(llong* id, valvec<byte>* val) override {
+		llong curr = m_id;
+		if (fetch(curr, val)) {
+			*id = curr;
+			return true;
+		}
+		return false;
+	}
+	bool seekExact(llong id, valvec<byte>* val) override {
+		return fetch(id, val);
+	}
+	void reset() override {
+		m_id = 0;
+	}
+};
+
+StoreIterator* BlockZipStore::createStoreIterForward(DbContext*) const {
+	return new MyStoreIterForward(this);
+}
+
+StoreIterator* BlockZipStore::createStoreIterBackward(DbContext*) const {
+	return nullptr; // not needed
+}
+
+void BlockZipStore::build(const Schema& schema, SortableStrVec& strVec) {
+	const size_t fixlen = schema.getFixedRowLen();
+	const bool   hasIndex = strVec.m_index.size() != 0;
+	const size_t rows = hasIndex ? strVec.m_index.size()
+					  : fixlen ? strVec.m_strpool.size() / fixlen : 0;
+	auto getRow = [&](size_t i) {
+		return hasIndex ? strVec[i]
+			: fstring(strVec.m_strpool.data() + fixlen * i, fixlen);
+	};
+	const size_t rawBytes = strVec.str_size();
+	const size_t blockBytes = std::max(schema.m_blockZipBytes, 1024);
+	// sample rows evenly as preset dictionary, deflate window is 32K
+	const size_t maxDict = size_t(1) << MAX_WBITS;
+	m_dict.erase_all();
+	if (rawBytes > blockBytes) {
+		size_t step = std::max<size_t>(1, rows / std::max<size_t>(1, rows * maxDict / rawBytes));
+		for (size_t i = 0; i < rows && m_dict.size() < maxDict; i += step) {
+			fstring row = getRow(i);
+			m_dict.append(row.data(), std::min(row.size(), maxDict - m_dict.size()));
+		}
+	}
+	valvec<size_t> rowOffsets(rows + 1, valvec_no_init());
+	valvec<size_t> blockRows;
+	valvec<size_t> blockOffsets;
+	valvec<byte> raw;
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	int err = deflateInit2(&zs, schema.m_blockZipLevel, Z_DEFLATED,
+						   -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+	if (Z_OK != err) {
+		THROW_STD(runtime_error, "deflateInit2 failed, err = %d", err);
+	}
+	m_zipData.erase_all();
+	auto zipBlock = [&]() {
+		deflateReset(&zs);
+		if (!m_dict.empty()) {
+			deflateSetDictionary(&zs, m_dict.data(), uInt(m_dict.size()));
+		}
+		size_t oldsize = m_zipData.size();
+		m_zipData.resize_no_init(oldsize + deflateBound(&zs, uLong(raw.size())));
+		zs.next_in = raw.data();
+		zs.avail_in = uInt(raw.size());
+		zs.next_out = m_zipData.data() + oldsize;
+		zs.avail_out = uInt(m_zipData.size() - oldsize);
+		err = deflate(&zs, Z_FINISH);
+		if (Z_STREAM_END != err) {
+			deflateEnd(&zs);
+			THROW_STD(runtime_error, "deflate failed, err = %d", err);
+		}
+		m_zipData.risk_set_size(m_zipData.size() - zs.avail_out);
+		raw.erase_all();
+	};
+	size_t offset = 0;
+	bool inBlock = false;
+	for (size_t i = 0; i < rows; ++i) {
+		if (!inBlock) {
+			blockRows.push_back(i);
+			blockOffsets.push_back(m_zipData.size());
+			inBlock = true;
+		}
+		fstring row = getRow(i);
+		rowOffsets[i] = offset;
+		raw.append(row.data(), row.size());
+		offset += row.size();
+		if (raw.size() >= blockBytes) {
+			zipBlock();
+			inBlock = false;
+		}
+	}
+	if (inBlock)
+		zipBlock();
+	deflateEnd(&zs);
+	rowOffsets[rows] = offset;
+	blockRows.push_back(rows);
+	blockOffsets.push_back(m_zipData.size());
+	m_zipData.shrink_to_fit();
+	m_rowOffsets.build_from(rowOffsets);
+	m_blockRows.build_from(blockRows);
+	m_blockOffsets.build_from(blockOffsets);
+}
+
+namespace {
+	struct BlockZipStoreHeader {
+		uint64_t rows;
+		uint64_t blockNum;
+		uint64_t dictBytes;
+		uint64_t zipBytes;
+		uint8_t  rowOffsetBits;
+		uint8_t  blockRowBits;
+		uint8_t  blockOffsetBits;
+		uint8_t  padding1;
+		uint32_t padding2;
+		uint64_t padding3;
+	};
+	BOOST_STATIC_ASSERT(sizeof(BlockZipStoreHeader) == 48);
+}
+
+TERARK_DB_REGISTER_STORE("zblk", BlockZipStore);
+
+void BlockZipStore::load(PathRef fpath) {
+	assert(fstring(fpath.string()).endsWith(".zblk"));
+	m_mmapBase = (byte_t*)mmap_load(fpath.string(), &m_mmapSize);
+	auto header = (const BlockZipStoreHeader*)m_mmapBase;
+	byte* data = (byte*)(header + 1);
+	m_rowOffsets.risk_set_data(data, header->rows + 1, header->rowOffsetBits);
+	data += m_rowOffsets.mem_size();
+	m_blockRows.risk_set_data(data, header->blockNum + 1, header->blockRowBits);
+	data += m_blockRows.mem_size();
+	m_blockOffsets.risk_set_data(data, header->blockNum + 1, header->blockOffsetBits);
+	data += m_blockOffsets.mem_size();
+	if (data + header->dictBytes + header->zipBytes > m_mmapBase + m_mmapSize) {
+		THROW_STD(invalid_argument, "path=%s, broken data: fileSize=%zd"
+			, fpath.string().c_str(), m_mmapSize);
+	}
+	m_dict.risk_set_data(data, header->dictBytes);
+	m_zipData.risk_set_data(data + header->dictBytes, header->zipBytes);
+}
+
+void BlockZipStore::save(PathRef path) const {
+	auto fpath = path + ".zblk";
+	NativeDataOutput<FileStream> dio;
+	dio.open(fpath.string().c_str(), "wb");
+	BlockZipStoreHeader header;
+	header.rows = numDataRows();
+	header.blockNum = numBlocks();
+	header.dictBytes = m_dict.size();
+	header.zipBytes = m_zipData.size();
+	header.rowOffsetBits = byte(m_rowOffsets.uintbits());
+	header.blockRowBits = byte(m_blockRows.uintbits());
+	header.blockOffsetBits = byte(m_blockOffsets.uintbits());
+	header.padding1 = 0;
+	header.padding2 = 0;
+	header.padding3 = 0;
+	dio.ensureWrite(&header, sizeof(header));
+	dio.ensureWrite(m_rowOffsets.data(), m_rowOffsets.mem_size());
+	dio.ensureWrite(m_blockRows.data(), m_blockRows.mem_size());
+	dio.ensureWrite(m_blockOffsets.data(), m_blockOffsets.mem_size());
+	dio.ensureWrite(m_dict.data(), m_dict.used_mem_size());
+	dio.ensureWrite(m_zipData.data(), m_zipData.used_mem_size());
+}
+
+}}} // namespace terark::db::dfadb
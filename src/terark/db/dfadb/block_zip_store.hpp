@@ -0,0 +1,49 @@
+#pragma once
+
+#include <terark/db/db_store.hpp>
+#include <terark/int_vector.hpp>
+#include <terark/util/sortable_strvec.hpp>
+
+namespace terark { namespace db { namespace dfadb {
+
+// Fast build store: rows are grouped into blocks of about blockZipBytes,
+// each block is deflated independently with a shared preset dictionary
+// sampled from the rows. Build speed is close to memcpy at low levels,
+// compression ratio is much lower than NestLoudsTrieStore, so it is just
+// for new segments, purge and merge rebuild it as a normal store.
+class TERARK_DB_DLL BlockZipStore : public ReadableStore {
+	class MyStoreIterForward; friend class MyStoreIterForward;
+public:
+	explicit BlockZipStore(const Schema& schema);
+	~BlockZipStore();
+
+	llong dataStorageSize() const override;
+	llong dataInflateSize() const override;
+	llong numDataRows() const override;
+	void getValueAppend(llong id, valvec<byte>* val, DbContext*) const override;
+	StoreIterator* createStoreIterForward(DbContext*) const override;
+	StoreIterator* createStoreIterBackward(DbContext*) const override;
+
+	void build(const Schema&, SortableStrVec& strVec);
+	void load(PathRef path) override;
+	void save(PathRef path) const override;
+
+	size_t numBlocks() const { return m_blockRows.size() - 1; }
+
+protected:
+	UintVecMin0  m_rowOffsets;   // rows + 1, offsets of unzipped data
+	UintVecMin0  m_blockRows;    // numBlocks + 1, first row of blocks
+	UintVecMin0  m_blockOffsets; // numBlocks + 1, offsets of m_zipData
+	valvec<byte> m_dict;
+	valvec<byte> m_zipData;
+	byte_t*      m_mmapBase;
+	size_t       m_mmapSize;
+	uint64_t     m_uniqId; // for the per thread unzipped block cache
+
+	struct Unzipper;
+	size_t findBlock(size_t id) const;
+	// returned data is valid until next call with the same Unzipper
+	const byte* unzipBlock(size_t blockIdx, Unzipper*) const;
+};
+
+}}} // namespace terark::db::dfadb
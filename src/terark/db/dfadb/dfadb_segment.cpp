@@ -1,6 +1,7 @@
 #include "dfadb_segment.hpp"
 #include "nlt_index.hpp"
 #include "nlt_store.hpp"
+#include "block_zip_store.hpp"
 
 namespace terark { namespace db { namespace dfadb {
 
@@ -77,5 +78,31 @@ const {
 	return nlt.release();
 }
 
+ReadableStore*
+DfaDbReadonlySegment::buildFastStore(const Schema& schema, SortableStrVec& storeData)
+const {
+	// integer/float/low cardinality stores are fast to build
+	ReadableStore* store = ReadonlySegment::buildStore(schema, storeData);
+	if (store) {
+		return store;
+	}
+	std::unique_ptr<BlockZipStore> zblk(new BlockZipStore(schema));
+	zblk->build(schema, storeData);
+	return zblk.release();
+}
+
+bool DfaDbReadonlySegment::isValueCacheable(const ReadableStore* store) const {
+	if (auto mp = dynamic_cast<const MultiPartStore*>(store)) {
+		for (size_t i = 0; i < mp->numParts(); ++i) {
+			if (isValueCacheable(mp->getPart(i)))
+				return true;
+		}
+		return false;
+	}
+	// dictZip/NestLoudsTrie and deflated blocks are expensive to unzip
+	return dynamic_cast<const NestLoudsTrieStore*>(store) != nullptr
+		|| dynamic_cast<const BlockZipStore*>(store) != nullptr;
+}
+
 
 }}} // namespace terark::db::dfadb
@@ -20,6 +20,8 @@ protected:
 	ReadableStore*
 	buildDictZipStore(const Schema&, PathRef dir, StoreIterator&iter,
 		const bm_uint_t* isDel, const febitvec* isPurged) const override;
+	ReadableStore* buildFastStore(const Schema&, SortableStrVec& storeData) const override;
+	bool isValueCacheable(const ReadableStore*) const override;
 };
 
 }}} // namespace terark::db::dfadb
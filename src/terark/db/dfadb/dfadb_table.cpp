@@ -10,7 +10,15 @@
 #include <terark/db/mock_db_engine.hpp>
 #include <terark/db/wiredtiger/wt_db_segment.hpp>
 #include <terark/db/dfadb/nlt_index.hpp>
+#include <terark/util/sortable_strvec.hpp>
 #include <boost/filesystem.hpp>
+#include <tbb/tbb_thread.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <tbb/task_arena.h>
+#include <condition_variable>
+#include <mutex>
+#include <algorithm>
 
 namespace terark { namespace db { namespace dfadb {
 
@@ -77,9 +85,121 @@ public:
 #include <terark/fsa/ppi/match_path.hpp>
 };
 
+// match regexDFA on one readonly segment, append global ids
+static void
+matchRegexOneSeg(const ReadableSegment* seg, llong baseId, size_t indexId,
+				 const Schema& schema, BaseDFA* regexDFA, size_t memLimit,
+				 valvec<llong>* recIdvec) {
+	auto index = dynamic_cast<const NestLoudsTrieIndex*>(&*seg->m_indices[indexId]);
+	if (!index) {
+		THROW_STD(logic_error, "MatchRegex must be run on NestLoudsTrieIndex\n");
+	}
+	size_t oldsize = recIdvec->size();
+	if (index->matchRegexAppend(regexDFA, recIdvec, memLimit)) {
+		size_t i = oldsize;
+		for(size_t j = oldsize; j < recIdvec->size(); ++j) {
+			size_t subPhysicId = (*recIdvec)[j];
+			size_t subLogicId = seg->getLogicId(subPhysicId);
+			if (!seg->m_isDel[subLogicId])
+				(*recIdvec)[i++] = baseId + subLogicId;
+		}
+		recIdvec->risk_set_size(i);
+	}
+	else if (schema.m_enableLinearScan) {
+		fprintf(stderr
+			, "WARN: RegexMatch exceeded memory limit(%zd bytes) on index '%s' of segment: '%s', try linear scan...\n"
+			, memLimit
+			, schema.m_name.c_str(), seg->m_segDir.string().c_str());
+		auto matchDFA = static_cast<const AdapterRegexDFA*>(
+				dynamic_cast<const DenseDFA_uint32_320*>(regexDFA)
+			);
+		assert(NULL != matchDFA);
+		valvec<byte> key;
+		size_t subPhysicId = 0;
+		size_t subLogicId = 0;
+		size_t subRowsNum = seg->m_isDel.size();
+		boost::intrusive_ptr<SeqReadAppendonlyStore>
+			seqStore(new SeqReadAppendonlyStore(seg->m_segDir, schema));
+		StoreIteratorPtr iter = seqStore->createStoreIterForward(NULL);
+		const bm_uint_t* isDel = seg->m_isDel.bldata();
+		const bm_uint_t* isPurged = seg->m_isPurged.bldata();
+		for (; subLogicId < subRowsNum; subLogicId++) {
+			if (!isPurged || !terark_bit_test(isPurged, subLogicId)) {
+				llong subCheckPhysicId = INT_MAX; // for fail fast
+				bool hasData = iter->increment(&subCheckPhysicId, &key);
+				TERARK_RT_assert(hasData, std::logic_error);
+				TERARK_RT_assert(size_t(subCheckPhysicId) == subPhysicId, std::logic_error);
+				if (!terark_bit_test(isDel, subLogicId)) {
+					if (matchDFA->first_mismatch_pos(key) == key.size()) {
+						recIdvec->push_back(baseId + subLogicId);
+					}
+				}
+				subPhysicId++;
+			}
+		}
+	}
+	else { // failed because exceeded memory limit
+		// should fallback to use linear scan?
+		fprintf(stderr
+			, "ERROR: RegexMatch exceeded memory limit(%zd bytes) on index '%s' of segment: '%s', and linear scan is not enabled, failed!\n"
+			, memLimit
+			, schema.m_name.c_str(), seg->m_segDir.string().c_str());
+	}
+}
+
+namespace {
+
+// Each running DFA intersection holds memLimit bytes of the budget,
+// the budget is shared by all queries of the process, so concurrent
+// intersections never use more than the budget in total.
+// A query takes its slots before its segments are scheduled, tbb tasks
+// never wait for the budget
+class RegexMatchMemBudget {
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	size_t m_total;
+	size_t m_avail;
+public:
+	explicit RegexMatchMemBudget(size_t total)
+		: m_total(total), m_avail(total) {}
+	size_t total() const { return m_total; }
+	///@returns number of acquired slots, in [1, maxSlots]
+	size_t acquire(size_t slotBytes, size_t maxSlots) {
+		assert(slotBytes <= m_total);
+		assert(maxSlots >= 1);
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond.wait(lock, [&]{ return m_avail >= slotBytes; });
+		size_t slots = std::min(maxSlots, m_avail / slotBytes);
+		m_avail -= slotBytes * slots;
+		return slots;
+	}
+	void release(size_t bytes) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_avail += bytes;
+		}
+		m_cond.notify_all();
+	}
+	static RegexMatchMemBudget& instance() {
+		static RegexMatchMemBudget budget(initialTotal());
+		return budget;
+	}
+private:
+	static size_t initialTotal() {
+		if (const char* env = getenv("TerarkDB_RegexMatchMemBudget")) {
+			return std::max<size_t>(1, (size_t)strtoull(env, NULL, 10));
+		}
+		size_t cpuNum = std::max<size_t>(1, tbb::tbb_thread::hardware_concurrency());
+		return 16*1024*1024 * cpuNum; // default regexMatchMemLimit per cpu
+	}
+};
+
+} // namespace
+
+///@returns false if stopped by limit or onMatch
 bool
-DfaDbTable::indexMatchRegex(size_t indexId, BaseDFA* regexDFA,
-							valvec<llong>* recIdvec, DbContext* ctx)
+DfaDbTable::indexMatchRegex(size_t indexId, BaseDFA* regexDFA, size_t limit,
+							const RegexMatchCallback& onMatch, DbContext* ctx)
 const {
 	if (indexId >= m_schema->getIndexNum()) {
 		THROW_STD(invalid_argument
@@ -98,76 +218,111 @@ const {
 			, "can not MatchRegex on non-string indexId=%zd indexName=%s"
 			, indexId, schema.m_name.c_str());
 	}
-	recIdvec->erase_all();
-	MyRwLock lock(this->m_rwMutex, false);
-	for (size_t i = 0; i < m_segments.size(); ++i) {
-		auto seg = m_segments[i].get();
-		if (seg->getWritableStore()) {
-			if (seg->m_isDel.size() > 0) {
-			  fprintf(stderr
-				, "WARN: segment: %s is a writable segment, can not MatchRegex\n"
-				, getSegPath("wr", i).string().c_str());
-			}
-			continue;
-		}
-		auto index = dynamic_cast<const NestLoudsTrieIndex*>(&*seg->m_indices[indexId]);
-		if (!index) {
-			THROW_STD(logic_error, "MatchRegex must be run on NestLoudsTrieIndex\n");
-		}
-		size_t oldsize = recIdvec->size();
-		if (index->matchRegexAppend(regexDFA, recIdvec, ctx)) {
-			llong baseId = m_rowNumVec[i];
-			size_t i = oldsize;
-			for(size_t j = oldsize; j < recIdvec->size(); ++j) {
-				size_t subPhysicId = (*recIdvec)[j];
-				size_t subLogicId = seg->getLogicId(subPhysicId);
-				if (!seg->m_isDel[subLogicId])
-					(*recIdvec)[i++] = baseId + subLogicId;
-			}
-			recIdvec->risk_set_size(i);
-		}
-		else if (schema.m_enableLinearScan) {
-			fprintf(stderr
-				, "WARN: RegexMatch exceeded memory limit(%zd bytes) on index '%s' of segment: '%s', try linear scan...\n"
-				, ctx->regexMatchMemLimit
-				, schema.m_name.c_str(), seg->m_segDir.string().c_str());
-			auto matchDFA = static_cast<const AdapterRegexDFA*>(
-					dynamic_cast<const DenseDFA_uint32_320*>(regexDFA)
-				);
-			assert(NULL != matchDFA);
-			valvec<byte> key;
-			size_t subPhysicId = 0;
-			size_t subLogicId = 0;
-			size_t subRowsNum = seg->m_isDel.size();
-			boost::intrusive_ptr<SeqReadAppendonlyStore>
-				seqStore(new SeqReadAppendonlyStore(seg->m_segDir, schema));
-			StoreIteratorPtr iter = seqStore->createStoreIterForward(ctx);
-			const bm_uint_t* isDel = seg->m_isDel.bldata();
-			const bm_uint_t* isPurged = seg->m_isPurged.bldata();
-			const llong baseId = m_rowNumVec[i];
-			for (; subLogicId < subRowsNum; subLogicId++) {
-				if (!isPurged || !terark_bit_test(isPurged, subLogicId)) {
-					llong subCheckPhysicId = INT_MAX; // for fail fast
-					bool hasData = iter->increment(&subCheckPhysicId, &key);
-					TERARK_RT_assert(hasData, std::logic_error);
-					TERARK_RT_assert(size_t(subCheckPhysicId) == subPhysicId, std::logic_error);
-					if (!terark_bit_test(isDel, subLogicId)) {
-						if (matchDFA->first_mismatch_pos(key) == key.size()) {
-							recIdvec->push_back(baseId + subLogicId);
-						}
-					}
-					subPhysicId++;
+	if (0 == limit)
+		return false;
+	valvec<ReadableSegmentPtr> segs;
+	valvec<llong> baseIds;
+	{
+		MyRwLock lock(this->m_rwMutex, false);
+		for (size_t i = 0; i < m_segments.size(); ++i) {
+			auto seg = m_segments[i].get();
+			if (seg->getWritableStore()) {
+				if (seg->m_isDel.size() > 0) {
+				  fprintf(stderr
+					, "WARN: segment: %s is a writable segment, can not MatchRegex\n"
+					, getSegPath("wr", i).string().c_str());
 				}
+				continue;
 			}
+			if (seg->m_isDel.size() == seg->m_delcnt)
+				continue;
+			segs.push_back(seg);
+			baseIds.push_back(m_rowNumVec[i]);
 		}
-		else { // failed because exceeded memory limit
-			// should fallback to use linear scan?
-			fprintf(stderr
-				, "ERROR: RegexMatch exceeded memory limit(%zd bytes) on index '%s' of segment: '%s', and linear scan is not enabled, failed!\n"
-				, ctx->regexMatchMemLimit
-				, schema.m_name.c_str(), seg->m_segDir.string().c_str());
+	}
+	if (segs.empty())
+		return true;
+	const size_t memLimit = ctx->regexMatchMemLimit;
+	size_t maxSlots = tbb::tbb_thread::hardware_concurrency();
+	if (const char* env = getenv("TerarkDB_RegexMatchThreads")) {
+		maxSlots = (size_t)strtoull(env, NULL, 10);
+	}
+	maxSlots = std::max<size_t>(1, std::min(maxSlots, segs.size()));
+	RegexMatchMemBudget& budget = RegexMatchMemBudget::instance();
+	// a query larger than the whole budget runs alone
+	const size_t slotBytes = std::min(memLimit, budget.total());
+	// waits on the calling thread, at most slots segments run concurrently
+	const size_t slots = budget.acquire(slotBytes, maxSlots);
+	std::atomic<bool>   stopped(false);
+	std::mutex          resultMutex;
+	size_t              resultNum = 0;
+	std::exception_ptr  workerEx;
+	auto matchSeg = [&](size_t k) {
+		if (stopped)
+			return;
+		valvec<llong> recIdvec;
+		try {
+			matchRegexOneSeg(segs[k].get(), baseIds[k], indexId,
+				schema, regexDFA, memLimit, &recIdvec);
+			if (recIdvec.empty())
+				return;
+			// stream results as segments finish
+			std::unique_lock<std::mutex> lock(resultMutex);
+			if (stopped)
+				return;
+			size_t num = std::min(recIdvec.size(), limit - resultNum);
+			resultNum += num;
+			if (!onMatch(recIdvec.data(), num) || resultNum >= limit)
+				stopped = true;
 		}
+		catch (...) {
+			std::unique_lock<std::mutex> lock(resultMutex);
+			if (!workerEx)
+				workerEx = std::current_exception();
+			stopped = true;
+		}
+	};
+	try {
+		if (1 == slots) {
+			for (size_t k = 0; k < segs.size(); ++k)
+				matchSeg(k);
+		}
+		else {
+			// segments are scheduled on the shared tbb worker pool, no threads
+			// are created per query, the arena caps the concurrency to slots
+			tbb::task_arena arena((int)slots);
+			arena.execute([&]() {
+				tbb::parallel_for(tbb::blocked_range<size_t>(0, segs.size(), 1),
+					[&](const tbb::blocked_range<size_t>& r) {
+						for (size_t k = r.begin(); k < r.end(); ++k)
+							matchSeg(k);
+					});
+			});
+		}
+	}
+	catch (...) {
+		budget.release(slotBytes * slots);
+		throw;
+	}
+	budget.release(slotBytes * slots);
+	if (workerEx) {
+		std::rethrow_exception(workerEx);
 	}
+	return !stopped;
+}
+
+bool
+DfaDbTable::indexMatchRegex(size_t indexId, BaseDFA* regexDFA,
+							valvec<llong>* recIdvec, DbContext* ctx)
+const {
+	recIdvec->erase_all();
+	indexMatchRegex(indexId, regexDFA, size_t(-1),
+		[recIdvec](const llong* recIds, size_t num) {
+			recIdvec->append(recIds, num);
+			return true;
+		}, ctx);
+	// segments are matched in parallel, sort for a stable result
+	std::sort(recIdvec->begin(), recIdvec->end());
 	return true;
 }
 
@@ -180,6 +335,207 @@ const {
 	return indexMatchRegex(indexId, regexDFA.get(), recIdvec, ctx);
 }
 
+// ids are physical ids of seg, not checking m_isDel
+static size_t
+segIndexPrefixAppend(IndexIterator* iter, fstring prefix, size_t limit,
+					 valvec<llong>* recIdvec, valvec<byte>* key) {
+	size_t oldsize = recIdvec->size();
+	llong recId = -1;
+	if (limit && iter->seekLowerBound(prefix, &recId, key) >= 0) {
+		while (fstring(*key).startsWith(prefix)) {
+			recIdvec->push_back(recId);
+			if (recIdvec->size() - oldsize >= limit || !iter->increment(&recId, key))
+				break;
+		}
+	}
+	return recIdvec->size() - oldsize;
+}
+
+// remove deleted ids in recIdvec[beg, end), convert to global ids
+static void
+filterDeleted(const ReadableSegment* seg, llong baseId,
+			  valvec<llong>* recIdvec, size_t beg) {
+	llong* p = recIdvec->data();
+	size_t k = beg;
+	if (seg->getWritableSegment()) {
+		SpinRwLock lock(seg->m_segMutex, false);
+		for (size_t j = beg; j < recIdvec->size(); ++j) {
+			if (!seg->m_isDel[p[j]])
+				p[k++] = baseId + p[j];
+		}
+	}
+	else {
+		for (size_t j = beg; j < recIdvec->size(); ++j) {
+			size_t subLogicId = seg->getLogicId(p[j]);
+			if (!seg->m_isDel[subLogicId])
+				p[k++] = baseId + subLogicId;
+		}
+	}
+	recIdvec->risk_set_size(k);
+}
+
+static const NestLoudsTrieIndex*
+getNltIndex(const ReadableSegment* seg, size_t indexId) {
+	if (seg->getWritableSegment())
+		return nullptr;
+	return dynamic_cast<const NestLoudsTrieIndex*>(seg->m_indices[indexId].get());
+}
+
+// id is sub id of writable segment or physical id of readonly segment
+static bool
+getLiveLogicId(const ReadableSegment* seg, llong id, size_t* logicId) {
+	if (seg->getWritableSegment()) {
+		SpinRwLock lock(seg->m_segMutex, false);
+		*logicId = size_t(id);
+		return !seg->m_isDel[*logicId];
+	}
+	*logicId = seg->getLogicId(size_t(id));
+	return !seg->m_isDel[*logicId];
+}
+
+namespace {
+	// live prefix matches of one segment, in key order
+	struct SegPrefixMatches {
+		valvec<llong>  recIds; // global ids
+		SortableStrVec keys;
+		size_t pos = 0;
+	};
+}
+
+// each segment contributes at most limit live matches, they are merged in
+// key order, so the result is same as CompositeTable::indexSearchPrefix
+size_t
+DfaDbTable::indexSearchPrefix(size_t indexId, fstring prefix, size_t limit,
+							  valvec<llong>* recIdvec, DbContext* ctx)
+const {
+	if (indexId >= m_schema->getIndexNum()) {
+		THROW_STD(invalid_argument
+			, "invalid indexId=%zd is not less than indexNum=%zd"
+			, indexId, m_schema->getIndexNum());
+	}
+	const Schema& indexSchema = m_schema->getIndexSchema(indexId);
+	if (!indexSchema.m_isOrdered) {
+		THROW_STD(invalid_argument, "index: %s is not ordered",
+			indexSchema.m_name.c_str());
+	}
+	recIdvec->erase_all();
+	if (0 == limit)
+		return 0;
+	ctx->trySyncSegCtxSpeculativeLock(this);
+	size_t segNum = ctx->m_segCtx.size();
+	std::vector<SegPrefixMatches> matches(segNum);
+	valvec<llong> physIds;
+	valvec<byte>& key = ctx->key2;
+	for (size_t i = 0; i < segNum; ++i) {
+		auto seg = ctx->m_segCtx[i]->seg;
+		if (seg->m_isDel.size() == seg->m_delcnt)
+			continue;
+		const llong baseId = ctx->m_rowNumVec[i];
+		SegPrefixMatches& m = matches[i];
+		size_t logicId;
+		if (auto index = getNltIndex(seg, indexId)) {
+			// walk the trie, fetch again if some ids are deleted
+			size_t skip = 0;
+			while (m.recIds.size() < limit) {
+				size_t want = limit - m.recIds.size();
+				physIds.erase_all();
+				size_t got = index->searchPrefixAppend(prefix, skip, want, &physIds, ctx);
+				skip += got;
+				for (llong physId : physIds) {
+					if (getLiveLogicId(seg, physId, &logicId)) {
+						m.recIds.push_back(baseId + logicId);
+						key.erase_all();
+						index->getValueAppend(physId, &key, ctx);
+						m.keys.push_back(key);
+					}
+				}
+				if (got < want)
+					break;
+			}
+		}
+		else {
+			IndexIterator* iter = ctx->getIndexIterNoLock(i, indexId);
+			llong id = -1;
+			bool hasNext = iter->seekLowerBound(prefix, &id, &key) >= 0;
+			while (hasNext && fstring(key).startsWith(prefix) && m.recIds.size() < limit) {
+				if (getLiveLogicId(seg, id, &logicId)) {
+					m.recIds.push_back(baseId + logicId);
+					m.keys.push_back(key);
+				}
+				hasNext = iter->increment(&id, &key);
+			}
+		}
+	}
+	// min heap of segments by current key, equal keys in segment order
+	auto greater = [&](size_t x, size_t y) {
+		const SegPrefixMatches& mx = matches[x];
+		const SegPrefixMatches& my = matches[y];
+		int c = indexSchema.compareData(mx.keys[mx.pos], my.keys[my.pos]);
+		return c ? c > 0 : x > y;
+	};
+	valvec<size_t> heap;
+	for (size_t i = 0; i < segNum; ++i) {
+		if (!matches[i].recIds.empty())
+			heap.push_back(i);
+	}
+	std::make_heap(heap.begin(), heap.end(), greater);
+	while (!heap.empty() && recIdvec->size() < limit) {
+		std::pop_heap(heap.begin(), heap.end(), greater);
+		SegPrefixMatches& m = matches[heap.back()];
+		recIdvec->push_back(m.recIds[m.pos++]);
+		if (m.pos < m.recIds.size())
+			std::push_heap(heap.begin(), heap.end(), greater);
+		else
+			heap.pop_back();
+	}
+	return recIdvec->size();
+}
+
+llong
+DfaDbTable::indexCountPrefix(size_t indexId, fstring prefix, DbContext* ctx)
+const {
+	if (indexId >= m_schema->getIndexNum()) {
+		THROW_STD(invalid_argument
+			, "invalid indexId=%zd is not less than indexNum=%zd"
+			, indexId, m_schema->getIndexNum());
+	}
+	if (!m_schema->getIndexSchema(indexId).m_isOrdered) {
+		THROW_STD(invalid_argument, "index: %s is not ordered",
+			m_schema->getIndexSchema(indexId).m_name.c_str());
+	}
+	ctx->trySyncSegCtxSpeculativeLock(this);
+	llong cnt = 0;
+	valvec<llong> recIdvec;
+	size_t segNum = ctx->m_segCtx.size();
+	for (size_t i = 0; i < segNum; ++i) {
+		auto seg = ctx->m_segCtx[i]->seg;
+		if (seg->m_isDel.size() == seg->m_delcnt)
+			continue;
+		auto index = getNltIndex(seg, indexId);
+		if (index && 0 == seg->m_delcnt) {
+			cnt += index->countPrefix(prefix); // from trie structure
+		}
+		else if (index) {
+			const size_t ChunkSize = 4096;
+			size_t skip = 0, got;
+			do {
+				recIdvec.erase_all();
+				got = index->searchPrefixAppend(prefix, skip, ChunkSize, &recIdvec, ctx);
+				skip += got;
+				filterDeleted(seg, 0, &recIdvec, 0);
+				cnt += recIdvec.size();
+			} while (got == ChunkSize);
+		}
+		else {
+			IndexIterator* iter = ctx->getIndexIterNoLock(i, indexId);
+			recIdvec.erase_all();
+			segIndexPrefixAppend(iter, prefix, size_t(-1), &recIdvec, &ctx->key2);
+			filterDeleted(seg, 0, &recIdvec, 0);
+			cnt += recIdvec.size();
+		}
+	}
+	return cnt;
+}
 
 TERARK_DB_REGISTER_TABLE_CLASS(DfaDbTable);
 
@@ -5,6 +5,7 @@
 #include <terark/int_vector.hpp>
 #include <terark/rank_select.hpp>
 #include <terark/fsa/nest_trie_dawg.hpp>
+#include <functional>
 
 namespace terark {
 //	class Nest
@@ -20,12 +21,22 @@ public:
 };
 class TERARK_DB_DLL DfaDbTable : public CompositeTable {
 public:
+	///@{ onMatch is called with global record ids when a segment finishes,
+	/// it is serialized, returns false to stop the matching
+	typedef std::function<bool(const llong* recIds, size_t num)> RegexMatchCallback;
+	///@}
 	DbContext* createDbContextNoLock() const override;
 	ReadonlySegment* createReadonlySegment(PathRef dir) const override;
 	WritableSegment* createWritableSegment(PathRef dir) const override;
 	WritableSegment* openWritableSegment(PathRef dir) const override;
 	bool indexMatchRegex(size_t indexId, BaseDFA* regexDFA, valvec<llong>* recIdvec, DbContext*) const override;
 	bool indexMatchRegex(size_t indexId, fstring  regexStr, fstring  regexOptions, valvec<llong>* recIdvec, DbContext*) const override;
+
+	// match segments in parallel, with a shared memory budget, stop when
+	// limit ids are matched
+	bool indexMatchRegex(size_t indexId, BaseDFA* regexDFA, size_t limit, const RegexMatchCallback& onMatch, DbContext*) const;
+	size_t indexSearchPrefix(size_t indexId, fstring prefix, size_t limit, valvec<llong>* recIdvec, DbContext*) const override;
+	llong  indexCountPrefix(size_t indexId, fstring prefix, DbContext*) const override;
 };
 
 }}} // namespace terark::db::dfadb
@@ -504,9 +504,15 @@ IndexIterator* NestLoudsTrieIndex::createIndexIterBackward(DbContext*) const {
 bool NestLoudsTrieIndex::matchRegexAppend(BaseDFA* regexDFA,
 										  valvec<llong>* recIdvec,
 										  DbContext* ctx) const {
+	return matchRegexAppend(regexDFA, recIdvec, ctx->regexMatchMemLimit);
+}
+
+bool NestLoudsTrieIndex::matchRegexAppend(BaseDFA* regexDFA,
+										  valvec<llong>* recIdvec,
+										  size_t memLimit) const {
 	valvec<size_t> matchStates;
 	if (!m_dfa->match_dfa(initial_state, *regexDFA,
-						  &matchStates, ctx->regexMatchMemLimit)) {
+						  &matchStates, memLimit)) {
 		return false;
 	}
 	if (m_isUnique) {
@@ -530,4 +536,67 @@ bool NestLoudsTrieIndex::matchRegexAppend(BaseDFA* regexDFA,
 	return true;
 }
 
+// dawg word ids are in lexical order, keys with the prefix are the word ids
+// in [lo, hi), they are located by two trie walks, keys are not materialized
+bool NestLoudsTrieIndex::prefixKeyRange(fstring prefix, size_t* lo, size_t* hi)
+const {
+	auto dawg = m_dfa->get_dawg();
+	assert(dawg);
+	std::unique_ptr<ADFA_LexIterator> iter(m_dfa->adfa_make_iter());
+	if (!iter->seek_lower_bound(prefix) || !iter->word().startsWith(prefix)) {
+		*lo = *hi = 0;
+		return false;
+	}
+	*lo = m_dfa->state_to_word_id(iter->word_state());
+	// upper bound of prefix: increment the last non 0xFF byte
+	std::string upp(prefix.data(), prefix.size());
+	while (!upp.empty() && byte(upp.back()) == 0xFF)
+		upp.pop_back();
+	if (!upp.empty()) {
+		upp.back() = char(byte(upp.back()) + 1);
+		if (iter->seek_lower_bound(upp))
+			*hi = m_dfa->state_to_word_id(iter->word_state());
+		else
+			*hi = dawg->num_words();
+	}
+	else {
+		*hi = dawg->num_words();
+	}
+	assert(*lo < *hi);
+	return true;
+}
+
+size_t NestLoudsTrieIndex::countPrefix(fstring prefix) const {
+	size_t lo, hi;
+	if (!prefixKeyRange(prefix, &lo, &hi))
+		return 0;
+	if (m_isUnique)
+		return hi - lo;
+	else
+		return m_recBits.select1(hi) - m_recBits.select1(lo);
+}
+
+///@returns number of appended ids
+size_t NestLoudsTrieIndex::searchPrefixAppend(fstring prefix,
+											  size_t skip, size_t limit,
+											  valvec<llong>* recIdvec,
+											  DbContext*) const {
+	size_t lo, hi;
+	if (!prefixKeyRange(prefix, &lo, &hi))
+		return 0;
+	if (!m_isUnique) {
+		lo = m_recBits.select1(lo);
+		hi = m_recBits.select1(hi);
+	}
+	if (hi - lo <= skip)
+		return 0;
+	lo += skip;
+	if (hi - lo > limit)
+		hi = lo + limit;
+	for (size_t mapId = lo; mapId < hi; ++mapId) {
+		recIdvec->push_back(m_keyToId[mapId]);
+	}
+	return hi - lo;
+}
+
 }}} // namespace terark::db::dfadb
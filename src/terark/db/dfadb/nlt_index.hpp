@@ -40,6 +40,13 @@ public:
 	void save(PathRef path) const override;
 
 	bool matchRegexAppend(BaseDFA* regexDFA, valvec<llong>* recIdvec, DbContext*) const;
+	bool matchRegexAppend(BaseDFA* regexDFA, valvec<llong>* recIdvec, size_t memLimit) const;
+
+	///@{ prefix search, ids are physical ids, in key order
+	bool prefixKeyRange(fstring prefix, size_t* lo, size_t* hi) const;
+	size_t countPrefix(fstring prefix) const;
+	size_t searchPrefixAppend(fstring prefix, size_t skip, size_t limit, valvec<llong>* recIdvec, DbContext*) const;
+	///@}
 
 protected:
 	struct FileHeader;
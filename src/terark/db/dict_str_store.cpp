@@ -0,0 +1,224 @@
+#include "dict_str_store.hpp"
+#include <terark/io/FileStream.hpp>
+#include <terark/io/DataIO.hpp>
+#include <terark/hash_strmap.hpp>
+#include <terark/util/mmap.hpp>
+
+namespace terark { namespace db {
+
+DictStrStore::DictStrStore(const Schema& schema) {
+	m_offsets.resize_with_wire_max_val(1, 0u); // empty dict
+	m_mmapBase = nullptr;
+	m_mmapSize = 0;
+	m_inflateSize = 0;
+}
+DictStrStore::~DictStrStore() {
+	if (m_mmapBase) {
+		m_offsets.risk_release_ownership();
+		m_codes.risk_release_ownership();
+		m_dictPool.risk_release_ownership();
+		mmap_close(m_mmapBase, m_mmapSize);
+	}
+}
+
+double DictStrStore::getMaxDistinctRatio() {
+	if (const char* env = getenv("TerarkDB_DictStoreMaxRatio")) {
+		return strtod(env, NULL);
+	}
+	return 0.01;
+}
+
+llong DictStrStore::dataStorageSize() const {
+	return m_offsets.mem_size() + m_codes.mem_size() + m_dictPool.used_mem_size();
+}
+
+llong DictStrStore::dataInflateSize() const {
+	return m_inflateSize;
+}
+
+llong DictStrStore::numDataRows() const {
+	return m_codes.size();
+}
+
+fstring DictStrStore::dictValue(size_t code) const {
+	assert(code < dictSize());
+	size_t beg = m_offsets.get(code);
+	size_t end = m_offsets.get(code + 1);
+	return fstring(m_dictPool.data() + beg, end - beg);
+}
+
+size_t DictStrStore::findCode(fstring val) const {
+	size_t lo = 0, hi = dictSize();
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (dictValue(mid) < val)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < dictSize() && dictValue(lo) == val)
+		return lo;
+	return dictSize();
+}
+
+void DictStrStore::getValueAppend(llong id, valvec<byte>* val, DbContext*) const {
+	assert(id >= 0);
+	assert(id < llong(m_codes.size()));
+	val->append(dictValue(m_codes.get(id)));
+}
+
+bool DictStrStore::getValueView(llong id, fstring* view, DbContext*) const {
+	assert(id >= 0);
+	assert(id < llong(m_codes.size()));
+	*view = dictValue(m_codes.get(id));
+	return true;
+}
+
+void DictStrStore::getCodeBatch(size_t recBeg, size_t num, size_t* codes) const {
+	m_codes.get_block(recBeg, num, codes);
+}
+
+void DictStrStore::findEqual(fstring val, valvec<llong>* recIdvec) const {
+	const size_t code = findCode(val);
+	if (code == dictSize()) {
+		return;
+	}
+	const size_t rows = m_codes.size();
+	size_t codes[128];
+	for (size_t i = 0; i < rows; i += 128) {
+		size_t n = std::min<size_t>(128, rows - i);
+		m_codes.get_block(i, n, codes);
+		for (size_t j = 0; j < n; ++j) {
+			if (codes[j] == code)
+				recIdvec->push_back(llong(i + j));
+		}
+	}
+}
+
+void DictStrStore::countByCode(valvec<llong>* counts) const {
+	counts->erase_all();
+	counts->resize(dictSize(), 0);
+	const size_t rows = m_codes.size();
+	size_t codes[128];
+	for (size_t i = 0; i < rows; i += 128) {
+		size_t n = std::min<size_t>(128, rows - i);
+		m_codes.get_block(i, n, codes);
+		for (size_t j = 0; j < n; ++j) {
+			(*counts)[codes[j]]++;
+		}
+	}
+}
+
+StoreIterator* DictStrStore::createStoreIterForward(DbContext*) const {
+	return nullptr; // not needed
+}
+
+StoreIterator* DictStrStore::createStoreIterBackward(DbContext*) const {
+	return nullptr; // not needed
+}
+
+bool
+DictStrStore::build(const Schema& schema, SortableStrVec& strVec,
+					size_t maxDictSize) {
+	const size_t fixlen = schema.getFixedRowLen();
+	const bool   hasIndex = strVec.m_index.size() != 0;
+	const size_t rows = hasIndex ? strVec.m_index.size()
+					  : fixlen ? strVec.m_strpool.size() / fixlen : 0;
+	auto getRow = [&](size_t i) {
+		return hasIndex ? strVec[i]
+			: fstring(strVec.m_strpool.data() + fixlen * i, fixlen);
+	};
+	hash_strmap<> dict;
+	valvec<uint32_t> hashIdx(rows, valvec_no_init());
+	for (size_t i = 0; i < rows; ++i) {
+		hashIdx[i] = uint32_t(dict.insert_i(getRow(i)).first);
+		if (dict.size() > maxDictSize) {
+			return false;
+		}
+	}
+	const size_t dictNum = dict.end_i();
+	valvec<uint32_t> order(dictNum, valvec_no_init());
+	for (size_t i = 0; i < dictNum; ++i) order[i] = uint32_t(i);
+	std::sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) {
+		return dict.key(x) < dict.key(y);
+	});
+	valvec<uint32_t> hashToCode(dictNum, valvec_no_init());
+	size_t poolSize = 0;
+	for (size_t i = 0; i < dictNum; ++i) {
+		hashToCode[order[i]] = uint32_t(i);
+		poolSize += dict.key(i).size();
+	}
+	m_dictPool.erase_all();
+	m_dictPool.reserve(poolSize);
+	m_offsets.resize_with_wire_max_val(dictNum + 1, poolSize);
+	for (size_t i = 0; i < dictNum; ++i) {
+		m_offsets.set_wire(i, m_dictPool.size());
+		m_dictPool.append(dict.key(order[i]));
+	}
+	m_offsets.set_wire(dictNum, m_dictPool.size());
+	m_codes.resize_with_wire_max_val(rows, std::max<size_t>(dictNum, 1) - 1);
+	llong inflateSize = 0;
+	for (size_t i = 0; i < rows; ++i) {
+		size_t code = hashToCode[hashIdx[i]];
+		m_codes.set_wire(i, code);
+		inflateSize += m_offsets.get(code + 1) - m_offsets.get(code);
+	}
+	m_inflateSize = inflateSize;
+	return true;
+}
+
+namespace {
+	struct DictStrStoreHeader {
+		uint64_t rows;
+		uint64_t dictSize;
+		uint64_t poolBytes;
+		uint64_t inflateSize;
+		uint8_t  codeBits;
+		uint8_t  offsetBits;
+		uint16_t padding1;
+		uint32_t padding2;
+		uint64_t padding3;
+	};
+	BOOST_STATIC_ASSERT(sizeof(DictStrStoreHeader) == 48);
+}
+
+TERARK_DB_REGISTER_STORE("sdict", DictStrStore);
+
+void DictStrStore::load(PathRef fpath) {
+	assert(fstring(fpath.string()).endsWith(".sdict"));
+	m_mmapBase = (byte_t*)mmap_load(fpath.string(), &m_mmapSize);
+	auto header = (const DictStrStoreHeader*)m_mmapBase;
+	byte* data = (byte*)(header + 1);
+	m_offsets.risk_set_data(data, header->dictSize + 1, header->offsetBits);
+	data += m_offsets.mem_size();
+	m_codes.risk_set_data(data, header->rows, header->codeBits);
+	data += m_codes.mem_size();
+	if (data + header->poolBytes > m_mmapBase + m_mmapSize) {
+		THROW_STD(invalid_argument, "path=%s, broken data: fileSize=%zd"
+			, fpath.string().c_str(), m_mmapSize);
+	}
+	m_dictPool.risk_set_data(data, header->poolBytes);
+	m_inflateSize = header->inflateSize;
+}
+
+void DictStrStore::save(PathRef path) const {
+	auto fpath = path + ".sdict";
+	NativeDataOutput<FileStream> dio;
+	dio.open(fpath.string().c_str(), "wb");
+	DictStrStoreHeader header;
+	header.rows = m_codes.size();
+	header.dictSize = dictSize();
+	header.poolBytes = m_dictPool.size();
+	header.inflateSize = m_inflateSize;
+	header.codeBits = byte(m_codes.uintbits());
+	header.offsetBits = byte(m_offsets.uintbits());
+	header.padding1 = 0;
+	header.padding2 = 0;
+	header.padding3 = 0;
+	dio.ensureWrite(&header, sizeof(header));
+	dio.ensureWrite(m_offsets.data(), m_offsets.mem_size());
+	dio.ensureWrite(m_codes.data(), m_codes.mem_size());
+	dio.ensureWrite(m_dictPool.data(), m_dictPool.used_mem_size());
+}
+
+}} // namespace terark::db
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <terark/db/db_store.hpp>
+#include <terark/int_vector.hpp>
+#include <terark/util/sortable_strvec.hpp>
+
+namespace terark { namespace db {
+
+// Store for low cardinality colgroups such as status, country, category:
+// distinct values are sorted into a small dictionary, each row is just a
+// bit packed code into the dictionary, so getValueAppend is O(1) and
+// equality filter/group-by can work on codes without touching strings.
+class TERARK_DB_DLL DictStrStore : public ReadableStore {
+public:
+	explicit DictStrStore(const Schema& schema);
+	~DictStrStore();
+
+	llong dataStorageSize() const override;
+	llong dataInflateSize() const override;
+	llong numDataRows() const override;
+	void getValueAppend(llong id, valvec<byte>* val, DbContext*) const override;
+	bool getValueView(llong id, fstring* view, DbContext*) const override;
+	StoreIterator* createStoreIterForward(DbContext*) const override;
+	StoreIterator* createStoreIterBackward(DbContext*) const override;
+
+	///@{ dictionary values are sorted by bytes, code is the ordinal
+	size_t dictSize() const { return m_offsets.size() - 1; }
+	fstring dictValue(size_t code) const;
+	/// return dictSize() if val is not in the dictionary
+	size_t findCode(fstring val) const;
+	///@}
+
+	///@{ codes of contiguous ids [recBeg, recBeg+num)
+	size_t getCode(size_t id) const { return m_codes.get(id); }
+	void getCodeBatch(size_t recBeg, size_t num, size_t* codes) const;
+	///@}
+
+	/// append ids of rows which value == val
+	void findEqual(fstring val, valvec<llong>* recIdvec) const;
+
+	/// counts[code] = number of rows of the code, for group-by
+	void countByCode(valvec<llong>* counts) const;
+
+	///@returns false if distinct values > maxDictSize, then the store
+	/// is not built and should be discarded
+	bool build(const Schema& schema, SortableStrVec& strVec, size_t maxDictSize);
+	void load(PathRef path) override;
+	void save(PathRef path) const override;
+
+	/// by env TerarkDB_DictStoreMaxRatio, default is 0.01, 0 disable it
+	static double getMaxDistinctRatio();
+
+protected:
+	UintVecMin0  m_offsets; // dictSize + 1 offsets into m_dictPool
+	UintVecMin0  m_codes;
+	valvec<byte> m_dictPool;
+	byte_t*      m_mmapBase;
+	size_t       m_mmapSize;
+	llong        m_inflateSize;
+};
+
+}} // namespace terark::db
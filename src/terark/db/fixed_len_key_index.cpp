@@ -2,6 +2,11 @@
 #include <terark/io/FileStream.hpp>
 #include <terark/io/DataIO.hpp>
 #include <terark/util/mmap.hpp>
+#include <terark/util/byte_swap_impl.hpp>
+#include <terark/bitmanip.hpp>
+#if defined(__AVX2__) || defined(__SSE4_2__)
+	#include <immintrin.h>
+#endif
 
 namespace terark { namespace db {
 
@@ -12,6 +17,7 @@ FixedLenKeyIndex::FixedLenKeyIndex() {
 	m_mmapSize = 0;
 	m_fixedLen = 0;
 	m_uniqKeys = 0;
+	m_sampleNum = 0;
 }
 
 FixedLenKeyIndex::~FixedLenKeyIndex() {
@@ -53,9 +59,159 @@ const {
 	}
 }
 
+namespace {
+	const size_t SampleShift = 3;
+	const size_t DirFanout = 8; // 8 x int64 = one cache line
+
+	inline uint64_t loadBigEndian64(const byte* p) {
+		uint64_t x = unaligned_load<uint64_t>(p);
+	#if defined(BOOST_LITTLE_ENDIAN)
+		x = byte_swap(x);
+	#endif
+		return x;
+	}
+	inline int64_t flipSignBit(uint64_t x) {
+		return int64_t(x ^ (uint64_t(1) << 63));
+	}
+
+	// number of line[0,8) which are less than key
+	inline size_t countLessInLine(const int64_t* line, int64_t key) {
+	#if defined(__AVX2__)
+		__m256i k = _mm256_set1_epi64x(key);
+		__m256i a = _mm256_loadu_si256((const __m256i*)(line + 0));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(line + 4));
+		int ma = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, a)));
+		int mb = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, b)));
+		return fast_popcount32(unsigned(ma | mb << 4));
+	#elif defined(__SSE4_2__)
+		__m128i k = _mm_set1_epi64x(key);
+		int m = 0;
+		for (size_t i = 0; i < 4; ++i) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(line + 2*i));
+			m |= _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(k, a))) << 2*i;
+		}
+		return fast_popcount32(unsigned(m));
+	#else
+		size_t n = 0;
+		for (size_t i = 0; i < 8; ++i) n += line[i] < key;
+		return n;
+	#endif
+	}
+
+	template<size_t FixLen> struct BigEndianKey;
+	template<> struct BigEndianKey<8> {
+		uint64_t x;
+		explicit BigEndianKey(const byte* p) : x(loadBigEndian64(p)) {}
+		bool operator< (BigEndianKey y) const { return x <  y.x; }
+		bool operator==(BigEndianKey y) const { return x == y.x; }
+	};
+	template<> struct BigEndianKey<16> {
+		uint64_t hi, lo;
+		explicit BigEndianKey(const byte* p)
+			: hi(loadBigEndian64(p)), lo(loadBigEndian64(p + 8)) {}
+		bool operator<(BigEndianKey y) const {
+			return hi < y.hi || (hi == y.hi && lo < y.lo);
+		}
+		bool operator==(BigEndianKey y) const { return hi == y.hi && lo == y.lo; }
+	};
+}
+
+void FixedLenKeyIndex::buildSampleDir() {
+	m_sampleDir.clear();
+	m_sampleLevel.clear();
+	m_sampleNum = 0;
+	size_t rows = m_index.size();
+	if ((8 != m_fixedLen && 16 != m_fixedLen) || rows < (DirFanout << SampleShift)) {
+		return;
+	}
+	size_t ns = (rows + (size_t(1) << SampleShift) - 1) >> SampleShift;
+	size_t n = ns;
+	m_sampleLevel.push_back(0);
+	m_sampleDir.reserve(ns + ns / 4 + DirFanout * 8);
+	for (size_t t = 0; t < ns; ++t) {
+		size_t pos = m_index.get(t << SampleShift);
+		m_sampleDir.push_back(flipSignBit(loadBigEndian64(m_keys.data() + m_fixedLen * pos)));
+	}
+	while (true) {
+		while (m_sampleDir.size() % DirFanout) // padding as uint64 max
+			m_sampleDir.push_back(flipSignBit(UINT64_MAX));
+		if (n <= DirFanout)
+			break;
+		size_t prev = m_sampleLevel.back();
+		m_sampleLevel.push_back(m_sampleDir.size());
+		for (size_t i = 0; i < n; i += DirFanout) {
+			int64_t x = m_sampleDir[prev + i];
+			m_sampleDir.push_back(x);
+		}
+		n = (n + DirFanout - 1) / DirFanout;
+	}
+	m_sampleDir.shrink_to_fit();
+	m_sampleNum = ns;
+}
+
+// number of bottom level samples which are less than prefix
+size_t FixedLenKeyIndex::sampleDirCountLess(uint64_t prefix) const {
+	const int64_t* dir = m_sampleDir.data();
+	const int64_t  key = flipSignBit(prefix);
+	size_t l = m_sampleLevel.size() - 1;
+	size_t b = 0, n = 0;
+	while (true) {
+		n = DirFanout * b + countLessInLine(dir + m_sampleLevel[l] + DirFanout * b, key);
+		if (0 == l)
+			break;
+		// samples of level l-1 at [8*(n-1), 8*n) are in range
+		b = n ? n - 1 : 0;
+		--l;
+	}
+	return n;
+}
+
+template<size_t FixLen>
+std::pair<size_t, bool>
+FixedLenKeyIndex::searchLowerBoundFixed(fstring binkey) const {
+	assert(binkey.size() == FixLen);
+	assert(m_sampleNum > 0);
+	typedef BigEndianKey<FixLen> Key;
+	auto indexData = m_index.data();
+	auto indexBits = m_index.uintbits();
+	auto indexMask = m_index.uintmask();
+	auto keysData = m_keys.data();
+	auto keyAt = [=](size_t idx) {
+		size_t pos = UintVecMin0::fast_get(indexData, indexBits, indexMask, idx);
+		return Key(keysData + FixLen * pos);
+	};
+	const Key key((const byte*)binkey.data());
+	const uint64_t prefix = loadBigEndian64((const byte*)binkey.data());
+	const size_t ns = m_sampleNum, rows = m_index.size();
+	size_t tlo = sampleDirCountLess(prefix), thi = tlo;
+	if (FixLen > 8) { // samples equal to prefix do not bound the key
+		thi = UINT64_MAX == prefix ? ns : sampleDirCountLess(prefix + 1);
+	}
+	size_t i = tlo ? ((tlo - 1) << SampleShift) + 1 : 0;
+	size_t j = thi < ns ? thi << SampleShift : rows;
+	while (j - i > (size_t(1) << SampleShift)) {
+		size_t mid = (i + j) / 2;
+		if (keyAt(mid) < key)
+			i = mid + 1;
+		else
+			j = mid;
+	}
+	while (i < j && keyAt(i) < key) ++i; // short linear scan
+	if (i < rows) {
+		return std::make_pair(i, keyAt(i) == key);
+	}
+	return std::make_pair(i, false);
+}
+
 std::pair<size_t, bool>
 FixedLenKeyIndex::searchLowerBound(fstring key) const {
 	assert(key.size() == m_fixedLen);
+	if (m_sampleNum) {
+		if (8 == m_fixedLen)
+			return searchLowerBoundFixed<8>(key);
+		else
+			return searchLowerBoundFixed<16>(key);
+	}
 	auto indexData = m_index.data();
 	auto indexBits = m_index.uintbits();
 	auto indexMask = m_index.uintmask();
@@ -103,6 +259,14 @@ void FixedLenKeyIndex::getValueAppend(llong id, valvec<byte>* val, DbContext*) c
 	val->append(dataPtr, m_fixedLen);
 }
 
+bool FixedLenKeyIndex::getValueView(llong id, fstring* view, DbContext*) const {
+	assert(id >= 0);
+	size_t idx = size_t(id);
+	assert(idx < m_keys.size());
+	*view = fstring(m_keys.data() + m_fixedLen * idx, m_fixedLen);
+	return true;
+}
+
 StoreIterator* FixedLenKeyIndex::createStoreIterForward(DbContext*) const {
 	return nullptr; // not needed
 }
@@ -152,6 +316,7 @@ void FixedLenKeyIndex::build(const Schema& schema, SortableStrVec& strVec) {
 	assert(0 == minIdx);
 	m_keys.clear();
 	m_keys.swap(strVec.m_strpool);
+	buildSampleDir();
 }
 
 namespace {
@@ -175,6 +340,7 @@ void FixedLenKeyIndex::load(PathRef path) {
 	m_keys .risk_set_data((byte*)(h+1) , keyMemSize);
 	keyMemSize = (keyMemSize + 15) & ~15;
 	m_index.risk_set_data((byte*)(h+1) + keyMemSize, h->rows, rbits);
+	buildSampleDir();
 }
 
 void FixedLenKeyIndex::save(PathRef path) const {
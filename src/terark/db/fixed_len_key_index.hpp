@@ -28,6 +28,7 @@ public:
 	llong dataInflateSize() const override;
 	llong numDataRows() const override;
 	void getValueAppend(llong id, valvec<byte>* val, DbContext*) const override;
+	bool getValueView(llong id, fstring* view, DbContext*) const override;
 	StoreIterator* createStoreIterForward(DbContext*) const override;
 	StoreIterator* createStoreIterBackward(DbContext*) const override;
 
@@ -43,6 +44,18 @@ protected:
 	size_t       m_fixedLen;
 	size_t       m_uniqKeys;
 
+	// k-ary sample directory for 8/16 bytes keys, rebuilt on build/load:
+	// big-endian prefix of every 8th sorted key, then every 8th of that...
+	// each node is 8 x int64 = one cache line, stored with sign bit flipped
+	valvec<int64_t> m_sampleDir;   // all levels, bottom level first
+	valvec<size_t>  m_sampleLevel; // begin of each level in m_sampleDir
+	size_t          m_sampleNum;   // bottom level size, 0 for no directory
+
+	void buildSampleDir();
+	size_t sampleDirCountLess(uint64_t prefix) const;
+
+	template<size_t FixLen>
+	std::pair<size_t, bool> searchLowerBoundFixed(fstring binkey) const;
 	std::pair<size_t, bool> searchLowerBound(fstring binkey) const;
 
 	class MyIndexIterForward;  friend class MyIndexIterForward;
@@ -0,0 +1,295 @@
+#include "float_xor_store.hpp"
+#include <terark/io/FileStream.hpp>
+#include <terark/io/DataIO.hpp>
+#include <terark/bitmanip.hpp>
+#include <terark/util/mmap.hpp>
+
+namespace terark { namespace db {
+
+const size_t FloatXorStore::BlockSize; // odr used by std::min
+
+FloatXorStore::FloatXorStore(const Schema& schema) {
+	TERARK_RT_assert(schema.columnNum() == 1, std::invalid_argument);
+	m_floatType = schema.getColumnMeta(0).type;
+	m_rows = 0;
+	m_mmapBase = nullptr;
+	m_mmapSize = 0;
+}
+FloatXorStore::~FloatXorStore() {
+	if (m_mmapBase) {
+		m_blockBitPos.risk_release_ownership();
+		m_data.risk_release_ownership();
+		mmap_close(m_mmapBase, m_mmapSize);
+	}
+}
+
+size_t FloatXorStore::valueBytes() const {
+	switch (m_floatType) {
+	default:
+		THROW_STD(invalid_argument,
+			"Bad m_floatType=%s", Schema::columnTypeStr(m_floatType));
+	case ColumnType::Float32: return 4;
+	case ColumnType::Float64: return 8;
+	}
+}
+
+llong FloatXorStore::dataStorageSize() const {
+	return m_blockBitPos.used_mem_size() + m_data.used_mem_size();
+}
+
+llong FloatXorStore::dataInflateSize() const {
+	return valueBytes() * m_rows;
+}
+
+llong FloatXorStore::numDataRows() const {
+	return m_rows;
+}
+
+namespace {
+	// bits are written LSB first, pieces are at most 32 bits, so a piece
+	// shifted by bitpos%8 always fits in an unaligned uint64
+	class XorBitWriter {
+		valvec<byte>& m_buf;
+	public:
+		size_t m_bitpos;
+		XorBitWriter(valvec<byte>& buf, size_t bitpos)
+			: m_buf(buf), m_bitpos(bitpos) {}
+		void write(uint64_t val, size_t n) {
+			assert(n <= 64);
+			assert(64 == n || val >> n == 0);
+			if (n > 32) {
+				write(val & 0xFFFFFFFF, 32);
+				write(val >> 32, n - 32);
+				return;
+			}
+			size_t bytePos = m_bitpos / 8;
+			if (m_buf.size() < bytePos + 8)
+				m_buf.resize(std::max(bytePos + 64, m_buf.size() * 2), 0);
+			uint64_t u = unaligned_load<uint64_t>(m_buf.data() + bytePos);
+			unaligned_save<uint64_t>(m_buf.data() + bytePos, u | val << m_bitpos % 8);
+			m_bitpos += n;
+		}
+	};
+	class XorBitReader {
+		const byte* m_data;
+		size_t m_bitpos;
+	public:
+		XorBitReader(const byte* data, size_t bitpos)
+			: m_data(data), m_bitpos(bitpos) {}
+		uint64_t read(size_t n) {
+			assert(n <= 64);
+			if (n > 32) {
+				uint64_t lo = read(32);
+				return lo | read(n - 32) << 32;
+			}
+			uint64_t u = unaligned_load<uint64_t>(m_data + m_bitpos / 8);
+			u >>= m_bitpos % 8;
+			m_bitpos += n;
+			return u & ((uint64_t(1) << n) - 1);
+		}
+		bool readBit() {
+			bool bit = (m_data[m_bitpos / 8] >> m_bitpos % 8) & 1;
+			m_bitpos++;
+			return bit;
+		}
+	};
+	// control bits:
+	//   0          : same as previous value
+	//   1 0 bits   : xor in the previous leading/trailing window
+	//   1 1 lead:6 (len-1):6 bits : xor in a new window
+	void encodeXorBlock(XorBitWriter& bw, const uint64_t* x, size_t n,
+						size_t valueBits) {
+		bw.write(x[0], valueBits);
+		size_t lead = 64, trail = 64; // no window
+		for (size_t i = 1; i < n; ++i) {
+			uint64_t xr = x[i] ^ x[i-1];
+			if (0 == xr) {
+				bw.write(0, 1);
+				continue;
+			}
+			size_t currLead = fast_clz64(xr);
+			size_t currTrail = fast_ctz64(xr);
+			if (lead + trail < 64 && currLead >= lead && currTrail >= trail) {
+				bw.write(1, 2);
+				bw.write(xr >> trail, 64 - lead - trail);
+			}
+			else {
+				size_t len = 64 - currLead - currTrail;
+				bw.write(3, 2);
+				bw.write(currLead, 6);
+				bw.write(len - 1, 6);
+				bw.write(xr >> currTrail, len);
+				lead = currLead;
+				trail = currTrail;
+			}
+		}
+	}
+}
+
+void FloatXorStore::decodeBlock(size_t blockIdx, size_t n, uint64_t* x) const {
+	assert(n <= BlockSize);
+	assert(n > 0);
+	XorBitReader br(m_data.data(), m_blockBitPos[blockIdx]);
+	x[0] = br.read(valueBytes() * 8);
+	size_t lead = 0, trail = 0;
+	for (size_t i = 1; i < n; ++i) {
+		if (!br.readBit()) {
+			x[i] = x[i-1];
+			continue;
+		}
+		if (br.readBit()) {
+			lead = br.read(6);
+			size_t len = br.read(6) + 1;
+			trail = 64 - lead - len;
+		}
+		x[i] = x[i-1] ^ br.read(64 - lead - trail) << trail;
+	}
+}
+
+template<class Visit>
+void FloatXorStore::forEachValue(size_t recBeg, size_t num, Visit visit) const {
+	assert(recBeg + num <= m_rows);
+	uint64_t x[BlockSize];
+	size_t recEnd = recBeg + num;
+	while (recBeg < recEnd) {
+		size_t blockIdx = recBeg / BlockSize;
+		size_t beg = recBeg % BlockSize;
+		size_t end = std::min(BlockSize, recEnd - blockIdx * BlockSize);
+		decodeBlock(blockIdx, end, x);
+		for (size_t i = beg; i < end; ++i) {
+			visit(x[i]);
+		}
+		recBeg += end - beg;
+	}
+}
+
+void FloatXorStore::getFloat64Batch(size_t recBeg, size_t num, double* values) const {
+	if (ColumnType::Float32 == m_floatType) {
+		forEachValue(recBeg, num, [&](uint64_t x) {
+			uint32_t u = uint32_t(x);
+			float f;
+			memcpy(&f, &u, sizeof(f));
+			*values++ = f;
+		});
+	}
+	else {
+		forEachValue(recBeg, num, [&](uint64_t x) {
+			memcpy(values++, &x, sizeof(double));
+		});
+	}
+}
+
+void FloatXorStore::getValueBatchAppend(size_t recBeg, size_t num,
+										valvec<byte>* vals) const {
+	const size_t bytes = valueBytes();
+	size_t oldsize = vals->size();
+	vals->resize_no_init(oldsize + bytes * num);
+	byte* p = vals->data() + oldsize;
+	if (4 == bytes) {
+		forEachValue(recBeg, num, [&](uint64_t x) {
+			unaligned_save<uint32_t>(p, uint32_t(x)); p += 4;
+		});
+	}
+	else {
+		forEachValue(recBeg, num, [&](uint64_t x) {
+			unaligned_save<uint64_t>(p, x); p += 8;
+		});
+	}
+}
+
+void FloatXorStore::getValueAppend(llong id, valvec<byte>* val, DbContext*) const {
+	assert(id >= 0);
+	assert(id < llong(m_rows));
+	getValueBatchAppend(size_t(id), 1, val);
+}
+
+StoreIterator* FloatXorStore::createStoreIterForward(DbContext*) const {
+	return new BatchStoreIterForward<FloatXorStore>(this);
+}
+
+StoreIterator* FloatXorStore::createStoreIterBackward(DbContext*) const {
+	return nullptr; // not needed
+}
+
+void FloatXorStore::build(ColumnType floatType, SortableStrVec& strVec) {
+	assert(strVec.m_index.size() == 0);
+	m_floatType = floatType;
+	const size_t bytes = valueBytes();
+	const byte*  data = strVec.m_strpool.data();
+	m_rows = strVec.m_strpool.size() / bytes;
+	m_blockBitPos.resize_no_init((m_rows + BlockSize - 1) / BlockSize + 1);
+	m_data.erase_all();
+	XorBitWriter bw(m_data, 0);
+	uint64_t x[BlockSize];
+	for (size_t b = 0; b * BlockSize < m_rows; ++b) {
+		const size_t n = std::min(BlockSize, m_rows - b * BlockSize);
+		const byte*  src = data + bytes * BlockSize * b;
+		for (size_t i = 0; i < n; ++i) {
+			if (4 == bytes)
+				x[i] = unaligned_load<uint32_t>(src + 4*i);
+			else
+				x[i] = unaligned_load<uint64_t>(src + 8*i);
+		}
+		m_blockBitPos[b] = bw.m_bitpos;
+		encodeXorBlock(bw, x, n, bytes * 8);
+	}
+	m_blockBitPos.back() = bw.m_bitpos;
+	// padding for unaligned load
+	m_data.resize((bw.m_bitpos + 7) / 8 + sizeof(uint64_t), 0);
+	m_data.shrink_to_fit();
+#if !defined(NDEBUG)
+	valvec<byte> check;
+	getValueBatchAppend(0, m_rows, &check);
+	assert(check.size() == m_rows * bytes);
+	assert(memcmp(check.data(), data, check.size()) == 0);
+#endif
+}
+
+namespace {
+	struct FloatXorStoreHeader {
+		uint64_t rows;
+		uint64_t blockNum;
+		uint64_t dataBytes;
+		uint8_t  floatType;
+		uint8_t  padding1;
+		uint16_t padding2;
+		uint32_t padding3;
+	};
+	BOOST_STATIC_ASSERT(sizeof(FloatXorStoreHeader) == 32);
+}
+
+TERARK_DB_REGISTER_STORE("fxor", FloatXorStore);
+
+void FloatXorStore::load(PathRef fpath) {
+	assert(fstring(fpath.string()).endsWith(".fxor"));
+	m_mmapBase = (byte_t*)mmap_load(fpath.string(), &m_mmapSize);
+	auto header = (const FloatXorStoreHeader*)m_mmapBase;
+	size_t posBytes = sizeof(uint64_t) * (header->blockNum + 1);
+	if (sizeof(*header) + posBytes + header->dataBytes > m_mmapSize) {
+		THROW_STD(invalid_argument, "path=%s, broken data: fileSize=%zd"
+			, fpath.string().c_str(), m_mmapSize);
+	}
+	m_rows = header->rows;
+	m_floatType = ColumnType(header->floatType);
+	m_blockBitPos.risk_set_data((uint64_t*)(header + 1), header->blockNum + 1);
+	m_data.risk_set_data((byte*)(header + 1) + posBytes, header->dataBytes);
+}
+
+void FloatXorStore::save(PathRef path) const {
+	auto fpath = path + ".fxor";
+	NativeDataOutput<FileStream> dio;
+	dio.open(fpath.string().c_str(), "wb");
+	FloatXorStoreHeader header;
+	header.rows = m_rows;
+	header.blockNum = m_blockBitPos.size() - 1;
+	header.dataBytes = m_data.size();
+	header.floatType = byte(m_floatType);
+	header.padding1 = 0;
+	header.padding2 = 0;
+	header.padding3 = 0;
+	dio.ensureWrite(&header, sizeof(header));
+	dio.ensureWrite(m_blockBitPos.data(), m_blockBitPos.used_mem_size());
+	dio.ensureWrite(m_data.data(), m_data.used_mem_size());
+}
+
+}} // namespace terark::db
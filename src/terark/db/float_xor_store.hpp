@@ -0,0 +1,56 @@
+#pragma once
+
+#include <terark/db/db_store.hpp>
+#include <terark/util/sortable_strvec.hpp>
+
+namespace terark { namespace db {
+
+// Gorilla style XOR compression for a single Float32/Float64 column:
+// each value is xor'ed with the previous one, zero xor takes 1 bit, else
+// only the meaningful bits between leading and trailing zeros are stored,
+// reusing the previous leading/trailing window when possible.
+//
+// Values are split into blocks of 128, getValueAppend decodes from the
+// start of its block, batch reads decode whole blocks sequentially.
+// Values are stored bitwise, NaN and -0.0 are kept as is.
+class TERARK_DB_DLL FloatXorStore : public ReadableStore {
+public:
+	static const size_t BlockSize = 128;
+
+	explicit FloatXorStore(const Schema& schema);
+	~FloatXorStore();
+
+	llong dataStorageSize() const override;
+	llong dataInflateSize() const override;
+	llong numDataRows() const override;
+	void getValueAppend(llong id, valvec<byte>* val, DbContext*) const override;
+	StoreIterator* createStoreIterForward(DbContext*) const override;
+	StoreIterator* createStoreIterBackward(DbContext*) const override;
+
+	///@{ batch read of contiguous ids [recBeg, recBeg+num)
+	/// Float32 is widened to double
+	void getFloat64Batch(size_t recBeg, size_t num, double* values) const;
+	/// values are appended in the format of getValueAppend
+	void getValueBatchAppend(size_t recBeg, size_t num, valvec<byte>* vals) const;
+	///@}
+
+	void build(ColumnType floatType, SortableStrVec& strVec);
+	void load(PathRef path) override;
+	void save(PathRef path) const override;
+
+protected:
+	valvec<uint64_t> m_blockBitPos; // numBlocks + 1
+	valvec<byte>     m_data;
+	size_t      m_rows;
+	byte_t*     m_mmapBase;
+	size_t      m_mmapSize;
+	ColumnType  m_floatType;
+
+	size_t valueBytes() const;
+	///@param bits of first n values of the block
+	void decodeBlock(size_t blockIdx, size_t n, uint64_t* bits) const;
+	template<class Visit>
+	void forEachValue(size_t recBeg, size_t num, Visit visit) const;
+};
+
+}} // namespace terark::db
@@ -0,0 +1,141 @@
+#include "index_stat.hpp"
+#include <terark/io/FileStream.hpp>
+#include <terark/io/StreamBuffer.hpp>
+#include <terark/io/DataIO.hpp>
+
+namespace terark { namespace db {
+
+IndexHistogram::IndexHistogram() {
+	m_rows = 0;
+	m_distinct = 0;
+	m_rowStart.push_back(0);
+	m_distinctStart.push_back(0);
+}
+IndexHistogram::~IndexHistogram() {
+}
+
+size_t IndexHistogram::getDefaultBucketNum() {
+	if (const char* env = getenv("TerarkDB_IndexHistogramBuckets")) {
+		return (size_t)strtoull(env, NULL, 10);
+	}
+	return 256;
+}
+
+///@param rows is just a hint for bucket depth
+void IndexHistogram::build(const Schema& schema, IndexIterator* iter,
+						   llong rows, size_t maxBuckets) {
+	m_bounds.erase_all();
+	m_rowStart.erase_all();
+	m_distinctStart.erase_all();
+	m_rows = 0;
+	m_distinct = 0;
+	llong buckets = std::max<llong>(1, llong(maxBuckets));
+	llong depth = std::max<llong>(1, (rows + buckets - 1) / buckets);
+	llong bucketBeg = 0;
+	llong recId = -1;
+	valvec<byte> key, prev;
+	while (iter->increment(&recId, &key)) {
+		bool isNewKey = 0 == m_rows || fstring(key) != fstring(prev);
+		if (isNewKey) {
+			assert(0 == m_rows || schema.compareData(prev, key) < 0);
+			// a bucket begins only at the first occurrence of a key
+			if (0 == m_rows || m_rows - bucketBeg >= depth) {
+				m_bounds.push_back(fstring(key));
+				m_rowStart.push_back(m_rows);
+				m_distinctStart.push_back(m_distinct);
+				bucketBeg = m_rows;
+			}
+			m_distinct++;
+			prev.swap(key);
+		}
+		m_rows++;
+	}
+	if (m_rows) {
+		m_bounds.push_back(fstring(prev)); // max key
+	}
+	m_rowStart.push_back(m_rows);
+	m_distinctStart.push_back(m_distinct);
+}
+
+size_t IndexHistogram::upperBound(const Schema& schema, fstring key) const {
+	size_t lo = 0, hi = bucketNum();
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (schema.compareData(m_bounds[mid], key) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+double IndexHistogram::estimateLess(const Schema& schema, fstring key) const {
+	if (0 == m_rows || key.empty())
+		return 0;
+	size_t b = upperBound(schema, key);
+	if (0 == b)
+		return 0;
+	size_t bucket = b - 1;
+	if (schema.compareData(m_bounds[bucket], key) == 0)
+		return double(m_rowStart[bucket]);
+	if (bucketNum() == b && schema.compareData(m_bounds[b], key) < 0)
+		return double(m_rows); // greater than max key
+	// keys are assumed uniformly distributed in the bucket
+	return m_rowStart[bucket] + (m_rowStart[b] - m_rowStart[bucket]) / 2.0;
+}
+
+double IndexHistogram::estimateRange(const Schema& schema, fstring lo, fstring hi)
+const {
+	double upp = hi.empty() ? double(m_rows) : estimateLess(schema, hi);
+	double low = estimateLess(schema, lo);
+	return upp > low ? upp - low : 0.0;
+}
+
+double IndexHistogram::estimateDistinct(const Schema& schema, fstring lo, fstring hi)
+const {
+	if (0 == m_rows)
+		return 0;
+	double rows = estimateRange(schema, lo, hi);
+	// scale by average duplicate count of the covered buckets
+	size_t b0 = lo.empty() ? 0 : upperBound(schema, lo);
+	size_t b1 = hi.empty() ? bucketNum() : upperBound(schema, hi);
+	b0 = b0 ? b0 - 1 : 0;
+	b1 = std::max(b1, b0 + 1);
+	llong r = m_rowStart[b1] - m_rowStart[b0];
+	llong d = m_distinctStart[b1] - m_distinctStart[b0];
+	return r ? rows * d / r : 0.0;
+}
+
+void IndexHistogram::load(PathRef fpath) {
+	FileStream fp(fpath.string().c_str(), "rb");
+	fp.disbuf();
+	NativeDataInput<InputBuffer> dio; dio.attach(&fp);
+	uint64_t rows, distinct;
+	dio >> rows;
+	dio >> distinct;
+	dio >> m_bounds;
+	dio >> m_rowStart;
+	dio >> m_distinctStart;
+	m_rows = llong(rows);
+	m_distinct = llong(distinct);
+	if (m_rowStart.size() != m_distinctStart.size() ||
+		m_rowStart.empty() || m_rowStart.back() != m_rows ||
+		(m_rows && m_bounds.size() != m_rowStart.size()))
+	{
+		THROW_STD(invalid_argument, "path=%s, broken data: rows=%lld buckets=%zd",
+			fpath.string().c_str(), m_rows, m_bounds.size());
+	}
+}
+
+void IndexHistogram::save(PathRef fpath) const {
+	FileStream fp(fpath.string().c_str(), "wb");
+	fp.disbuf();
+	NativeDataOutput<OutputBuffer> dio; dio.attach(&fp);
+	dio << uint64_t(m_rows);
+	dio << uint64_t(m_distinct);
+	dio << m_bounds;
+	dio << m_rowStart;
+	dio << m_distinctStart;
+}
+
+} } // namespace terark::db
@@ -0,0 +1,50 @@
+#ifndef __terark_db_index_stat_hpp__
+#define __terark_db_index_stat_hpp__
+
+#include "db_index.hpp"
+#include <terark/util/fstrvec.hpp>
+
+namespace terark { namespace db {
+
+// Equi-depth histogram of an ordered index in a readonly segment, built
+// when the index is built and saved as "index-<name>.hist"
+//
+// A bucket begins at the first occurrence of its bound key, so the number
+// of keys less than a bound is exact, keys inside a bucket are estimated
+class TERARK_DB_DLL IndexHistogram : public RefCounter {
+public:
+	fstrvec        m_bounds;        // first key of each bucket, and max key
+	valvec<llong>  m_rowStart;      // size = buckets + 1, back() = m_rows
+	valvec<llong>  m_distinctStart; // size = buckets + 1, back() = m_distinct
+	llong          m_rows;
+	llong          m_distinct;
+
+	IndexHistogram();
+	~IndexHistogram();
+
+	size_t bucketNum() const { return m_rowStart.size() - 1; }
+
+	void build(const Schema&, IndexIterator* iter, llong rows, size_t maxBuckets);
+
+	///@{ estimated number of keys which are less than key
+	double estimateLess(const Schema&, fstring key) const;
+	///@}
+
+	///@{ keys in [lo, hi), empty lo is min key, empty hi is max key
+	double estimateRange(const Schema&, fstring lo, fstring hi) const;
+	double estimateDistinct(const Schema&, fstring lo, fstring hi) const;
+	///@}
+
+	void load(PathRef fpath);
+	void save(PathRef fpath) const;
+
+	static size_t getDefaultBucketNum();
+
+private:
+	size_t upperBound(const Schema&, fstring key) const;
+};
+typedef boost::intrusive_ptr<IndexHistogram> IndexHistogramPtr;
+
+} } // namespace terark::db
+
+#endif // __terark_db_index_stat_hpp__
@@ -3,6 +3,7 @@
 #include <terark/io/FileStream.hpp>
 #include <terark/io/DataIO.hpp>
 #include <terark/util/mmap.hpp>
+#include <terark/bitmanip.hpp>
 
 namespace terark { namespace db {
 
@@ -12,6 +13,10 @@ ZipIntKeyIndex::ZipIntKeyIndex() {
 	m_isOrdered = true;
 	m_mmapBase = nullptr;
 	m_mmapSize = 0;
+	m_sampleKeys = nullptr;
+	m_sampleRank = nullptr;
+	m_sampleNum = 0;
+	m_sampleShift = 0;
 }
 ZipIntKeyIndex::~ZipIntKeyIndex() {
 	if (m_mmapBase) {
@@ -31,7 +36,30 @@ ReadableStore* ZipIntKeyIndex::getReadableStore() {
 
 ///@{ ordered and unordered index
 llong ZipIntKeyIndex::indexStorageSize() const {
-	return m_keys.mem_size() + m_index.mem_size();
+	return m_keys.mem_size() + m_index.mem_size()
+		+ (m_sampleShift ? (m_sampleNum + 1) * 12 : 0);
+}
+
+// narrow [*lo, *hi) to the block of (1<<m_sampleShift) sorted positions
+// which contains lower_bound(key), only touch O(log(rows>>shift)) samples
+// in Eytzinger layout, which is cache/prefetch friendly
+void ZipIntKeyIndex::accelNarrow(size_t key, size_t* lo, size_t* hi) const {
+	assert(m_sampleShift > 0);
+	const uint64_t* eyt = m_sampleKeys;
+	const size_t ns = m_sampleNum;
+	size_t k = 1;
+	while (k <= ns) {
+		k = 2 * k + (eyt[k] < key);
+	}
+	k >>= fast_ctz64(~uint64_t(k)) + 1;
+	size_t t = k ? m_sampleRank[k] : ns; // first sample >= key
+	if (0 == t) {
+		*lo = *hi = 0;
+	}
+	else {
+		*lo = ((t - 1) << m_sampleShift) + 1;
+		*hi = t < ns ? t << m_sampleShift : m_index.size();
+	}
 }
 
 template<class Int>
@@ -52,6 +80,9 @@ ZipIntKeyIndex::IntVecLowerBound(fstring binkey) const {
 	size_t hitPos = 0;
 	size_t hitKey = 0;
 	size_t i = 0, j = m_index.size();
+	if (m_sampleShift) {
+		accelNarrow(key, &i, &j);
+	}
 	while (i < j) {
 		size_t mid = (i + j) / 2;
 		hitPos = UintVecMin0::fast_get(indexData, indexBits, indexMask, mid);
@@ -113,6 +144,29 @@ ZipIntKeyIndex::IntVecEqualRange(fstring binkey) const {
 	size_t key = size_t(rawkey - Int(m_minKey));
 	size_t i = 0, j = m_index.size();
 	size_t mid = 0;
+	if (m_sampleShift) {
+		auto lowerBound = [&](size_t k, size_t lo, size_t hi) {
+			accelNarrow(k, &lo, &hi);
+			while (lo < hi) {
+				size_t mid2 = (lo + hi) / 2;
+				size_t hitPos = UintVecMin0::fast_get(indexData, indexBits, indexMask, mid2);
+				size_t hitKey = UintVecMin0::fast_get(keysData, keysBits, keysMask, hitPos);
+				if (hitKey < k)
+					lo = mid2 + 1;
+				else
+					hi = mid2;
+			}
+			return lo;
+		};
+		i = lowerBound(key, 0, j);
+		if (i == j || UintVecMin0::fast_get(keysData, keysBits, keysMask,
+			UintVecMin0::fast_get(indexData, indexBits, indexMask, i)) != key) {
+			return std::make_pair(i, i);
+		}
+		if (key < keysMask)
+			j = lowerBound(key + 1, 0, j); // upper_bound(key)
+		return std::make_pair(i, j);
+	}
 	while (i < j) {
 		mid = (i + j) / 2;
 		size_t hitPos = UintVecMin0::fast_get(indexData, indexBits, indexMask, mid);
@@ -252,6 +306,15 @@ void ZipIntKeyIndex::zipKeys(const void* data, size_t size) {
 #endif
 }
 
+static int getDefaultSampleShift() {
+	static int shift = []() {
+		if (const char* env = getenv("TerarkDB_ZipIntKeyIndexSampleShift"))
+			return atoi(env);
+		return 6; // one sample per 64 keys
+	}();
+	return shift;
+}
+
 void ZipIntKeyIndex::build(ColumnType keyType, SortableStrVec& strVec) {
 	assert(strVec.m_index.size() == 0);
 	m_keyType = keyType;
@@ -304,6 +367,7 @@ void ZipIntKeyIndex::build(ColumnType keyType, SortableStrVec& strVec) {
 	});
 	auto minIdx = m_index.build_from(index);
 	(void)minIdx;
+	buildSearchAccel(getDefaultSampleShift());
 #if !defined(NDEBUG)
 	assert(0 == minIdx);
 	for(size_t i = 1; i < m_index.size(); ++i) {
@@ -316,16 +380,62 @@ void ZipIntKeyIndex::build(ColumnType keyType, SortableStrVec& strVec) {
 #endif
 }
 
+static void
+fillEytzinger(const valvec<uint64_t>& sorted, size_t* i, size_t k,
+			  uint64_t* eyt, uint32_t* rank) {
+	if (k <= sorted.size()) {
+		fillEytzinger(sorted, i, 2 * k, eyt, rank);
+		eyt[k] = sorted[*i];
+		rank[k] = uint32_t(*i);
+		++*i;
+		fillEytzinger(sorted, i, 2 * k + 1, eyt, rank);
+	}
+}
+
+// sampleShift == 0 or too few rows: disable accelerator
+void ZipIntKeyIndex::buildSearchAccel(int sampleShift) {
+	m_sampleMem.clear();
+	m_sampleKeys = nullptr;
+	m_sampleRank = nullptr;
+	m_sampleNum = 0;
+	m_sampleShift = 0;
+	size_t rows = m_index.size();
+	if (sampleShift <= 0 || sampleShift >= 32 || rows <= (size_t(2) << sampleShift)) {
+		return;
+	}
+	size_t ns = (rows + (size_t(1) << sampleShift) - 1) >> sampleShift;
+	valvec<uint64_t> sorted(ns, valvec_no_init());
+	for (size_t t = 0; t < ns; ++t) {
+		size_t pos = m_index.get(t << sampleShift);
+		sorted[t] = m_keys.get(pos);
+	}
+	m_sampleMem.resize(12 * (ns + 1));
+	uint64_t* eyt = (uint64_t*)m_sampleMem.data();
+	uint32_t* rank = (uint32_t*)(eyt + ns + 1);
+	eyt[0] = 0; // unused
+	rank[0] = 0;
+	size_t i = 0;
+	fillEytzinger(sorted, &i, 1, eyt, rank);
+	assert(i == ns);
+	m_sampleKeys = eyt;
+	m_sampleRank = rank;
+	m_sampleNum = ns;
+	m_sampleShift = sampleShift;
+}
+
 namespace {
 	struct Header {
 		uint32_t rows;
 		uint8_t  keyBits;
 		uint8_t  keyType;
 		uint8_t  isUnique;
-		uint8_t  padding;
+		uint8_t  sampleShift; // 0 for no search accelerator(old format)
 		 int64_t minKey;
 	};
 	BOOST_STATIC_ASSERT(sizeof(Header) == 16);
+	inline size_t sampleOffset(size_t keysMemSize, size_t indexMemSize) {
+		return align_up(sizeof(Header) + keysMemSize + indexMemSize, 8);
+	}
 }
 
 void ZipIntKeyIndex::load(PathRef path) {
@@ -338,6 +448,27 @@ void ZipIntKeyIndex::load(PathRef path) {
 	size_t indexBits = terark_bsr_u64(h->rows - 1) + 1;
 	m_keys .risk_set_data((byte*)(h+1)                    , h->rows, h->keyBits);
 	m_index.risk_set_data((byte*)(h+1) + m_keys.mem_size(), h->rows,  indexBits);
+	m_sampleMem.clear();
+	m_sampleKeys = nullptr;
+	m_sampleRank = nullptr;
+	m_sampleNum = 0;
+	m_sampleShift = 0;
+	if (h->sampleShift) {
+		size_t shift = h->sampleShift;
+		size_t ns = (h->rows + (size_t(1) << shift) - 1) >> shift;
+		size_t offset = sampleOffset(m_keys.mem_size(), m_index.mem_size());
+		if (offset + 12 * (ns + 1) <= m_mmapSize) {
+			m_sampleKeys = (const uint64_t*)(m_mmapBase + offset);
+			m_sampleRank = (const uint32_t*)(m_sampleKeys + ns + 1);
+			m_sampleNum = ns;
+			m_sampleShift = int(shift);
+		}
+		else {
+			fprintf(stderr
+				, "WARN: ZipIntKeyIndex::load(%s): truncated search accelerator, ignored\n"
+				, fpath.string().c_str());
+		}
+	}
 }
 
 void ZipIntKeyIndex::save(PathRef path) const {
@@ -349,11 +480,19 @@ void ZipIntKeyIndex::save(PathRef path) const {
 	h.keyBits  = m_keys.uintbits();
 	h.keyType  = uint8_t(m_keyType);
 	h.isUnique = m_isUnique;
-	h.padding  = 0;
+	h.sampleShift = uint8_t(m_sampleShift);
 	h.minKey   = m_minKey;
 	dio.ensureWrite(&h, sizeof(h));
 	dio.ensureWrite(m_keys .data(), m_keys .mem_size());
 	dio.ensureWrite(m_index.data(), m_index.mem_size());
+	if (m_sampleShift) {
+		size_t pos = sizeof(h) + m_keys.mem_size() + m_index.mem_size();
+		size_t offset = sampleOffset(m_keys.mem_size(), m_index.mem_size());
+		static const byte_t zeros[8] = {0};
+		dio.ensureWrite(zeros, offset - pos);
+		dio.ensureWrite(m_sampleKeys, 8 * (m_sampleNum + 1));
+		dio.ensureWrite(m_sampleRank, 4 * (m_sampleNum + 1));
+	}
 }
 
 class ZipIntKeyIndex::MyIndexIterForward : public IndexIterator {
@@ -32,6 +32,7 @@ public:
 	StoreIterator* createStoreIterBackward(DbContext*) const override;
 
 	void build(ColumnType keyType, SortableStrVec& strVec);
+	void buildSearchAccel(int sampleShift);
 	void load(PathRef path) override;
 	void save(PathRef path) const override;
 
@@ -43,6 +44,16 @@ protected:
 	llong       m_minKey; // may be unsigned
 	ColumnType  m_keyType;
 
+	// search accelerator: key of every (1<<m_sampleShift)-th sorted position,
+	// in Eytzinger(BFS) order, 1-based, m_sampleShift == 0 means no accel
+	const uint64_t* m_sampleKeys;
+	const uint32_t* m_sampleRank; // m_sampleRank[k] = sorted idx of sample
+	size_t      m_sampleNum;
+	int         m_sampleShift;
+	valvec<byte_t> m_sampleMem; // owns memory when not mmap
+
+	void accelNarrow(size_t key, size_t* lo, size_t* hi) const;
+
 	template<class Int>
 	std::pair<size_t, bool> IntVecLowerBound(fstring binkey) const;
 	std::pair<size_t, bool> searchLowerBound(fstring binkey) const;
@@ -37,9 +37,21 @@ const {
 		val->append(m_rows[id]);
 	}
 }
+bool
+MockReadonlyStore::getValueView(llong id, fstring* view, DbContext*)
+const {
+	assert(id >= 0);
+	if (m_fixedLen) {
+		assert(id < llong(m_rows.strpool.size() / m_fixedLen));
+		*view = fstring(m_rows.strpool.data() + m_fixedLen * id, m_fixedLen);
+	} else {
+		assert(id < llong(m_rows.size()));
+		*view = m_rows[id];
+	}
+	return true;
+}
 StoreIterator* MockReadonlyStore::createStoreIterForward(DbContext*) const {
-	assert(0); // should not be called
-	return nullptr;
+	return nullptr; // use default iterator
 }
 StoreIterator* MockReadonlyStore::createStoreIterBackward(DbContext*) const {
 	assert(0); // should not be called
@@ -286,8 +298,7 @@ MockReadonlyIndex::~MockReadonlyIndex() {
 }
 
 StoreIterator* MockReadonlyIndex::createStoreIterForward(DbContext*) const {
-	assert(!"Readonly column store did not define iterator");
-	return nullptr;
+	return nullptr; // use default iterator
 }
 StoreIterator* MockReadonlyIndex::createStoreIterBackward(DbContext*) const {
 	assert(!"Readonly column store did not define iterator");
@@ -306,15 +317,9 @@ MockReadonlyIndex::build(SortableStrVec& keys) {
 	if (fixlen) {
 		assert(keys.m_index.size() == 0);
 		assert(keys.str_size() % fixlen == 0);
-		m_ids.resize_no_init(keys.str_size() / fixlen);
-		for (size_t i = 0; i < m_ids.size(); ++i) m_ids[i] = i;
-		std::sort(m_ids.begin(), m_ids.end(), [=](size_t x, size_t y) {
-			fstring xs(base + fixlen * x, fixlen);
-			fstring ys(base + fixlen * y, fixlen);
-			int r = schema->compareData(xs, ys);
-			if (r) return r < 0;
-			else   return x < y;
-		});
+		schema->sortKeyIds(keys.str_size() / fixlen, [=](size_t i) {
+			return fstring(base + fixlen * i, fixlen);
+		}, &m_ids);
 	}
 	else {
 		if (keys.str_size() >= UINT32_MAX) {
@@ -324,22 +329,14 @@ MockReadonlyIndex::build(SortableStrVec& keys) {
 		// reuse memory of keys.m_index
 		auto offsets = (uint32_t*)keys.m_index.data();
 		size_t rows = keys.m_index.size();
-		m_ids.resize_no_init(rows);
-		for (size_t i = 0; i < rows; ++i) m_ids[i] = i;
 		for (size_t i = 0; i < rows; ++i) {
 			uint32_t offset = uint32_t(keys.m_index[i].offset);
 			offsets[i] = offset;
 		}
 		offsets[rows] = keys.str_size();
-		std::sort(m_ids.begin(), m_ids.end(), [=](size_t x, size_t y) {
-			size_t xoff0 = offsets[x], xoff1 = offsets[x+1];
-			size_t yoff0 = offsets[y], yoff1 = offsets[y+1];
-			fstring xs(base + xoff0, xoff1 - xoff0);
-			fstring ys(base + yoff0, yoff1 - yoff0);
-			int r = schema->compareData(xs, ys);
-			if (r) return r < 0;
-			else   return x < y;
-		});
+		schema->sortKeyIds(rows, [=](size_t i) {
+			return fstring(base + offsets[i], offsets[i+1] - offsets[i]);
+		}, &m_ids);
 		BOOST_STATIC_ASSERT(sizeof(SortableStrVec::SEntry) == 4*3);
 		m_keys.offsets.risk_set_data(offsets);
 		m_keys.offsets.risk_set_size(rows + 1);
@@ -424,6 +421,20 @@ const {
 	}
 }
 
+bool
+MockReadonlyIndex::getValueView(llong id, fstring* key, DbContext*)
+const {
+	assert(id < (llong)m_ids.size());
+	assert(id >= 0);
+	if (m_fixedLen) {
+		*key = fstring(m_keys.strpool.data() + m_fixedLen * id, m_fixedLen);
+	}
+	else {
+		*key = m_keys[id];
+	}
+	return true;
+}
+
 void
 MockReadonlyIndex::searchExactAppend(fstring key, valvec<llong>* recIdvec, DbContext*)
 const {
@@ -575,11 +586,14 @@ llong MockWritableStore::append(fstring row, DbContext*) {
 
 void MockWritableStore::update(llong id, fstring row, DbContext* ctx) {
 	assert(id >= 0);
-	assert(id <= llong(m_rows.size()));
 	if (llong(m_rows.size()) == id) {
 		append(row, ctx);
 		return;
 	}
+	if (llong(m_rows.size()) < id) {
+		// ids are reserved in batch by concurrent inserters
+		m_rows.resize(id + 1);
+	}
 	size_t oldsize = m_rows[id].size();
 	m_rows[id].assign(row);
 	m_dataSize -= oldsize;
@@ -24,6 +24,7 @@ public:
 	llong dataInflateSize() const override;
 	llong numDataRows() const override;
 	void getValueAppend(llong id, valvec<byte>* val, DbContext*) const;
+	bool getValueView(llong id, fstring* view, DbContext*) const override;
 	StoreIterator* createStoreIterForward(DbContext*) const override;
 	StoreIterator* createStoreIterBackward(DbContext*) const override;
 };
@@ -53,6 +54,7 @@ public:
 	llong dataStorageSize() const override;
 	llong dataInflateSize() const override;
 	void getValueAppend(llong id, valvec<byte>* key, DbContext*) const override;
+	bool getValueView(llong id, fstring* key, DbContext*) const override;
 
 	void searchExactAppend(fstring key, valvec<llong>* recIdvec, DbContext*) const override;
 
@@ -0,0 +1,491 @@
+#include "mph_index.hpp"
+#include <terark/io/FileStream.hpp>
+#include <terark/io/DataIO.hpp>
+#include <terark/util/mmap.hpp>
+#include <terark/bitmap.hpp>
+#include <math.h>
+
+namespace terark { namespace db {
+
+namespace {
+	inline uint64_t mixHash64(uint64_t x) {
+		x ^= x >> 31;
+		x *= 0x7fb5d329728ea185ULL;
+		x ^= x >> 27;
+		x *= 0x81dadef4bc2dd44dULL;
+		x ^= x >> 33;
+		return x;
+	}
+	uint64_t keyHash64(fstring key, uint64_t seed) {
+		const byte* p = key.udata();
+		size_t n = key.size();
+		uint64_t h = seed ^ (n * 0x9E3779B97F4A7C15ULL);
+		for (; n >= 8; n -= 8, p += 8) {
+			h = mixHash64(h ^ unaligned_load<uint64_t>(p));
+		}
+		if (n) {
+			uint64_t tail = 0;
+			memcpy(&tail, p, n);
+			h = mixHash64(h ^ tail);
+		}
+		return mixHash64(h ^ seed);
+	}
+	inline uint16_t fingerprintOf(uint64_t hash) {
+		return uint16_t(hash >> 48);
+	}
+	inline uint64_t pilotHash(size_t pilot, uint64_t seed) {
+		return mixHash64(pilot ^ seed);
+	}
+
+	const size_t MaxPilot = size_t(1) << 20;
+	const size_t MaxRetry = 16;
+}
+
+MinPerfectHashIndex::MinPerfectHashIndex() {
+	m_isOrdered = false;
+	m_mmapBase = nullptr;
+	m_mmapSize = 0;
+	m_fixedLen = 0;
+	m_uniqKeys = 0;
+	m_tableSize = 0;
+	m_numBuckets = 0;
+	m_seed = 0;
+}
+MinPerfectHashIndex::MinPerfectHashIndex(const Schema&) {
+	m_isOrdered = false;
+	m_mmapBase = nullptr;
+	m_mmapSize = 0;
+	m_fixedLen = 0;
+	m_uniqKeys = 0;
+	m_tableSize = 0;
+	m_numBuckets = 0;
+	m_seed = 0;
+}
+
+MinPerfectHashIndex::~MinPerfectHashIndex() {
+	if (m_mmapBase) {
+		m_strpool.risk_release_ownership();
+		m_offsets.risk_release_ownership();
+		m_pilots.risk_release_ownership();
+		m_remap.risk_release_ownership();
+		m_fingerprints.risk_release_ownership();
+		m_slotBeg.risk_release_ownership();
+		m_slotRecs.risk_release_ownership();
+		mmap_close(m_mmapBase, m_mmapSize);
+	}
+}
+
+ReadableStore* MinPerfectHashIndex::getReadableStore() {
+	return this;
+}
+
+ReadableIndex* MinPerfectHashIndex::getReadableIndex() {
+	return this;
+}
+
+fstring MinPerfectHashIndex::keyAt(size_t recId) const {
+	if (m_fixedLen) {
+		return fstring(m_strpool.data() + m_fixedLen * recId, m_fixedLen);
+	}
+	size_t beg = m_offsets.get(recId + 0);
+	size_t end = m_offsets.get(recId + 1);
+	return fstring(m_strpool.data() + beg, end - beg);
+}
+
+// skewed bucket assignment: 60% keys to 30% buckets
+size_t MinPerfectHashIndex::bucketOf(uint64_t hash) const {
+	assert(m_numBuckets >= 2);
+	const uint64_t p1 = UINT64_MAX / 10 * 6;
+	const size_t   p2 = std::max<size_t>(m_numBuckets * 3 / 10, 1);
+	uint64_t hb = mixHash64(hash);
+	if (hb < p1)
+		return size_t(hb % p2);
+	else
+		return p2 + size_t(hb % (m_numBuckets - p2));
+}
+
+size_t MinPerfectHashIndex::slotOf(uint64_t hash) const {
+	size_t pilot = m_pilots.get(bucketOf(hash));
+	size_t pos = size_t((hash ^ pilotHash(pilot, m_seed)) % m_tableSize);
+	if (pos >= m_uniqKeys) {
+		pos = m_remap.get(pos - m_uniqKeys);
+	}
+	return pos;
+}
+
+///@{ unordered index
+llong MinPerfectHashIndex::indexStorageSize() const {
+	return m_pilots.mem_size() + m_remap.mem_size()
+		+ m_fingerprints.used_mem_size()
+		+ m_slotBeg.mem_size() + m_slotRecs.mem_size();
+}
+
+void
+MinPerfectHashIndex::searchExactAppend(fstring key, valvec<llong>* recIdvec, DbContext*)
+const {
+	if (0 == m_uniqKeys) {
+		return;
+	}
+	if (m_fixedLen && key.size() != m_fixedLen) {
+		return;
+	}
+	uint64_t hash = keyHash64(key, m_seed);
+	size_t slot = slotOf(hash);
+	if (m_fingerprints[slot] != fingerprintOf(hash)) {
+		return;
+	}
+	if (m_slotBeg.size() == 0) {
+		size_t recId = m_slotRecs.get(slot);
+		if (keyAt(recId) == key)
+			recIdvec->push_back(recId);
+	}
+	else {
+		size_t beg = m_slotBeg.get(slot + 0);
+		size_t end = m_slotBeg.get(slot + 1);
+		assert(beg < end);
+		if (keyAt(m_slotRecs.get(beg)) != key)
+			return;
+		for (size_t j = beg; j < end; ++j)
+			recIdvec->push_back(m_slotRecs.get(j));
+	}
+}
+///@}
+
+IndexIterator* MinPerfectHashIndex::createIndexIterForward(DbContext*) const {
+	return nullptr; // unordered
+}
+IndexIterator* MinPerfectHashIndex::createIndexIterBackward(DbContext*) const {
+	return nullptr; // unordered
+}
+
+llong MinPerfectHashIndex::dataStorageSize() const {
+	return m_strpool.used_mem_size() + m_offsets.mem_size() + indexStorageSize();
+}
+
+llong MinPerfectHashIndex::dataInflateSize() const {
+	return m_strpool.size();
+}
+
+llong MinPerfectHashIndex::numDataRows() const {
+	return m_slotRecs.size();
+}
+
+void MinPerfectHashIndex::getValueAppend(llong id, valvec<byte>* val, DbContext*) const {
+	assert(id >= 0);
+	assert(size_t(id) < m_slotRecs.size());
+	val->append(keyAt(size_t(id)));
+}
+
+bool MinPerfectHashIndex::getValueView(llong id, fstring* view, DbContext*) const {
+	assert(id >= 0);
+	assert(size_t(id) < m_slotRecs.size());
+	*view = keyAt(size_t(id));
+	return true;
+}
+
+StoreIterator* MinPerfectHashIndex::createStoreIterForward(DbContext*) const {
+	return nullptr; // not needed
+}
+
+StoreIterator* MinPerfectHashIndex::createStoreIterBackward(DbContext*) const {
+	return nullptr; // not needed
+}
+
+void MinPerfectHashIndex::build(const Schema& schema, SortableStrVec& strVec) {
+	size_t rows;
+	if (strVec.m_index.size() == 0) {
+		size_t fixlen = schema.getFixedRowLen();
+		assert(fixlen > 0);
+		assert(strVec.m_strpool.size() % fixlen == 0);
+		rows = strVec.m_strpool.size() / fixlen;
+		m_fixedLen = fixlen;
+		m_strpool.clear();
+		m_strpool.swap(strVec.m_strpool);
+		m_offsets.clear();
+	}
+	else {
+		rows = strVec.size();
+		valvec<size_t> offsets(rows + 1, valvec_no_init());
+		m_fixedLen = 0;
+		m_strpool.clear();
+		m_strpool.reserve(strVec.str_size());
+		for (size_t i = 0; i < rows; ++i) {
+			assert(strVec.m_index[i].seq_id == i);
+			offsets[i] = m_strpool.size();
+			m_strpool.append(strVec[i]);
+		}
+		offsets[rows] = m_strpool.size();
+		m_offsets.build_from(offsets);
+		strVec.clear();
+	}
+	m_slotRecs.resize_with_wire_max_val(rows, size_t(rows ? rows - 1 : 0));
+	for (size_t retry = 0; ; ++retry) {
+		if (buildHash(mixHash64(retry + 0x5851F42D4C957F2DULL)))
+			break;
+		if (retry + 1 == MaxRetry) {
+			THROW_STD(runtime_error
+				, "MinPerfectHashIndex: build failed after %zd retries, rows = %zd"
+				, MaxRetry, rows);
+		}
+	}
+	m_isUnique = m_uniqKeys == rows;
+}
+
+// PTHash: keys are hashed into skewed buckets, buckets are placed in
+// descending size order, each bucket search a pilot which maps all its
+// keys to free positions of a table of size uniqKeys/0.98, positions
+// beyond uniqKeys are remapped to the holes, so the hash is minimal
+bool MinPerfectHashIndex::buildHash(uint64_t seed) {
+	const size_t rows = m_slotRecs.size();
+	valvec<uint64_t> hashes(rows, valvec_no_init());
+	for (size_t i = 0; i < rows; ++i) {
+		hashes[i] = keyHash64(keyAt(i), seed);
+	}
+	valvec<uint32_t> order(rows, valvec_no_init());
+	for (size_t i = 0; i < rows; ++i) order[i] = uint32_t(i);
+	std::sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) {
+		if (hashes[x] != hashes[y])
+			return hashes[x] < hashes[y];
+		int cmp = fstring_func::compare3()(keyAt(x), keyAt(y));
+		if (cmp)
+			return cmp < 0;
+		return x < y;
+	});
+	valvec<uint32_t> groupBeg; // groupBeg[g] is index into order
+	for (size_t i = 0; i < rows; ++i) {
+		if (0 == i || hashes[order[i]] != hashes[order[i-1]]) {
+			groupBeg.push_back(uint32_t(i));
+		}
+		else if (keyAt(order[i]) != keyAt(order[i-1])) {
+			return false; // 64 bit hash collision, retry with another seed
+		}
+	}
+	const size_t uniqKeys = groupBeg.size();
+	groupBeg.push_back(uint32_t(rows));
+	double lg = uniqKeys > 4 ? log2(double(uniqKeys)) : 2.0;
+	m_seed = seed;
+	m_uniqKeys = uniqKeys;
+	m_tableSize = uniqKeys + uniqKeys / 50 + 1;
+	m_numBuckets = std::max<size_t>(size_t(ceil(5.0 * uniqKeys / lg)), 2);
+
+	// counting sort groups by bucket, then buckets by size desc
+	valvec<uint32_t> bucketBeg(m_numBuckets + 1, 0);
+	valvec<uint32_t> groupBucket(uniqKeys, valvec_no_init());
+	for (size_t g = 0; g < uniqKeys; ++g) {
+		size_t b = bucketOf(hashes[order[groupBeg[g]]]);
+		groupBucket[g] = uint32_t(b);
+		bucketBeg[b + 1]++;
+	}
+	size_t maxBucketSize = 0;
+	for (size_t b = 0; b < m_numBuckets; ++b) {
+		maxBucketSize = std::max<size_t>(maxBucketSize, bucketBeg[b + 1]);
+		bucketBeg[b + 1] += bucketBeg[b];
+	}
+	valvec<uint32_t> bucketGroups(uniqKeys, valvec_no_init());
+	{
+		valvec<uint32_t> pos(bucketBeg.data(), m_numBuckets);
+		for (size_t g = 0; g < uniqKeys; ++g)
+			bucketGroups[pos[groupBucket[g]]++] = uint32_t(g);
+	}
+	valvec<uint32_t> sizeBeg(maxBucketSize + 2, 0);
+	for (size_t b = 0; b < m_numBuckets; ++b) {
+		size_t size = bucketBeg[b + 1] - bucketBeg[b];
+		sizeBeg[maxBucketSize - size + 1]++;
+	}
+	for (size_t s = 0; s <= maxBucketSize; ++s) sizeBeg[s + 1] += sizeBeg[s];
+	valvec<uint32_t> bucketOrder(m_numBuckets, valvec_no_init());
+	for (size_t b = 0; b < m_numBuckets; ++b) {
+		size_t size = bucketBeg[b + 1] - bucketBeg[b];
+		bucketOrder[sizeBeg[maxBucketSize - size]++] = uint32_t(b);
+	}
+
+	// search pilots
+	febitvec taken(m_tableSize, false);
+	valvec<size_t> pilots(m_numBuckets, 0);
+	valvec<size_t> groupPos(uniqKeys, valvec_no_init());
+	valvec<size_t> tmp;
+	size_t maxPilot = 0;
+	for (size_t k = 0; k < m_numBuckets; ++k) {
+		size_t b = bucketOrder[k];
+		size_t beg = bucketBeg[b], end = bucketBeg[b + 1];
+		if (beg == end)
+			break; // remaining buckets are all empty
+		size_t pilot = 0;
+		for (; pilot < MaxPilot; ++pilot) {
+			uint64_t ph = pilotHash(pilot, seed);
+			tmp.erase_all();
+			size_t j = beg;
+			for (; j < end; ++j) {
+				uint64_t hash = hashes[order[groupBeg[bucketGroups[j]]]];
+				size_t p = size_t((hash ^ ph) % m_tableSize);
+				if (taken.is1(p))
+					break;
+				tmp.push_back(p);
+			}
+			if (j < end)
+				continue;
+			std::sort(tmp.begin(), tmp.end());
+			if (std::adjacent_find(tmp.begin(), tmp.end()) == tmp.end())
+				break;
+		}
+		if (MaxPilot == pilot) {
+			return false;
+		}
+		uint64_t ph = pilotHash(pilot, seed);
+		for (size_t j = beg; j < end; ++j) {
+			size_t g = bucketGroups[j];
+			size_t p = size_t((hashes[order[groupBeg[g]]] ^ ph) % m_tableSize);
+			taken.set1(p);
+			groupPos[g] = p;
+		}
+		pilots[b] = pilot;
+		maxPilot = std::max(maxPilot, pilot);
+	}
+	m_pilots.resize_with_wire_max_val(m_numBuckets, maxPilot);
+	for (size_t b = 0; b < m_numBuckets; ++b) {
+		m_pilots.set_wire(b, pilots[b]);
+	}
+
+	// remap positions beyond uniqKeys to free slots
+	m_remap.resize_with_wire_max_val(m_tableSize - uniqKeys, uniqKeys);
+	for (size_t p = uniqKeys, freeSlot = 0; p < m_tableSize; ++p) {
+		if (taken.is1(p)) {
+			while (taken.is1(freeSlot)) ++freeSlot;
+			assert(freeSlot < uniqKeys);
+			m_remap.set_wire(p - uniqKeys, freeSlot++);
+		}
+		else {
+			m_remap.set_wire(p - uniqKeys, 0); // absent keys only
+		}
+	}
+
+	// fingerprints and recIds of each slot
+	m_fingerprints.resize_no_init(uniqKeys);
+	valvec<size_t> slotBeg;
+	if (uniqKeys != rows) {
+		slotBeg.resize(uniqKeys + 1, 0);
+		for (size_t g = 0; g < uniqKeys; ++g) {
+			size_t p = groupPos[g];
+			size_t slot = p < uniqKeys ? p : m_remap.get(p - uniqKeys);
+			slotBeg[slot + 1] = groupBeg[g + 1] - groupBeg[g];
+		}
+		for (size_t s = 0; s < uniqKeys; ++s) slotBeg[s + 1] += slotBeg[s];
+	}
+	for (size_t g = 0; g < uniqKeys; ++g) {
+		size_t p = groupPos[g];
+		size_t slot = p < uniqKeys ? p : m_remap.get(p - uniqKeys);
+		m_fingerprints[slot] = fingerprintOf(hashes[order[groupBeg[g]]]);
+		size_t base = slotBeg.empty() ? slot : slotBeg[slot];
+		for (size_t j = groupBeg[g]; j < groupBeg[g + 1]; ++j) {
+			m_slotRecs.set_wire(base + j - groupBeg[g], order[j]);
+		}
+	}
+	if (slotBeg.empty())
+		m_slotBeg.clear();
+	else
+		m_slotBeg.build_from(slotBeg);
+	return true;
+}
+
+namespace {
+	struct Header {
+		uint64_t rows;
+		uint64_t uniqKeys;
+		uint64_t seed;
+		uint64_t tableSize;
+		uint64_t numBuckets;
+		uint64_t strpoolSize;
+		uint32_t fixlen;
+		uint8_t  offsetBits;
+		uint8_t  pilotBits;
+		uint8_t  remapBits;
+		uint8_t  slotBegBits;
+		uint8_t  recIdBits;
+		uint8_t  padding[7];
+	};
+	BOOST_STATIC_ASSERT(sizeof(Header) == 64);
+
+	std::string mphFilePath(PathRef path) {
+		std::string fpath = path.string();
+		if (!fstring(fpath).endsWith(".mph")) {
+			fpath += ".mph";
+		}
+		return fpath;
+	}
+}
+
+void MinPerfectHashIndex::load(PathRef path) {
+	auto fpath = mphFilePath(path);
+	m_mmapBase = (byte_t*)mmap_load(fpath, &m_mmapSize);
+	auto h = (const Header*)m_mmapBase;
+	m_uniqKeys   = size_t(h->uniqKeys);
+	m_seed       = h->seed;
+	m_tableSize  = size_t(h->tableSize);
+	m_numBuckets = size_t(h->numBuckets);
+	m_fixedLen   = h->fixlen;
+	m_isUnique   = h->uniqKeys == h->rows;
+	size_t rows = size_t(h->rows);
+	byte_t* pos = (byte_t*)(h + 1);
+	m_strpool.risk_set_data(pos, size_t(h->strpoolSize));
+	pos += align_up(h->strpoolSize, 16);
+	if (0 == m_fixedLen) {
+		m_offsets.risk_set_data(pos, rows + 1, h->offsetBits);
+		pos += m_offsets.mem_size();
+	}
+	m_pilots.risk_set_data(pos, m_numBuckets, h->pilotBits);
+	pos += m_pilots.mem_size();
+	m_remap.risk_set_data(pos, m_tableSize - m_uniqKeys, h->remapBits);
+	pos += m_remap.mem_size();
+	m_fingerprints.risk_set_data((uint16_t*)pos, m_uniqKeys);
+	pos += align_up(m_fingerprints.used_mem_size(), 16);
+	if (!m_isUnique) {
+		m_slotBeg.risk_set_data(pos, m_uniqKeys + 1, h->slotBegBits);
+		pos += m_slotBeg.mem_size();
+	}
+	m_slotRecs.risk_set_data(pos, rows, h->recIdBits);
+	pos += m_slotRecs.mem_size();
+	if (size_t(pos - m_mmapBase) > m_mmapSize) {
+		THROW_STD(invalid_argument, "file is truncated: %s", fpath.c_str());
+	}
+}
+
+void MinPerfectHashIndex::save(PathRef path) const {
+	auto fpath = mphFilePath(path);
+	NativeDataOutput<FileStream> dio;
+	dio.open(fpath.c_str(), "wb");
+	Header h;
+	memset(&h, 0, sizeof(h));
+	h.rows        = m_slotRecs.size();
+	h.uniqKeys    = m_uniqKeys;
+	h.seed        = m_seed;
+	h.tableSize   = m_tableSize;
+	h.numBuckets  = m_numBuckets;
+	h.strpoolSize = m_strpool.size();
+	h.fixlen      = uint32_t(m_fixedLen);
+	h.offsetBits  = uint8_t(m_offsets.uintbits());
+	h.pilotBits   = uint8_t(m_pilots.uintbits());
+	h.remapBits   = uint8_t(m_remap.uintbits());
+	h.slotBegBits = uint8_t(m_slotBeg.uintbits());
+	h.recIdBits   = uint8_t(m_slotRecs.uintbits());
+	dio.ensureWrite(&h, sizeof(h));
+	byte zero[16];
+	memset(zero, 0, sizeof(zero));
+	auto writeAligned = [&](const void* data, size_t size) {
+		dio.ensureWrite(data, size);
+		if (size % 16 != 0)
+			dio.ensureWrite(zero, 16 - size % 16);
+	};
+	writeAligned(m_strpool.data(), m_strpool.used_mem_size());
+	if (0 == m_fixedLen)
+		dio.ensureWrite(m_offsets.data(), m_offsets.mem_size());
+	dio.ensureWrite(m_pilots.data(), m_pilots.mem_size());
+	dio.ensureWrite(m_remap.data(), m_remap.mem_size());
+	writeAligned(m_fingerprints.data(), m_fingerprints.used_mem_size());
+	if (!m_isUnique)
+		dio.ensureWrite(m_slotBeg.data(), m_slotBeg.mem_size());
+	dio.ensureWrite(m_slotRecs.data(), m_slotRecs.mem_size());
+}
+
+TERARK_DB_REGISTER_STORE("mph", MinPerfectHashIndex);
+
+}} // namespace terark::db
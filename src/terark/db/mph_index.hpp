@@ -0,0 +1,67 @@
+#pragma once
+
+#include <terark/db/db_index.hpp>
+#include <terark/int_vector.hpp>
+#include <terark/util/sortable_strvec.hpp>
+
+namespace terark { namespace db {
+
+// Unordered index for readonly segments, used when index schema is
+// "ordered": false. A PTHash-style minimal perfect hash maps each distinct
+// key to a slot, a 16 bit fingerprint per slot rejects most absent keys
+// without touching the key data.
+//
+// searchExact: key hash -> bucket pilot -> slot -> fingerprint -> recId
+class TERARK_DB_DLL MinPerfectHashIndex : public ReadableIndex, public ReadableStore {
+public:
+	MinPerfectHashIndex();
+	explicit MinPerfectHashIndex(const Schema&);
+	~MinPerfectHashIndex();
+
+	///@{ unordered index
+	llong indexStorageSize() const override;
+
+	void searchExactAppend(fstring key, valvec<llong>* recIdvec, DbContext*) const override;
+	///@}
+
+	IndexIterator* createIndexIterForward(DbContext*) const override;
+	IndexIterator* createIndexIterBackward(DbContext*) const override;
+
+	ReadableStore* getReadableStore() override;
+	ReadableIndex* getReadableIndex() override;
+
+	llong dataStorageSize() const override;
+	llong dataInflateSize() const override;
+	llong numDataRows() const override;
+	void getValueAppend(llong id, valvec<byte>* val, DbContext*) const override;
+	bool getValueView(llong id, fstring* view, DbContext*) const override;
+	StoreIterator* createStoreIterForward(DbContext*) const override;
+	StoreIterator* createStoreIterBackward(DbContext*) const override;
+
+	void build(const Schema& schema, SortableStrVec& strVec);
+	void load(PathRef path) override;
+	void save(PathRef path) const override;
+
+protected:
+	valvec<byte>     m_strpool;      // keys in recId order
+	UintVecMin0      m_offsets;      // var len keys only, size = rows + 1
+	UintVecMin0      m_pilots;       // pilot of each bucket
+	UintVecMin0      m_remap;        // table pos >= m_uniqKeys to a free slot
+	valvec<uint16_t> m_fingerprints; // fingerprint of each slot
+	UintVecMin0      m_slotBeg;      // empty if m_isUnique
+	UintVecMin0      m_slotRecs;     // recIds of each slot
+	byte_t*          m_mmapBase;
+	size_t           m_mmapSize;
+	size_t           m_fixedLen;     // 0 for var len keys
+	size_t           m_uniqKeys;
+	size_t           m_tableSize;
+	size_t           m_numBuckets;
+	uint64_t         m_seed;
+
+	fstring keyAt(size_t recId) const;
+	size_t  bucketOf(uint64_t hash) const;
+	size_t  slotOf(uint64_t hash) const;
+	bool    buildHash(uint64_t seed);
+};
+
+}} // namespace terark::db
@@ -0,0 +1,185 @@
+#include "run_len_store.hpp"
+#include <terark/io/FileStream.hpp>
+#include <terark/io/DataIO.hpp>
+#include <terark/util/mmap.hpp>
+
+namespace terark { namespace db {
+
+RunLenStore::RunLenStore(const Schema& schema) {
+	m_mmapBase = nullptr;
+	m_mmapSize = 0;
+	m_fixlen = schema.getFixedRowLen();
+	m_inflateSize = 0;
+}
+RunLenStore::~RunLenStore() {
+	if (m_mmapBase) {
+		m_runBits.risk_release_ownership();
+		m_offsets.risk_release_ownership();
+		m_values.risk_release_ownership();
+		mmap_close(m_mmapBase, m_mmapSize);
+	}
+}
+
+double RunLenStore::getMaxRunRatio() {
+	if (const char* env = getenv("TerarkDB_RunLenStoreMaxRatio")) {
+		return strtod(env, NULL);
+	}
+	return 0.1;
+}
+
+llong RunLenStore::dataStorageSize() const {
+	return m_runBits.mem_size() + m_offsets.mem_size() + m_values.used_mem_size();
+}
+
+llong RunLenStore::dataInflateSize() const {
+	return m_inflateSize;
+}
+
+llong RunLenStore::numDataRows() const {
+	return m_runBits.size() - 1;
+}
+
+fstring RunLenStore::runValue(size_t run) const {
+	assert(run < numRuns());
+	if (m_fixlen) {
+		return fstring(m_values.data() + m_fixlen * run, m_fixlen);
+	}
+	size_t beg = m_offsets.get(run);
+	size_t end = m_offsets.get(run + 1);
+	return fstring(m_values.data() + beg, end - beg);
+}
+
+void RunLenStore::getValueAppend(llong id, valvec<byte>* val, DbContext*) const {
+	assert(id >= 0);
+	assert(id < numDataRows());
+	val->append(runValue(runOf(size_t(id))));
+}
+
+StoreIterator* RunLenStore::createStoreIterForward(DbContext*) const {
+	return nullptr; // not needed
+}
+
+StoreIterator* RunLenStore::createStoreIterBackward(DbContext*) const {
+	return nullptr; // not needed
+}
+
+size_t RunLenStore::countRuns(const Schema& schema,
+							  const SortableStrVec& strVec, size_t maxRuns) {
+	const size_t fixlen = schema.getFixedRowLen();
+	if (strVec.m_index.size() == 0) {
+		if (0 == fixlen)
+			return 0;
+		const byte* data = strVec.m_strpool.data();
+		const size_t rows = strVec.m_strpool.size() / fixlen;
+		size_t runs = rows ? 1 : 0;
+		for (size_t i = 1; i < rows && runs <= maxRuns; ++i) {
+			runs += memcmp(data + fixlen * (i-1), data + fixlen * i, fixlen) != 0;
+		}
+		return runs;
+	}
+	const size_t rows = strVec.m_index.size();
+	size_t runs = rows ? 1 : 0;
+	for (size_t i = 1; i < rows && runs <= maxRuns; ++i) {
+		runs += strVec[i-1] != strVec[i];
+	}
+	return runs;
+}
+
+bool
+RunLenStore::build(const Schema& schema, SortableStrVec& strVec, size_t maxRuns) {
+	if (countRuns(schema, strVec, maxRuns) > maxRuns) {
+		return false;
+	}
+	const size_t fixlen = schema.getFixedRowLen();
+	const bool   hasIndex = strVec.m_index.size() != 0;
+	const size_t rows = hasIndex ? strVec.m_index.size()
+					  : fixlen ? strVec.m_strpool.size() / fixlen : 0;
+	auto getRow = [&](size_t i) {
+		return hasIndex ? strVec[i]
+			: fstring(strVec.m_strpool.data() + fixlen * i, fixlen);
+	};
+	valvec<size_t> offsets;
+	m_fixlen = hasIndex ? 0 : fixlen;
+	m_values.erase_all();
+	m_runBits.clear();
+	m_runBits.resize_fill(rows + 1, false);
+	llong inflateSize = 0;
+	for (size_t i = 0; i < rows; ++i) {
+		fstring row = getRow(i);
+		if (0 == i || getRow(i-1) != row) {
+			m_runBits.set1(i);
+			offsets.push_back(m_values.size());
+			m_values.append(row);
+		}
+		inflateSize += row.size();
+	}
+	m_runBits.set1(rows); // guard
+	m_runBits.build_cache(false, false);
+	offsets.push_back(m_values.size());
+	if (m_fixlen)
+		m_offsets.clear();
+	else
+		m_offsets.build_from(offsets);
+	m_inflateSize = inflateSize;
+	return true;
+}
+
+namespace {
+	struct RunLenStoreHeader {
+		uint64_t rows;
+		uint64_t runs;
+		uint64_t valueBytes;
+		uint64_t inflateSize;
+		uint64_t runBitsBytes;
+		uint32_t fixlen;
+		uint8_t  offsetBits;
+		uint8_t  padding1;
+		uint16_t padding2;
+	};
+	BOOST_STATIC_ASSERT(sizeof(RunLenStoreHeader) == 48);
+}
+
+TERARK_DB_REGISTER_STORE("rle", RunLenStore);
+
+void RunLenStore::load(PathRef fpath) {
+	assert(fstring(fpath.string()).endsWith(".rle"));
+	m_mmapBase = (byte_t*)mmap_load(fpath.string(), &m_mmapSize);
+	auto header = (const RunLenStoreHeader*)m_mmapBase;
+	byte* data = (byte*)(header + 1);
+	m_runBits.risk_mmap_from(data, header->runBitsBytes);
+	data += header->runBitsBytes;
+	assert(m_runBits.size() == header->rows + 1);
+	m_fixlen = header->fixlen;
+	if (0 == m_fixlen) {
+		m_offsets.risk_set_data(data, header->runs + 1, header->offsetBits);
+		data += m_offsets.mem_size();
+	}
+	if (data + header->valueBytes > m_mmapBase + m_mmapSize) {
+		THROW_STD(invalid_argument, "path=%s, broken data: fileSize=%zd"
+			, fpath.string().c_str(), m_mmapSize);
+	}
+	m_values.risk_set_data(data, header->valueBytes);
+	m_inflateSize = header->inflateSize;
+}
+
+void RunLenStore::save(PathRef path) const {
+	auto fpath = path + ".rle";
+	NativeDataOutput<FileStream> dio;
+	dio.open(fpath.string().c_str(), "wb");
+	RunLenStoreHeader header;
+	header.rows = numDataRows();
+	header.runs = numRuns();
+	header.valueBytes = m_values.size();
+	header.inflateSize = m_inflateSize;
+	header.runBitsBytes = m_runBits.mem_size();
+	header.fixlen = uint32_t(m_fixlen);
+	header.offsetBits = byte(m_offsets.uintbits());
+	header.padding1 = 0;
+	header.padding2 = 0;
+	dio.ensureWrite(&header, sizeof(header));
+	dio.ensureWrite(m_runBits.data(), m_runBits.mem_size());
+	dio.ensureWrite(m_offsets.data(), m_offsets.mem_size());
+	dio.ensureWrite(m_values.data(), m_values.used_mem_size());
+}
+
+}} // namespace terark::db
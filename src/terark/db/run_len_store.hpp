@@ -0,0 +1,58 @@
+#pragma once
+
+#include <terark/db/db_store.hpp>
+#include <terark/int_vector.hpp>
+#include <terark/rank_select.hpp>
+#include <terark/util/sortable_strvec.hpp>
+
+namespace terark { namespace db {
+
+// Run length encoded store for sorted or repetitive colgroups, such as
+// columns of a segment which is sorted by an index:
+//
+//   m_runBits[id] is 1 if row id starts a new run, plus a guard bit
+//   value of row id is the run of m_runBits.rank1(id+1) - 1
+//
+// Run values are fixed length when the colgroup is fixed length, else
+// they are located by m_offsets.
+class TERARK_DB_DLL RunLenStore : public ReadableStore {
+public:
+	explicit RunLenStore(const Schema& schema);
+	~RunLenStore();
+
+	llong dataStorageSize() const override;
+	llong dataInflateSize() const override;
+	llong numDataRows() const override;
+	void getValueAppend(llong id, valvec<byte>* val, DbContext*) const override;
+	StoreIterator* createStoreIterForward(DbContext*) const override;
+	StoreIterator* createStoreIterBackward(DbContext*) const override;
+
+	size_t numRuns() const { return m_runBits.max_rank1() - 1; }
+	size_t runOf(size_t id) const { return m_runBits.rank1(id + 1) - 1; }
+	fstring runValue(size_t run) const;
+
+	///@returns false if number of runs > maxRuns, then the store is not
+	/// built and should be discarded
+	bool build(const Schema& schema, SortableStrVec& strVec, size_t maxRuns);
+	void load(PathRef path) override;
+	void save(PathRef path) const override;
+
+	/// max runs/rows by env TerarkDB_RunLenStoreMaxRatio, default is 0.1,
+	/// that is, average run length >= 10, 0 disable it
+	static double getMaxRunRatio();
+
+	///@returns number of runs of storeData, stop counting when > maxRuns
+	static size_t countRuns(const Schema&, const SortableStrVec& storeData,
+							size_t maxRuns);
+
+protected:
+	rank_select_se m_runBits;
+	UintVecMin0    m_offsets; // runs + 1 offsets, empty if m_fixlen > 0
+	valvec<byte>   m_values;
+	byte_t*        m_mmapBase;
+	size_t         m_mmapSize;
+	size_t         m_fixlen;
+	llong          m_inflateSize;
+};
+
+}} // namespace terark::db
@@ -31,12 +31,21 @@
 			);
 	}
 
-	MyRwLock lock(m_rwMutex, true);
+	// inplace updating is guarded by the striped row lock,
+	// table lock is just for keeping the segments stable
+	MyRwLock lock(m_rwMutex, false);
 	DebugCheckRowNumVecNoLock(this);
 	assert(m_rowNumVec.size() == m_segments.size()+1);
 	assert(recordId < m_rowNumVec.back());
 	size_t upp = upper_bound_a(m_rowNumVec, recordId);
 	assert(upp < m_rowNumVec.size());
+	if (!m_segments[upp-1]->m_isFreezed) {
+		// inserting to m_wrSeg may remap its stores, needs exclusive lock
+		if (!lock.upgrade_to_writer()) {
+			upp = upper_bound_a(m_rowNumVec, recordId);
+			assert(upp < m_rowNumVec.size());
+		}
+	}
 	llong baseId = m_rowNumVec[upp-1];
 	llong subId = recordId - baseId;
 	auto seg = m_segments[upp-1].get();
@@ -0,0 +1,256 @@
+#include "value_cache.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace terark { namespace db {
+
+namespace {
+	struct CacheKey {
+		uint64_t segId;
+		uint64_t colgroupId;
+		uint64_t physicId;
+		bool operator==(const CacheKey& y) const {
+			return segId == y.segId && colgroupId == y.colgroupId
+				&& physicId == y.physicId;
+		}
+	};
+	inline uint64_t hashKey(const CacheKey& k) {
+		uint64_t h = k.segId * 0x9E3779B97F4A7C15ull
+				   ^ k.colgroupId * 0xC2B2AE3D27D4EB4Full
+				   ^ k.physicId;
+		// splitmix64 finalizer
+		h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+		h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+		return h ^ (h >> 31);
+	}
+	struct CacheKeyHash {
+		size_t operator()(const CacheKey& k) const { return size_t(hashKey(k)); }
+	};
+
+	// approximate per entry overhead: ring slot, hash node and bucket
+	const size_t EntryOverhead = 96;
+}
+
+struct ValueCache::Shard {
+	struct Entry {
+		CacheKey    key;
+		uint64_t    hash;
+		std::string val;
+		bool        used;
+		bool        ref;
+	};
+	std::mutex mtx;
+	std::unordered_map<CacheKey, uint32_t, CacheKeyHash> index;
+	std::vector<Entry> ring; // CLOCK
+	valvec<uint32_t>   freeSlots;
+	size_t hand = 0;
+	size_t usedBytes = 0;
+	size_t capacity = 0;
+
+	// count-min sketch of 4 rows, counters saturate at 15 and are halved
+	// when number of additions reach 10 * width, thus old popularity fades
+	valvec<byte> sketch;
+	size_t sketchMask = 0;
+	size_t additions = 0;
+
+	llong hits = 0;
+	llong misses = 0;
+	llong inserts = 0;
+	llong evicts = 0;
+	llong rejects = 0;
+
+	void init(size_t cap) {
+		capacity = cap;
+		size_t width = 256;
+		while (width < cap / 128 && width < (size_t(1) << 20))
+			width *= 2;
+		sketch.resize(4 * width, 0);
+		sketchMask = width - 1;
+	}
+	size_t sketchPos(uint64_t h, size_t row) const {
+		uint32_t a = uint32_t(h);
+		uint32_t b = uint32_t(h >> 20) | 1;
+		return row * (sketchMask + 1) + ((a + row * b) & sketchMask);
+	}
+	size_t frequency(uint64_t h) const {
+		size_t freq = 15;
+		for (size_t r = 0; r < 4; ++r)
+			freq = std::min<size_t>(freq, sketch[sketchPos(h, r)]);
+		return freq;
+	}
+	void recordAccess(uint64_t h) {
+		size_t freq = frequency(h);
+		if (freq < 15) {
+			for (size_t r = 0; r < 4; ++r) {
+				byte& c = sketch[sketchPos(h, r)];
+				if (c == freq) // conservative update
+					c++;
+			}
+		}
+		if (++additions >= 10 * (sketchMask + 1)) {
+			for (byte& c : sketch)
+				c >>= 1;
+			additions /= 2;
+		}
+	}
+	size_t findVictim() {
+		assert(!ring.empty());
+		for (;;) {
+			if (hand >= ring.size())
+				hand = 0;
+			Entry& e = ring[hand];
+			if (e.used) {
+				if (!e.ref)
+					return hand;
+				e.ref = false;
+			}
+			hand++;
+		}
+	}
+	void evict(size_t slot) {
+		Entry& e = ring[slot];
+		assert(e.used);
+		index.erase(e.key);
+		usedBytes -= e.val.size() + EntryOverhead;
+		e.used = false;
+		std::string().swap(e.val);
+		freeSlots.push_back(uint32_t(slot));
+		evicts++;
+	}
+};
+
+ValueCache::ValueCache(size_t capacityBytes, size_t shardNum) {
+	shardNum = std::max<size_t>(shardNum, 1);
+	m_shards = new Shard[shardNum];
+	m_shardNum = shardNum;
+	m_capacity = capacityBytes;
+	for (size_t i = 0; i < shardNum; ++i) {
+		m_shards[i].init(capacityBytes / shardNum);
+	}
+}
+ValueCache::~ValueCache() {
+	delete[] m_shards;
+}
+
+ValueCache* ValueCache::global() {
+	static std::unique_ptr<ValueCache> cache([]() -> ValueCache* {
+		size_t bytes = 0;
+		if (const char* env = getenv("TerarkDB_ValueCacheBytes")) {
+			bytes = (size_t)strtoull(env, NULL, 10);
+		}
+		if (0 == bytes) {
+			return nullptr;
+		}
+		size_t shards = 64;
+		if (const char* env = getenv("TerarkDB_ValueCacheShards")) {
+			shards = std::max<size_t>(1, (size_t)strtoull(env, NULL, 10));
+		}
+		fprintf(stderr, "INFO: ValueCache: capacity = %zd bytes, shards = %zd\n"
+			, bytes, shards);
+		return new ValueCache(bytes, shards);
+	}());
+	return cache.get();
+}
+
+uint64_t ValueCache::newSegmentId() {
+	static std::atomic<uint64_t> seq(0);
+	return ++seq;
+}
+
+bool
+ValueCache::getAppend(uint64_t segId, size_t colgroupId, size_t physicId,
+					  valvec<byte>* val)
+const {
+	CacheKey key = { segId, colgroupId, physicId };
+	uint64_t h = hashKey(key);
+	Shard& shard = m_shards[(h >> 40) % m_shardNum];
+	std::lock_guard<std::mutex> lock(shard.mtx);
+	shard.recordAccess(h);
+	auto iter = shard.index.find(key);
+	if (shard.index.end() == iter) {
+		shard.misses++;
+		return false;
+	}
+	Shard::Entry& e = shard.ring[iter->second];
+	e.ref = true;
+	val->append((const byte*)e.val.data(), e.val.size());
+	shard.hits++;
+	return true;
+}
+
+void
+ValueCache::put(uint64_t segId, size_t colgroupId, size_t physicId, fstring val) {
+	CacheKey key = { segId, colgroupId, physicId };
+	uint64_t h = hashKey(key);
+	Shard& shard = m_shards[(h >> 40) % m_shardNum];
+	const size_t cost = val.size() + EntryOverhead;
+	std::lock_guard<std::mutex> lock(shard.mtx);
+	if (cost > shard.capacity / 8) {
+		shard.rejects++; // too large, would flush too many values
+		return;
+	}
+	if (shard.index.count(key)) {
+		return; // put by another thread
+	}
+	const size_t freq = shard.frequency(h);
+	while (shard.usedBytes + cost > shard.capacity) {
+		size_t victim = shard.findVictim();
+		if (shard.frequency(shard.ring[victim].hash) >= freq) {
+			shard.rejects++;
+			return;
+		}
+		shard.evict(victim);
+	}
+	size_t slot;
+	if (shard.freeSlots.empty()) {
+		slot = shard.ring.size();
+		shard.ring.emplace_back();
+	} else {
+		slot = shard.freeSlots.pop_val();
+	}
+	Shard::Entry& e = shard.ring[slot];
+	e.key = key;
+	e.hash = h;
+	e.val.assign(val.data(), val.size());
+	e.used = true;
+	e.ref = false;
+	shard.index.emplace(key, uint32_t(slot));
+	shard.usedBytes += cost;
+	shard.inserts++;
+}
+
+ValueCache::Stat ValueCache::stat() const {
+	Stat st;
+	memset(&st, 0, sizeof(st));
+	for (size_t i = 0; i < m_shardNum; ++i) {
+		Shard& shard = m_shards[i];
+		std::lock_guard<std::mutex> lock(shard.mtx);
+		st.hits += shard.hits;
+		st.misses += shard.misses;
+		st.inserts += shard.inserts;
+		st.evicts += shard.evicts;
+		st.rejects += shard.rejects;
+		st.entries += shard.index.size();
+		st.usedBytes += shard.usedBytes;
+	}
+	st.capacity = m_capacity;
+	return st;
+}
+
+void ValueCache::clear() {
+	for (size_t i = 0; i < m_shardNum; ++i) {
+		Shard& shard = m_shards[i];
+		std::lock_guard<std::mutex> lock(shard.mtx);
+		shard.index.clear();
+		shard.ring.clear();
+		shard.freeSlots.clear();
+		shard.hand = 0;
+		shard.usedBytes = 0;
+	}
+}
+
+}} // namespace terark::db
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <terark/db/db_conf.hpp>
+#include <terark/valvec.hpp>
+#include <terark/fstring.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace terark { namespace db {
+
+// Process wide cache of decompressed colgroup values of readonly segments,
+// keyed by (segmentId, colgroupId, physicId).
+//
+// The cache is split into shards, each shard is a CLOCK ring guarded by
+// its own mutex. A new value is admitted only when its access frequency,
+// estimated by a count-min sketch with periodic aging (TinyLFU), is higher
+// than the frequency of the CLOCK victim, so a scan of cold records can not
+// flush hot records out of the cache.
+//
+// The global cache is enabled by env TerarkDB_ValueCacheBytes, segments
+// choose which colgroups are worth caching, see
+// ReadonlySegment::isValueCacheable()
+class TERARK_DB_DLL ValueCache : boost::noncopyable {
+public:
+	struct Stat {
+		llong hits;
+		llong misses;
+		llong inserts;
+		llong evicts;
+		llong rejects;  // rejected by admission filter
+		llong entries;
+		llong usedBytes;
+		llong capacity;
+		double hitRatio() const {
+			return hits + misses ? double(hits) / (hits + misses) : 0;
+		}
+	};
+
+	explicit ValueCache(size_t capacityBytes, size_t shardNum = 64);
+	~ValueCache();
+
+	///@returns nullptr if TerarkDB_ValueCacheBytes is 0 or not set
+	static ValueCache* global();
+
+	/// each segment object get a unique id, ids are never reused, so
+	/// entries of deleted segments are never hit and are evicted by CLOCK
+	static uint64_t newSegmentId();
+
+	///@{ value is appended to val on hit
+	bool getAppend(uint64_t segId, size_t colgroupId, size_t physicId,
+				   valvec<byte>* val) const;
+	void put(uint64_t segId, size_t colgroupId, size_t physicId, fstring val);
+	///@}
+
+	Stat stat() const;
+	void clear();
+
+	size_t capacity() const { return m_capacity; }
+
+private:
+	struct Shard;
+	Shard*  m_shards;
+	size_t  m_shardNum;
+	size_t  m_capacity;
+};
+
+}} // namespace terark::db
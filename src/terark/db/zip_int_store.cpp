@@ -89,6 +89,78 @@ void ZipIntStore::getValueAppend(llong id, valvec<byte>* val, DbContext*) const
 	}
 }
 
+void ZipIntStore::getInt64Batch(size_t recBeg, size_t num, llong* values) const {
+	assert(recBeg + num <= size_t(numDataRows()));
+	const size_t ChunkSize = 256;
+	size_t wire[ChunkSize]; // not aliasing values, which are llong
+	for (size_t beg = 0; beg < num; beg += ChunkSize) {
+		size_t n = std::min(num - beg, ChunkSize);
+		llong* out = values + beg;
+		if (m_index.size()) {
+			m_index.get_block(recBeg + beg, n, wire);
+			const byte*  dedup = m_dedup.data();
+			const size_t bits = m_dedup.uintbits();
+			const size_t mask = m_dedup.uintmask();
+			for (size_t i = 0; i < n; ++i) {
+				assert(wire[i] < m_dedup.size());
+				size_t w = UintVecMin0::fast_get(dedup, bits, mask, wire[i]);
+				out[i] = m_minValue + w;
+			}
+		}
+		else {
+			m_dedup.get_block(recBeg + beg, n, wire);
+			for (size_t i = 0; i < n; ++i) {
+				out[i] = m_minValue + wire[i];
+			}
+		}
+	}
+}
+
+template<class Int>
+void ZipIntStore::valueBatchAppend(const llong* values, size_t num,
+								   valvec<byte>* res) const {
+	byte* dst = res->grow_no_init(sizeof(Int) * num);
+	for (size_t i = 0; i < num; ++i) {
+		unaligned_save<Int>(dst + sizeof(Int) * i, Int(values[i]));
+	}
+}
+
+void ZipIntStore::getValueBatchAppend(size_t recBeg, size_t num,
+									  valvec<byte>* vals) const {
+	const size_t BatchSize = 256;
+	llong values[BatchSize];
+	for (size_t i = 0; i < num; i += BatchSize) {
+		size_t n = std::min(num - i, BatchSize);
+		getInt64Batch(recBeg + i, n, values);
+		switch (m_intType) {
+		default:
+			THROW_STD(invalid_argument, "Bad m_intType=%s", Schema::columnTypeStr(m_intType));
+		case ColumnType::Sint08: valueBatchAppend< int8_t >(values, n, vals); break;
+		case ColumnType::Uint08: valueBatchAppend<uint8_t >(values, n, vals); break;
+		case ColumnType::Sint16: valueBatchAppend< int16_t>(values, n, vals); break;
+		case ColumnType::Uint16: valueBatchAppend<uint16_t>(values, n, vals); break;
+		case ColumnType::Sint32: valueBatchAppend< int32_t>(values, n, vals); break;
+		case ColumnType::Uint32: valueBatchAppend<uint32_t>(values, n, vals); break;
+		case ColumnType::Sint64: valueBatchAppend< int64_t>(values, n, vals); break;
+		case ColumnType::Uint64: valueBatchAppend<uint64_t>(values, n, vals); break;
+		case ColumnType::VarSint:
+			for (size_t j = 0; j < n; ++j) {
+				byte  buf[16];
+				byte* end = save_var_int64(buf, int64_t(values[j]));
+				vals->append(buf, end - buf);
+			}
+			break;
+		case ColumnType::VarUint:
+			for (size_t j = 0; j < n; ++j) {
+				byte  buf[16];
+				byte* end = save_var_uint64(buf, uint64_t(values[j]));
+				vals->append(buf, end - buf);
+			}
+			break;
+		}
+	}
+}
+
 StoreIterator* ZipIntStore::createStoreIterForward(DbContext*) const {
 	return nullptr; // not needed
 }
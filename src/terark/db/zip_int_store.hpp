@@ -19,6 +19,13 @@ public:
 	StoreIterator* createStoreIterForward(DbContext*) const override;
 	StoreIterator* createStoreIterBackward(DbContext*) const override;
 
+	///@{ batch read of contiguous ids [recBeg, recBeg+num)
+	/// values are widened to llong, unsigned values are bitwise same
+	void getInt64Batch(size_t recBeg, size_t num, llong* values) const;
+	/// values are appended in the format of getValueAppend
+	void getValueBatchAppend(size_t recBeg, size_t num, valvec<byte>* vals) const;
+	///@}
+
 	void build(ColumnType intType, SortableStrVec& strVec);
 	void load(PathRef path) override;
 	void save(PathRef path) const override;
@@ -34,6 +41,9 @@ protected:
 	template<class Int>
 	void valueAppend(size_t recIdx, valvec<byte>* res) const;
 
+	template<class Int>
+	void valueBatchAppend(const llong* values, size_t num, valvec<byte>* res) const;
+
 	template<class Int>
 	void zipValues(const void* data, size_t size);
 };
@@ -5,6 +5,10 @@
 #include "stdtypes.hpp"
 #include <terark/util/throw.hpp>
 
+#if TERARK_WORD_BITS == 64 && (defined(__BMI2__) || defined(__AVX2__))
+	#include <immintrin.h>
+#endif
+
 namespace terark {
 
 class UintVecMin0 {
@@ -87,6 +91,70 @@ public:
 		return (val >> bit_idx % 8) & mask;
 	}
 
+	// decode [start, start+n) to out, much faster than get() one by one
+	void get_block(size_t start, size_t n, size_t* out) const {
+		assert(start + n <= m_size);
+		fast_get_block(m_data.data(), m_bits, m_mask, start, n, out);
+	}
+	static
+	void fast_get_block(const byte* data, size_t bits, size_t mask,
+						size_t start, size_t n, size_t* out) {
+		size_t i = 0;
+		switch (bits) {
+		case 0:
+			std::fill_n(out, n, size_t(0));
+			return;
+		case 8:
+			for (; i < n; ++i) out[i] = data[start + i];
+			return;
+		case 16:
+			for (; i < n; ++i) out[i] = unaligned_load<uint16_t>(data + 2*(start + i));
+			return;
+		case 32:
+			for (; i < n; ++i) out[i] = unaligned_load<uint32_t>(data + 4*(start + i));
+			return;
+		default:
+			break;
+		}
+#if TERARK_WORD_BITS == 64 && defined(__BMI2__)
+		if (bits < 8) {
+			// 8 values are 8*bits bits, unpacked to 8 bytes by one pdep
+			const uint64_t lanes = 0x0101010101010101ull * mask;
+			for (; i < n && (start + i) % 8 != 0; ++i)
+				out[i] = fast_get(data, bits, mask, start + i);
+			for (; i + 8 <= n; i += 8) {
+				uint64_t w = unaligned_load<uint64_t>(data + (start + i) / 8 * bits);
+				uint64_t u = _pdep_u64(w, lanes);
+				for (size_t j = 0; j < 8; ++j)
+					out[i + j] = byte(u >> 8*j);
+			}
+		}
+#endif
+#if TERARK_WORD_BITS == 64 && defined(__AVX2__)
+		if (bits > 8) {
+			// 4 values per gather, bits <= 58 fits in one 64 bit load
+			const __m256i vmask = _mm256_set1_epi64x(mask);
+			const __m256i seven = _mm256_set1_epi64x(7);
+			const __m256i step  = _mm256_set1_epi64x(4 * bits);
+			size_t b = bits * start;
+			__m256i bitpos = _mm256_set_epi64x(b + 3*bits, b + 2*bits, b + bits, b);
+			for (; i + 4 <= n; i += 4) {
+				__m256i offset = _mm256_srli_epi64(bitpos, 3);
+				__m256i shift = _mm256_and_si256(bitpos, seven);
+				__m256i w = _mm256_i64gather_epi64((const long long*)data, offset, 1);
+				w = _mm256_and_si256(_mm256_srlv_epi64(w, shift), vmask);
+				_mm256_storeu_si256((__m256i*)(out + i), w);
+				bitpos = _mm256_add_epi64(bitpos, step);
+			}
+		}
+#endif
+		size_t bit_idx = bits * (start + i);
+		for (; i < n; ++i, bit_idx += bits) {
+			size_t val = unaligned_load<size_t>(data + bit_idx / 8);
+			out[i] = (val >> bit_idx % 8) & mask;
+		}
+	}
+
 	void set_wire(size_t idx, size_t val) {
 		assert(idx < m_size);
 		assert(val <= m_mask);
@@ -0,0 +1,63 @@
+// ZipIntKeyIndexBench.cpp : compare ZipIntKeyIndex lower_bound with/without
+// the sampled Eytzinger search accelerator
+//
+// usage: ZipIntKeyIndexBench [rows] [loop] [sampleShift]
+
+#include "stdafx.h"
+#include <terark/db/intkey_index.hpp>
+#include <terark/util/profiling.hpp>
+#include <random>
+
+using namespace terark;
+using namespace terark::db;
+
+class BenchIndex : public ZipIntKeyIndex {
+public:
+	using ZipIntKeyIndex::searchLowerBound;
+	size_t rows() const { return m_index.size(); }
+};
+
+int main(int argc, char* argv[]) {
+	size_t rows = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+	size_t loop = argc > 2 ? strtoull(argv[2], NULL, 10) : 10000000;
+	int sampleShift = argc > 3 ? atoi(argv[3]) : 6;
+	std::mt19937_64 rnd(12345);
+	valvec<uint64_t> keys(rows, valvec_no_init());
+	for (size_t i = 0; i < rows; ++i) {
+		keys[i] = rnd() % (rows * 4);
+	}
+	BenchIndex plain, accel;
+	{
+		SortableStrVec strVec;
+		strVec.m_strpool.append((byte*)keys.data(), keys.used_mem_size());
+		plain.build(ColumnType::Uint64, strVec);
+		plain.buildSearchAccel(0);
+		accel.build(ColumnType::Uint64, strVec);
+		accel.buildSearchAccel(sampleShift);
+	}
+	valvec<uint64_t> qry(loop, valvec_no_init());
+	for (size_t i = 0; i < loop; ++i) {
+		qry[i] = rnd() % (rows * 4);
+	}
+	profiling pf;
+	size_t sum1 = 0, sum2 = 0;
+	long long t0 = pf.now();
+	for (size_t i = 0; i < loop; ++i) {
+		sum1 += plain.searchLowerBound(fstring((char*)&qry[i], 8)).first;
+	}
+	long long t1 = pf.now();
+	for (size_t i = 0; i < loop; ++i) {
+		sum2 += accel.searchLowerBound(fstring((char*)&qry[i], 8)).first;
+	}
+	long long t2 = pf.now();
+	if (sum1 != sum2) {
+		fprintf(stderr, "ERROR: result mismatch: plain = %zd, accel = %zd\n", sum1, sum2);
+		return 1;
+	}
+	printf("rows = %zd, loop = %zd, sampleShift = %d, accel mem = %lld bytes\n"
+		, rows, loop, sampleShift
+		, accel.indexStorageSize() - plain.indexStorageSize());
+	printf("plain: %f seconds, avgTime = %f'ns, QPS = %f'M\n", pf.sf(t0,t1), pf.nf(t0,t1)/loop, loop/pf.uf(t0,t1));
+	printf("accel: %f seconds, avgTime = %f'ns, QPS = %f'M\n", pf.sf(t1,t2), pf.nf(t1,t2)/loop, loop/pf.uf(t1,t2));
+	return 0;
+}
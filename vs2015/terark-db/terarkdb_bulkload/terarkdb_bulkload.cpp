@@ -0,0 +1,133 @@
+#include "stdafx.h"
+#include <terark/util/profiling.hpp>
+#include <terark/db/db_bulk_load.hpp>
+#include <getopt.h>
+
+void usage(const char* prog) {
+	fprintf(stderr, R"EOS(usage: %s options db-dir input-data-files...
+  Load delimited text rows into readonly segments directly
+options:
+  -d delim      : field delimiter, default is '\t'
+  -H lines      : skip header lines of each file
+  -I            : insert rows to writable segment, instead of bulk load
+  -S index-name : sort rows by the index in each segment
+  -P            : input rows are sorted by the index of -S, just check it
+  -T threads    : number of segment building threads
+  -p threads    : number of text parsing threads
+  -C chunk-size : approximate raw bytes of each segment
+  -v            : print rejected lines
+)EOS", prog);
+}
+
+int main(int argc, char* argv[]) {
+	const char* sortIndexName = NULL;
+	bool presorted = false;
+	bool insertMode = false;
+	bool verbose = false;
+	char delim = '\t';
+	size_t skipLines = 0;
+	size_t threadNum = 0;
+	size_t parseThreadNum = 0;
+	size_t chunkSize = 0;
+	for (;;) {
+		int opt = getopt(argc, argv, "d:H:IS:PT:p:C:v");
+		switch (opt) {
+		case -1:
+			goto GetoptDone;
+		case 'd':
+			delim = optarg[0];
+			break;
+		case 'H':
+			skipLines = strtoull(optarg, NULL, 10);
+			break;
+		case 'I':
+			insertMode = true;
+			break;
+		case 'S':
+			sortIndexName = optarg;
+			break;
+		case 'P':
+			presorted = true;
+			break;
+		case 'T':
+			threadNum = strtoull(optarg, NULL, 10);
+			break;
+		case 'p':
+			parseThreadNum = strtoull(optarg, NULL, 10);
+			break;
+		case 'C':
+			chunkSize = strtoull(optarg, NULL, 10);
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+GetoptDone:
+	if (optind + 2 > argc) {
+		usage(argv[0]);
+		return 1;
+	}
+	using namespace terark::db;
+	const char* dbdir = argv[optind + 0];
+	CompositeTablePtr tab(CompositeTable::createTable("DfaDbTable"));
+	tab->load(dbdir);
+	BulkLoader loader(tab.get());
+	if (sortIndexName) {
+		size_t indexId = tab->getIndexId(sortIndexName);
+		if (indexId >= tab->getIndexNum()) {
+			fprintf(stderr, "ERROR: index '%s' is not found\n", sortIndexName);
+			return 1;
+		}
+		loader.setSortIndex(indexId, presorted);
+	}
+	if (threadNum)
+		loader.setThreadNum(threadNum);
+	if (chunkSize)
+		loader.setChunkSize(chunkSize);
+	DelimTextLoader textLoader(tab.get(), delim);
+	if (parseThreadNum)
+		textLoader.setThreadNum(parseThreadNum);
+	textLoader.setSkipLines(skipLines);
+	if (verbose) {
+		textLoader.setRejectCallback(
+		[](terark::fstring line, long long offset, const char* reason) {
+			fprintf(stderr, "WARN: offset %lld: %s: %.*s\n"
+				, offset, reason, line.ilen(), line.data());
+		});
+	}
+	terark::profiling pf;
+	long long t0 = pf.now();
+	for (int argIdx = optind + 1; argIdx < argc; ++argIdx) {
+		const char* fname = argv[argIdx];
+		try {
+			long long rows = insertMode ? textLoader.loadFile(fname)
+										: textLoader.loadFile(fname, &loader);
+			printf("%s: %lld rows\n", fname, rows);
+		}
+		catch (const std::exception& ex) {
+			fprintf(stderr, "ERROR: %s: %s\n", fname, ex.what());
+			if (!insertMode) {
+				// rows of the half loaded file must not be attached,
+				// ~BulkLoader removes the unattached chunk segments
+				fprintf(stderr, "ERROR: bulk load aborted, nothing is attached\n");
+				return 1;
+			}
+		}
+	}
+	const DelimTextLoader::Stat& st = textLoader.stat();
+	printf("lines=%lld rows=%lld rejected=%lld bytes=%lld, parse: %f sec, %f rows/sec\n"
+		, st.lines, st.rows, st.rejected, st.bytes, st.seconds, st.rowsPerSec());
+	if (!insertMode) {
+		size_t segNum = loader.finish();
+		printf("attached %zd segments\n", segNum);
+	}
+	long long t1 = pf.now();
+	printf("total %f sec, %f rows/sec, %f MB/sec\n"
+		, pf.sf(t0, t1), st.rows / pf.sf(t0, t1), st.bytes / pf.uf(t0, t1));
+	terark::db::CompositeTable::safeStopAndWaitForCompress();
+	return 0;
+}